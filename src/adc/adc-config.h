@@ -23,6 +23,11 @@
 #define ADC_GPIO_CLOCK      RCC_AHB1Periph_GPIOC
 #define ADC_CHANNEL         ADC_Channel_14
 
+#define ADC_DMA_CLOCK_CMD   RCC_AHB1PeriphClockCmd
+#define ADC_DMA_CLOCK       RCC_AHB1Periph_DMA2
+#define ADC_DMA_STREAM      DMA2_Stream0
+#define ADC_DMA_CHANNEL     DMA_Channel_0
+
 #elif defined (STM32F10X)
 
 #define ADC_NUMBER          ADC1
@@ -34,8 +39,21 @@
 #define ADC_GPIO_CLOCK      (RCC_APB2Periph_GPIOC | RCC_APB2Periph_AFIO)
 #define ADC_CHANNEL         ADC_Channel_5
 
+#define ADC_DMA_CLOCK_CMD   RCC_AHBPeriphClockCmd
+#define ADC_DMA_CLOCK       RCC_AHBPeriph_DMA1
+#define ADC_DMA_STREAM      DMA1_Channel1
+
 #endif
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * oversampling: TIM2 triggers one conversion per ms (TRGO on STM32F4xx, CC2 on STM32F10x), DMA stores the last ADC_SAMPLES
+ * values in a ring. The sum of 64 samples has 18 bits, 3 of them are significant: ADC_OVERSAMPLED_BITS = 12 + 3.
+ * 64 ms include several periods of 100Hz/120Hz flicker of lamps.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define ADC_SAMPLES         64                                              // must be 4^n for ADC_OVERSAMPLED_BITS
+#define ADC_OVERSAMPLED_BITS 15
+
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * maximum ADC frequency: 36MHz
@@ -3,6 +3,9 @@
  *
  * Copyright (c) 2015-2016 Frank Meyer - frank(at)fli4l.de
  *
+ * The ADC converts continuously, triggered by TIM2 every ms, DMA writes the samples into a ring buffer without any
+ * interrupt. adc_get_oversampled_value() sums the ring, see ADC_OVERSAMPLED_BITS in adc-config.h.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -15,10 +18,82 @@
 
 uint_fast8_t            adc_is_up;
 
-static uint_fast8_t     conversion_started = 0;
+static volatile uint16_t adc_samples[ADC_SAMPLES];                                  // written by DMA
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: initialize DMA: ADC -> adc_samples[], circular
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+adc_dma_init (void)
+{
+    DMA_InitTypeDef         dma;
+
+    ADC_DMA_CLOCK_CMD (ADC_DMA_CLOCK, ENABLE);
+
+    DMA_StructInit (&dma);
+    DMA_Cmd (ADC_DMA_STREAM, DISABLE);
+    DMA_DeInit (ADC_DMA_STREAM);
+
+    dma.DMA_Mode                = DMA_Mode_Circular;
+    dma.DMA_PeripheralBaseAddr  = (uint32_t) &ADC_NUMBER->DR;
+    dma.DMA_PeripheralDataSize  = DMA_PeripheralDataSize_HalfWord;
+    dma.DMA_MemoryDataSize      = DMA_MemoryDataSize_HalfWord;
+    dma.DMA_BufferSize          = ADC_SAMPLES;
+    dma.DMA_PeripheralInc       = DMA_PeripheralInc_Disable;
+    dma.DMA_MemoryInc           = DMA_MemoryInc_Enable;
+    dma.DMA_Priority            = DMA_Priority_Low;
+
+#if defined (STM32F4XX)
+
+    dma.DMA_DIR                 = DMA_DIR_PeripheralToMemory;
+    dma.DMA_Channel             = ADC_DMA_CHANNEL;
+    dma.DMA_Memory0BaseAddr     = (uint32_t) adc_samples;
+    dma.DMA_FIFOMode            = DMA_FIFOMode_Disable;
+    dma.DMA_FIFOThreshold       = DMA_FIFOThreshold_HalfFull;
+    dma.DMA_MemoryBurst         = DMA_MemoryBurst_Single;
+    dma.DMA_PeripheralBurst     = DMA_PeripheralBurst_Single;
+
+#elif defined (STM32F10X)
+
+    dma.DMA_DIR                 = DMA_DIR_PeripheralSRC;
+    dma.DMA_M2M                 = DMA_M2M_Disable;
+    dma.DMA_MemoryBaseAddr      = (uint32_t) adc_samples;
+
+#endif
+
+    DMA_Init (ADC_DMA_STREAM, &dma);
+    DMA_Cmd (ADC_DMA_STREAM, ENABLE);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: let TIM2 trigger ADC every ms, TIM2 is initialized in main.c
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+adc_trigger_init (void)
+{
+#if defined (STM32F4XX)
+
+    TIM_SelectOutputTrigger (TIM2, TIM_TRGOSource_Update);
+
+#elif defined (STM32F10X)                                                           // ADC1 cannot be triggered by TIM2 TRGO
+
+    TIM_OCInitTypeDef       oc;
+
+    RCC_APB1PeriphClockCmd (RCC_APB1Periph_TIM2, ENABLE);
+
+    TIM_OCStructInit (&oc);
+    oc.TIM_OCMode           = TIM_OCMode_PWM1;
+    oc.TIM_OutputState      = TIM_OutputState_Disable;                              // no pin, only CC2 event
+    oc.TIM_Pulse            = 1;
+    TIM_OC2Init (TIM2, &oc);
+
+#endif
+}
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * initialize ADC (single conversion mode)
+ * initialize ADC (conversions triggered by TIM2, DMA)
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 void
@@ -56,6 +131,9 @@ adc_init (void)
 
         ADC_ADC_CLOCK_CMD (ADC_ADC_CLOCK, ENABLE);
 
+        adc_dma_init ();
+        adc_trigger_init ();
+
 #if defined (STM32F4XX)
         ADC_CommonInitTypeDef adc_common;
 
@@ -71,7 +149,8 @@ adc_init (void)
         adc.ADC_Resolution             = ADC_Resolution_12b;
         adc.ADC_ScanConvMode           = DISABLE;
         adc.ADC_ContinuousConvMode     = DISABLE;
-        adc.ADC_ExternalTrigConvEdge   = ADC_ExternalTrigConvEdge_None;
+        adc.ADC_ExternalTrigConvEdge   = ADC_ExternalTrigConvEdge_Rising;
+        adc.ADC_ExternalTrigConv       = ADC_ExternalTrigConv_T2_TRGO;
         adc.ADC_DataAlign              = ADC_DataAlign_Right;
         adc.ADC_NbrOfConversion        = 1;
 
@@ -80,7 +159,7 @@ adc_init (void)
 
         adc.ADC_ScanConvMode           = DISABLE;
         adc.ADC_ContinuousConvMode     = DISABLE;
-        adc.ADC_ExternalTrigConv       = ADC_ExternalTrigConv_None;
+        adc.ADC_ExternalTrigConv       = ADC_ExternalTrigConv_T2_CC2;
         adc.ADC_DataAlign              = ADC_DataAlign_Right;
         adc.ADC_NbrOfChannel = 1;
 
@@ -90,11 +169,14 @@ adc_init (void)
 
 #if defined (STM32F4XX)
 
-        ADC_RegularChannelConfig (ADC_NUMBER, ADC_CHANNEL, 1, ADC_SampleTime_3Cycles);     // configure conversion channel
+        ADC_RegularChannelConfig (ADC_NUMBER, ADC_CHANNEL, 1, ADC_SampleTime_480Cycles);   // configure conversion channel
+        ADC_DMARequestAfterLastTransferCmd (ADC_NUMBER, ENABLE);                            // DMA request after every conversion
+        ADC_DMACmd (ADC_NUMBER, ENABLE);
 
 #elif defined (STM32F10X)
 
-        ADC_RegularChannelConfig (ADC_NUMBER, ADC_CHANNEL, 1, ADC_SampleTime_1Cycles5);    // configure conversion channel
+        ADC_RegularChannelConfig (ADC_NUMBER, ADC_CHANNEL, 1, ADC_SampleTime_239Cycles5);  // configure conversion channel
+        ADC_DMACmd (ADC_NUMBER, ENABLE);
 
 #endif
 
@@ -114,6 +196,8 @@ adc_init (void)
         {
             ;
         }
+
+        ADC_ExternalTrigConvCmd (ADC_NUMBER, ENABLE);
 #endif
 
         adc_is_up = 1;
@@ -123,34 +207,19 @@ adc_init (void)
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * start conversion
+ * get oversampled value of last ADC_SAMPLES ms, ADC_OVERSAMPLED_BITS bits
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
-void
-adc_start_single_conversion (void)
+uint_fast16_t
+adc_get_oversampled_value (void)
 {
-#if defined (STM32F4XX)
-    ADC_SoftwareStartConv (ADC_NUMBER);
-#elif defined (STM32F10X)
-    ADC_SoftwareStartConvCmd (ADC_NUMBER, ENABLE);
-#endif
-    conversion_started = 1;
-}
+    uint32_t        sum = 0;
+    uint_fast8_t    idx;
 
-/*-------------------------------------------------------------------------------------------------------------------------------------------
- * poll adc value
- *-------------------------------------------------------------------------------------------------------------------------------------------
- */
-uint_fast8_t
-adc_poll_conversion_value (uint16_t * value_p)
-{
-    uint_fast8_t    rtc = 0;
-
-    if (conversion_started && ADC_GetFlagStatus (ADC_NUMBER, ADC_FLAG_EOC) != RESET)       // conversion started and ready?
+    for (idx = 0; idx < ADC_SAMPLES; idx++)
     {
-        *value_p = ADC_GetConversionValue (ADC_NUMBER);
-        conversion_started = 0;
-        rtc = 1;
+        sum += adc_samples[idx];
     }
-    return rtc;
+
+    return sum >> (ADC_OVERSAMPLED_BITS - 12);                                  // sum of 4^n samples has 12 + 2n bits, n significant
 }
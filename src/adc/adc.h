@@ -27,7 +27,6 @@
 extern uint_fast8_t     adc_is_up;
 
 extern void             adc_init (void);
-extern void             adc_start_single_conversion (void);
-extern uint_fast8_t     adc_poll_conversion_value (uint16_t *);
+extern uint_fast16_t    adc_get_oversampled_value (void);
 
 #endif // ADC_H
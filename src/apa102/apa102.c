@@ -101,6 +101,9 @@ static uint16_t                         apa102_buf[APA102_BUF_LEN(APA102_MAX_LED
 static uint8_t                          apa102_buf[APA102_BUF_LEN(APA102_MAX_LEDS)];    // 8bit DMA buffer saves RAM
 #endif
 
+static uint8_t                          dim_table[256];                                 // dimmed value of every PWM value
+static uint_fast16_t                    dim_first_led = APA102_MAX_LEDS;                // LEDs before are not dimmed
+
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
  * INTERN: initialize DMA
@@ -205,9 +208,20 @@ apa102_setup_apa102_buf (uint_fast16_t n_leds)
     for (n = 0; n < n_leds; n++)
     {
         apa102_buf[pos++] = 0xFF;                                   // set GLOBAL to full brightness
-        apa102_buf[pos++] = led->blue;                              // blue brightness
-        apa102_buf[pos++] = led->green;                             // green brightness
-        apa102_buf[pos++] = led->red;                               // red brightness
+
+        if (n < dim_first_led)
+        {
+            apa102_buf[pos++] = led->blue;                          // blue brightness
+            apa102_buf[pos++] = led->green;                         // green brightness
+            apa102_buf[pos++] = led->red;                           // red brightness
+        }
+        else
+        {
+            apa102_buf[pos++] = dim_table[led->blue];               // dimmed blue brightness
+            apa102_buf[pos++] = dim_table[led->green];              // dimmed green brightness
+            apa102_buf[pos++] = dim_table[led->red];                // dimmed red brightness
+        }
+
         led++;
     }
 
@@ -290,6 +304,30 @@ apa102_set_all_leds (APA102_RGB * rgb, uint_fast16_t n_leds, uint_fast8_t refres
     }
 }
 
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * set dim factor of all LEDs from first_led on, 256 = full brightness
+ *
+ * Same as ws2812_set_dim_factor(). The 5 bit GLOBAL field is not used: only 32 steps and a slower PWM.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+apa102_set_dim_factor (uint_fast16_t first_led, uint_fast16_t factor)
+{
+    uint_fast16_t   value;
+
+    for (value = 0; value < 256; value++)
+    {
+        dim_table[value] = (value * factor + 128) >> 8;
+
+        if (value > 0 && dim_table[value] == 0)
+        {
+            dim_table[value] = 1;
+        }
+    }
+
+    dim_first_led = first_led;
+}
+
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
  * initialize APA102
  *-----------------------------------------------------------------------------------------------------------------------------------------------
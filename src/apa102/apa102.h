@@ -49,5 +49,6 @@ extern void apa102_init (void);
 extern void apa102_refresh (uint_fast16_t);
 extern void apa102_set_led (uint_fast16_t, APA102_RGB *);
 extern void apa102_set_all_leds (APA102_RGB *, uint_fast16_t, uint_fast8_t);
+extern void apa102_set_dim_factor (uint_fast16_t, uint_fast16_t);
 
 #endif
@@ -0,0 +1,519 @@
+/*---------------------------------------------------------------------------------------------------------------------------------------------------
+ * dcf77-test.c - host test of DCF77 decoder, see dcf77-test.sh
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * usage: dcf77-test -l                 list synthetic scenarios
+ *        dcf77-test -s scenario [seed] decode synthetic edge stream of scenario
+ *        dcf77-test -w scenario [seed] write synthetic edge stream of scenario to stdout, format see below
+ *        dcf77-test -f file            decode edge stream of file
+ *
+ * The signal is rendered with a resolution of 1 ms. Every frame carries the local time of the following minute mark,
+ * including A1, Z1/Z2 around a CET/CEST switch, parity bits and random weather bits. Noise is added as jitter of the
+ * pulse begin and width, missing pulses, pulses of the wrong width, short glitches and bursts of interference.
+ *
+ * The edges are passed to dcf77_edge_event() at their time, dcf77_tick() is called every 10 ms, like in the main loop.
+ * Every time returned by dcf77_time() is checked against the expected time of its minute mark.
+ *
+ * File format, one entry per line:
+ *   ms level                           edge: time in ms, level after edge (1 = pulse)
+ *   = ms YYYY-MM-DD HH:MM              minute mark at ms begins this local time
+ *   # text                             comment
+ *
+ * Output: scenario, expected minute marks, decoded, wrong, missed. Exit code 1 if a time is wrong or less than the
+ * minimum of decoded times of a scenario have been decoded.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *---------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dcf77.h"
+#include "event.h"
+
+#define MS_PER_MINUTE       60000
+#define MAX_MINUTES         180
+#define MAX_EDGES           (MAX_MINUTES * 2 * 200)
+#define MAX_MARKS           (MAX_MINUTES + 1)
+#define MARK_TOLERANCE_MS   100                                         // max. distance of decoded and expected minute mark
+#define START_MS            1000                                        // first pulse: second 1 of first minute
+
+typedef struct
+{
+    uint_fast8_t    edge_jitter_ms;                                     // max. jitter of pulse begin
+    uint_fast8_t    width_jitter_ms;                                    // max. jitter of pulse width
+    uint_fast16_t   missing_permille;                                   // missing pulses
+    uint_fast16_t   flip_permille;                                      // pulses of wrong width: 100 <-> 200 ms
+    uint_fast8_t    glitches;                                           // glitches of 5...15 ms per minute
+    uint_fast8_t    bursts;                                             // bursts of 1...3 seconds of interference per hour
+} NOISE;
+
+typedef struct
+{
+    const char *    name;
+    const char *    start;                                              // UTC of first minute, YYYY-MM-DD HH:MM
+    const char *    zone_switch;                                        // UTC of CET/CEST switch or NULL
+    uint_fast8_t    cest;                                               // 1: CEST before switch
+    uint_fast16_t   minutes;
+    uint_fast16_t   min_decoded;                                        // min. number of decoded times, lowest of 200 seeds
+    NOISE           noise;
+} SCENARIO;
+
+static const SCENARIO scenarios[] =
+{
+    { "clean",              "2016-01-14 22:40", NULL,               0,  40, 37, {  0,  0,   0,  0,  0,  0 } },
+    { "jitter",             "2016-02-29 23:50", NULL,               0,  40, 36, {  8, 25,   0,  0,  0,  0 } },
+    { "glitches",           "2016-06-30 21:45", NULL,               1,  40, 33, {  5, 15,   0,  0, 30,  0 } },
+    { "missing-pulses",     "2016-12-31 22:30", NULL,               0,  60, 29, {  5, 15, 100,  0,  0,  0 } },
+    { "wrong-pulses",       "2016-08-07 09:10", NULL,               1,  60, 50, {  5, 15,   0, 20,  0,  0 } },
+    { "bursts",             "2016-05-01 06:00", NULL,               1,  60, 40, {  5, 15,  20,  5, 10, 12 } },
+    { "cet-cest",           "2016-03-27 00:30", "2016-03-27 01:00", 0,  60, 58, {  0,  0,   0,  0,  0,  0 } },
+    { "cest-cet",           "2016-10-30 00:30", "2016-10-30 01:00", 1,  60, 58, {  0,  0,   0,  0,  0,  0 } },
+    { "cet-cest-noisy",     "2016-03-27 00:20", "2016-03-27 01:00", 0,  80, 48, {  8, 25,  50, 10, 10,  6 } },
+    { "cest-cet-noisy",     "2016-10-30 00:20", "2016-10-30 01:00", 1,  80, 48, {  8, 25,  50, 10, 10,  6 } },
+};
+
+#define N_SCENARIOS         (sizeof (scenarios) / sizeof (scenarios[0]))
+
+typedef struct
+{
+    uint32_t        ms;
+    uint8_t         level;
+} EDGE;
+
+typedef struct
+{
+    uint32_t        ms;
+    struct tm       tm;
+} MARK;
+
+static EDGE         edges[MAX_EDGES];
+static uint32_t     n_edges;
+static MARK         marks[MAX_MARKS];
+static uint32_t     n_marks;
+static uint8_t      signal[MAX_MINUTES * MS_PER_MINUTE];
+static uint32_t     signal_ms;
+
+static uint32_t     sim_ticks;                                          // simulated timestamp timer, 100 us
+static uint32_t     seed = 0x12345678;                                  // seed of pseudo random numbers
+static uint32_t     rnd;
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * stubs of firmware routines
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+volatile uint32_t   event_overflows[EVENT_TYPES];
+
+uint32_t        dcf77_test_get_ticks (void)                                 { return sim_ticks; }
+uint_fast8_t    event_put_timestamp (uint_fast8_t t, uint_fast8_t d, uint32_t ts) { (void) t; (void) d; (void) ts; return 1; }
+uint32_t        softclock_get_uptime (void)                                 { return sim_ticks / 10000; }
+void            board_led_on (void)                                         { ; }
+void            board_led_off (void)                                        { ; }
+void            log_uart_puts (char * s)                                    { (void) s; }
+void            log_printf (const char * fmt, ...)                          { (void) fmt; }
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * pseudo random numbers, same sequence on every host
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint32_t
+random_next (uint32_t n)
+{
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return n ? rnd % n : 0;
+}
+
+static int
+random_jitter (uint_fast8_t max)
+{
+    return max ? (int) random_next (2 * max + 1) - max : 0;
+}
+
+static time_t
+parse_time (const char * s)
+{
+    struct tm   tm;
+
+    memset (&tm, 0, sizeof (tm));
+
+    if (sscanf (s, "%d-%d-%d %d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min) != 5)
+    {
+        fprintf (stderr, "invalid time: %s\n", s);
+        exit (2);
+    }
+
+    tm.tm_year -= 1900;
+    tm.tm_mon--;
+    return timegm (&tm);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * render signal of scenario with 1 ms resolution
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+set_signal (int32_t from, int32_t to, uint8_t level)
+{
+    if (from < 0)
+    {
+        from = 0;
+    }
+
+    while (from < to && (uint32_t) from < signal_ms)
+    {
+        signal[from++] = level;
+    }
+}
+
+static void
+put_bcd (uint8_t * bits, uint_fast8_t first, uint_fast8_t n, uint_fast8_t value)
+{
+    static const uint8_t    weights[8] = { 1, 2, 4, 8, 10, 20, 40, 80 };
+    uint_fast8_t            i;
+
+    for (i = n; i-- > 0; )
+    {
+        if (value >= weights[i])
+        {
+            bits[first + i] = 1;
+            value -= weights[i];
+        }
+    }
+}
+
+static void
+put_parity (uint8_t * bits, uint_fast8_t first, uint_fast8_t parity_bit)
+{
+    uint_fast8_t    parity = 0;
+    uint_fast8_t    i;
+
+    for (i = first; i < parity_bit; i++)
+    {
+        parity ^= bits[i];
+    }
+
+    bits[parity_bit] = parity;
+}
+
+static void
+render (const SCENARIO * s)
+{
+    time_t          start       = parse_time (s->start);
+    time_t          zone_switch = s->zone_switch ? parse_time (s->zone_switch) : 0;
+    uint8_t         bits[59];
+    struct tm       tm;
+    time_t          utc;
+    uint_fast8_t    cest;
+    uint_fast16_t   minute;
+    uint_fast8_t    second;
+    uint_fast8_t    n;
+    int32_t         begin;
+    int32_t         width;
+    uint32_t        ms;
+
+    signal_ms   = s->minutes * MS_PER_MINUTE;
+    n_marks     = 0;
+    memset (signal, 0, signal_ms);
+
+    for (minute = 0; minute < s->minutes; minute++)
+    {
+        utc     = start + (time_t) (minute + 1) * 60;                            // frame carries time of next minute
+        cest    = zone_switch && utc >= zone_switch ? ! s->cest : s->cest;
+        utc    += cest ? 7200 : 3600;
+        gmtime_r (&utc, &tm);
+
+        if (minute > 0)                                                 // first frame is incomplete
+        {
+            marks[n_marks].ms = (minute + 1) * MS_PER_MINUTE;
+            marks[n_marks].tm = tm;
+            n_marks++;
+        }
+
+        memset (bits, 0, sizeof (bits));
+
+        for (second = 1; second < 15; second++)
+        {
+            bits[second] = random_next (2);                             // weather data
+        }
+
+        bits[16] = zone_switch && start + (time_t) (minute + 1) * 60 < zone_switch && start + (time_t) (minute + 1) * 60 >= zone_switch - 3600;
+        bits[17] = cest;
+        bits[18] = ! cest;
+        bits[20] = 1;
+        put_bcd (bits, 21, 7, tm.tm_min);
+        put_parity (bits, 21, 28);
+        put_bcd (bits, 29, 6, tm.tm_hour);
+        put_parity (bits, 29, 35);
+        put_bcd (bits, 36, 6, tm.tm_mday);
+        put_bcd (bits, 42, 3, tm.tm_wday ? tm.tm_wday : 7);
+        put_bcd (bits, 45, 5, tm.tm_mon + 1);
+        put_bcd (bits, 50, 8, tm.tm_year - 100);
+        put_parity (bits, 36, 58);
+
+        for (second = 0; second < 59; second++)
+        {
+            ms = minute * MS_PER_MINUTE + second * 1000;
+
+            if (ms < START_MS || random_next (1000) < s->noise.missing_permille)
+            {
+                continue;
+            }
+
+            width = (bits[second] ^ (random_next (1000) < s->noise.flip_permille)) ? 200 : 100;
+            begin = ms + random_jitter (s->noise.edge_jitter_ms);
+            set_signal (begin, begin + width + random_jitter (s->noise.width_jitter_ms), 1);
+        }
+
+        for (n = 0; n < s->noise.glitches; n++)
+        {
+            begin = minute * MS_PER_MINUTE + random_next (MS_PER_MINUTE);
+            width = 5 + random_next (11);
+            set_signal (begin, begin + width, ! signal[begin]);
+        }
+
+        if (random_next (60) < s->noise.bursts)
+        {
+            begin = minute * MS_PER_MINUTE + random_next (MS_PER_MINUTE - 3000);
+
+            for (ms = begin + 1000 + random_next (2000); (uint32_t) begin < ms; begin += width)
+            {
+                width = 2 + random_next (60);
+                set_signal (begin, begin + width, random_next (2));
+            }
+        }
+    }
+
+    n_edges = 0;
+
+    for (ms = 1; ms < signal_ms && n_edges < MAX_EDGES; ms++)
+    {
+        if (signal[ms] != signal[ms - 1])
+        {
+            edges[n_edges].ms       = ms;
+            edges[n_edges].level    = signal[ms];
+            n_edges++;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * read edge stream from file
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+read_file (const char * fname)
+{
+    FILE *          fp = fopen (fname, "r");
+    char            line[128];
+    unsigned long   ms = 0;
+    unsigned int    level;
+    char            date[32];
+
+    if (! fp)
+    {
+        perror (fname);
+        exit (2);
+    }
+
+    n_edges     = 0;
+    n_marks     = 0;
+    signal_ms   = 0;
+
+    while (fgets (line, sizeof (line), fp))
+    {
+        if (line[0] == '=' && n_marks < MAX_MARKS && sscanf (line + 1, "%lu %31[0-9- :]", &ms, date) == 2)
+        {
+            time_t  t = parse_time (date);
+
+            marks[n_marks].ms = ms;
+            gmtime_r (&t, &marks[n_marks].tm);
+            n_marks++;
+        }
+        else if (line[0] != '#' && n_edges < MAX_EDGES && sscanf (line, "%lu %u", &ms, &level) == 2)
+        {
+            edges[n_edges].ms       = ms;
+            edges[n_edges].level    = level ? 1 : 0;
+            n_edges++;
+        }
+
+        if (ms + 2000 > signal_ms)
+        {
+            signal_ms = ms + 2000;
+        }
+    }
+
+    fclose (fp);
+}
+
+static void
+write_stream (const SCENARIO * s)
+{
+    uint32_t        e = 0;
+    uint32_t        m;
+
+    printf ("# %s: %s UTC, %u minutes, generated by dcf77-test -w %s 0x%08x\n", s->name, s->start, (unsigned int) s->minutes,
+            s->name, (unsigned int) seed);
+
+    for (m = 0; m <= n_marks; m++)
+    {
+        while (e < n_edges && (m == n_marks || edges[e].ms < marks[m].ms))
+        {
+            printf ("%u %u\n", (unsigned int) edges[e].ms, (unsigned int) edges[e].level);
+            e++;
+        }
+
+        if (m < n_marks)
+        {
+            printf ("= %u %04d-%02d-%02d %02d:%02d\n", (unsigned int) marks[m].ms, marks[m].tm.tm_year + 1900,
+                    marks[m].tm.tm_mon + 1, marks[m].tm.tm_mday, marks[m].tm.tm_hour, marks[m].tm.tm_min);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * pass edge stream to decoder, check decoded times
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static int
+decode (const char * name, uint_fast16_t min_decoded)
+{
+    const uint32_t  t0 = 1000000;                                       // timer does not start with 0
+    struct tm       tm;
+    uint_fast16_t   age_ms;
+    uint32_t        e = 0;
+    uint32_t        ms;
+    uint32_t        mark_ms;
+    uint32_t        m;
+    uint32_t        decoded = 0;
+    uint32_t        wrong   = 0;
+    const MARK *    expected;
+
+    for (ms = 0; ms < signal_ms + 1000; ms++)
+    {
+        sim_ticks = t0 + ms * 10;
+
+        while (e < n_edges && edges[e].ms <= ms)
+        {
+            dcf77_edge_event (t0 + edges[e].ms * 10, edges[e].level);
+            e++;
+        }
+
+        if (ms % 10 == 0)
+        {
+            dcf77_tick ();
+        }
+
+        if (dcf77_time (&tm, &age_ms))
+        {
+            mark_ms     = ms - age_ms;
+            expected    = NULL;
+
+            for (m = 0; m < n_marks; m++)
+            {
+                if (mark_ms + MARK_TOLERANCE_MS >= marks[m].ms && mark_ms <= marks[m].ms + MARK_TOLERANCE_MS)
+                {
+                    expected = &marks[m];
+                    break;
+                }
+            }
+
+            decoded++;
+
+            if (! expected || tm.tm_year != expected->tm.tm_year || tm.tm_mon != expected->tm.tm_mon ||
+                tm.tm_mday != expected->tm.tm_mday || tm.tm_wday != expected->tm.tm_wday ||
+                tm.tm_hour != expected->tm.tm_hour || tm.tm_min != expected->tm.tm_min)
+            {
+                fprintf (stderr, "%s: minute mark at %u ms: decoded %04d-%02d-%02d %02d:%02d", name, (unsigned int) mark_ms,
+                         tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min);
+
+                if (expected)
+                {
+                    fprintf (stderr, ", expected %04d-%02d-%02d %02d:%02d\n", expected->tm.tm_year + 1900,
+                             expected->tm.tm_mon + 1, expected->tm.tm_mday, expected->tm.tm_hour, expected->tm.tm_min);
+                }
+                else
+                {
+                    fprintf (stderr, ", no minute mark expected\n");
+                }
+                wrong++;
+            }
+        }
+    }
+
+    printf ("%-20s %7u %7u %7u %7u\n", name, (unsigned int) n_marks, (unsigned int) decoded, (unsigned int) wrong,
+            (unsigned int) (n_marks > decoded ? n_marks - decoded : 0));
+
+    return wrong > 0 || decoded < min_decoded;
+}
+
+static const SCENARIO *
+find_scenario (const char * name)
+{
+    uint_fast8_t    i;
+
+    for (i = 0; i < N_SCENARIOS; i++)
+    {
+        if (! strcmp (scenarios[i].name, name))
+        {
+            return &scenarios[i];
+        }
+    }
+
+    fprintf (stderr, "unknown scenario: %s\n", name);
+    exit (2);
+}
+
+int
+main (int argc, char ** argv)
+{
+    const SCENARIO *    s;
+    uint_fast8_t        i;
+
+    if (argc == 4)
+    {
+        seed = strtoul (argv[3], NULL, 0) | 1;                          // xorshift needs a seed != 0
+        argc--;
+    }
+
+    rnd = seed;
+
+    if (argc == 2 && ! strcmp (argv[1], "-l"))
+    {
+        for (i = 0; i < N_SCENARIOS; i++)
+        {
+            printf ("%s\n", scenarios[i].name);
+        }
+        return 0;
+    }
+
+    if (argc == 3 && ! strcmp (argv[1], "-s"))
+    {
+        s = find_scenario (argv[2]);
+        render (s);
+        return decode (s->name, s->min_decoded);
+    }
+
+    if (argc == 3 && ! strcmp (argv[1], "-w"))
+    {
+        s = find_scenario (argv[2]);
+        render (s);
+        write_stream (s);
+        return 0;
+    }
+
+    if (argc == 3 && ! strcmp (argv[1], "-f"))
+    {
+        read_file (argv[2]);
+        return decode (strrchr (argv[2], '/') ? strrchr (argv[2], '/') + 1 : argv[2], n_marks * 3 / 4);
+    }
+
+    fprintf (stderr, "usage: %s -l | -s scenario [seed] | -w scenario [seed] | -f file\n", argv[0]);
+    return 2;
+}
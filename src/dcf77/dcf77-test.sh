@@ -0,0 +1,115 @@
+#!/bin/sh
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+# dcf77-test.sh - host test of DCF77 decoder
+#
+# usage: src/dcf77/dcf77-test.sh [edge files...]                default: src/dcf77/DCF77-Data/*.txt
+#
+# Builds dcf77.c together with dcf77-test.c on the host. The STM32 headers are replaced by a small stub header, the
+# timestamp timer TIM5 returns the simulated time of dcf77-test.c. Every synthetic scenario of dcf77-test.c (dcf77-test -l)
+# is decoded in a new process, because the decoder keeps its state in statics. Then the edge files are replayed. Each
+# scenario renders some minutes of DCF77 signal, with jitter, missing and wrong pulses, glitches and bursts of interference,
+# some of them across a CET/CEST switch. DCF77-Data/*.txt have been written with dcf77-test -w and other random numbers,
+# record real reception as lines "ms level" and add the expected times as lines "= ms YYYY-MM-DD HH:MM", see dcf77-test.c.
+#
+# Columns: expected minute marks, decoded times, wrong times, minute marks without time. Fails if a time is wrong or too
+# few times have been decoded.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+
+DCF77_DIR=$(dirname "$0")
+SRC_DIR=$DCF77_DIR/..
+
+if [ $# -eq 0 ]
+then
+    set -- "$DCF77_DIR"/DCF77-Data/*.txt
+fi
+
+TMP_DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+cat > "$TMP_DIR"/stm32f4xx.h << 'STUB'
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+#include <stdint.h>
+typedef enum { RESET = 0, SET = !RESET } BitAction;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+typedef struct { int GPIO_Pin, GPIO_Speed, GPIO_Mode, GPIO_PuPd, GPIO_OType; } GPIO_InitTypeDef;
+typedef struct { int EXTI_Line, EXTI_Mode, EXTI_Trigger, EXTI_LineCmd; } EXTI_InitTypeDef;
+typedef struct { int TIM_ClockDivision, TIM_CounterMode, TIM_Period, TIM_Prescaler; } TIM_TimeBaseInitTypeDef;
+typedef struct { int NVIC_IRQChannel, NVIC_IRQChannelCmd, NVIC_IRQChannelPreemptionPriority, NVIC_IRQChannelSubPriority; } NVIC_InitTypeDef;
+#define Bit_RESET                       RESET
+#define GPIOC                           0
+#define GPIO_Pin_11                     0x0800
+#define GPIO_Pin_12                     0x1000
+#define GPIO_Speed_2MHz                 0
+#define GPIO_Mode_IN                    0
+#define GPIO_Mode_OUT                   1
+#define GPIO_PuPd_NOPULL                0
+#define GPIO_OType_PP                   0
+#define RCC_AHB1Periph_GPIOC            0
+#define RCC_APB1Periph_TIM5             0
+#define RCC_APB2Periph_SYSCFG           0
+#define EXTI_PortSourceGPIOC            0
+#define EXTI_PinSource11                0
+#define EXTI_Line11                     0
+#define EXTI15_10_IRQn                  0
+#define EXTI_Mode_Interrupt             0
+#define EXTI_Trigger_Rising_Falling     0
+#define TIM5                            0
+#define TIM_CKD_DIV1                    0
+#define TIM_CounterMode_Up              0
+#define GPIO_StructInit(...)            ((void) 0)
+#define GPIO_Init(...)                  ((void) 0)
+#define GPIO_WriteBit(...)              ((void) 0)
+#define GPIO_ReadInputDataBit(...)      Bit_RESET
+#define RCC_AHB1PeriphClockCmd(...)     ((void) 0)
+#define RCC_APB1PeriphClockCmd(...)     ((void) 0)
+#define RCC_APB2PeriphClockCmd(...)     ((void) 0)
+#define SYSCFG_EXTILineConfig(...)      ((void) 0)
+#define EXTI_StructInit(...)            ((void) 0)
+#define EXTI_Init(...)                  ((void) 0)
+#define EXTI_GetITStatus(...)           RESET
+#define EXTI_ClearITPendingBit(...)     ((void) 0)
+#define TIM_TimeBaseStructInit(...)     ((void) 0)
+#define TIM_TimeBaseInit(...)           ((void) 0)
+#define TIM_Cmd(...)                    ((void) 0)
+#define TIM_GetCounter(...)             dcf77_test_get_ticks ()
+#define NVIC_Init(...)                  ((void) 0)
+extern uint32_t dcf77_test_get_ticks (void);
+#endif
+STUB
+
+for h in stm32f4xx_gpio.h stm32f4xx_usart.h stm32f4xx_rcc.h misc.h
+do
+    echo '#include "stm32f4xx.h"' > "$TMP_DIR"/$h
+done
+
+$CC $CFLAGS -DSTM32F4XX -DSTM32F401RE -I"$TMP_DIR" -I"$SRC_DIR" -I"$DCF77_DIR" -I"$SRC_DIR"/event -I"$SRC_DIR"/eeprom -I"$SRC_DIR"/log \
+    -I"$SRC_DIR"/uart -I"$SRC_DIR"/softclock -I"$SRC_DIR"/board-led \
+    -o "$TMP_DIR"/dcf77-test "$DCF77_DIR"/dcf77.c "$DCF77_DIR"/dcf77-test.c || exit 1
+
+rtc=0
+printf "%-20s %7s %7s %7s %7s\n" "scenario" "marks" "decoded" "wrong" "missed"
+
+for s in $("$TMP_DIR"/dcf77-test -l)
+do
+    "$TMP_DIR"/dcf77-test -s $s || rtc=1
+done
+
+for f in "$@"
+do
+    if [ -f "$f" ]
+    then
+        "$TMP_DIR"/dcf77-test -f "$f" || rtc=1
+    fi
+done
+
+[ $rtc -eq 0 ] && echo "ok" || echo "FAILED"
+exit $rtc
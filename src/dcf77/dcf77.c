@@ -3,6 +3,26 @@
  *
  * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
  *
+ * Every edge of the DCF77 signal is timestamped in hardware with a resolution of 100 us and queued with its level as
+ * EVENT_DCF77_EDGE, see event.h:
+ *
+ *  - STM32F4x1: PC11 has no timer channel. EXTI11 triggers on both edges and reads the free running 32 bit TIM5.
+ *  - STM32F103: PB8 is TIM4_CH3. The input capture toggles its polarity on every edge, the 16 bit counter is
+ *    extended to 32 bit by counting the update interrupts.
+ *
+ * The main loop passes the events to dcf77_edge_event(), so pulse widths do not depend on main loop latency.
+ * dcf77_tick() checks the timeouts. The time of the minute mark is stored, so dcf77_time() can tell the caller how
+ * long ago the decoded minute began.
+ *
+ * Pulse widths are stored as soft bits: -50 for 100 ms (0) ... +50 for 200 ms (1), 0 for an invalid or missing pulse.
+ * A single error does not drop the frame. Instead every frame is correlated with all possible values of each field
+ * (minute, hour, day, weekday, month, year). The scores are accumulated over frames, taking into account that the
+ * minute advances with every frame. The time is valid, if a frame is error free or if the best value of every field
+ * leads by DCF77_LOCK_MARGIN, see dcf77_frame().
+ *
+ * Reception quality is recorded in a DCF77_STATS structure, see dcf77_get_stats(): a rolling histogram of pulse
+ * widths, good and bad frames per minute, parity errors per field, glitches, lost minute marks and time of last sync.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -15,7 +35,9 @@
 #include "eeprom.h"
 #include "eeprom-data.h"
 #include "log.h"
+#include "softclock.h"
 #include "board-led.h"
+#include "event.h"
 
 #if defined (STM32F401RE) || defined (STM32F411RE)        // STM32F401 / STM32F411 Nucleo Board: DATA=PC11 PON=PC12
 
@@ -29,6 +51,18 @@
 #  define DCF77_PON_PORT                GPIOC
 #  define DCF77_PON_PIN                 GPIO_Pin_12
 
+#  define DCF77_EXTI_PORT_SOURCE        EXTI_PortSourceGPIOC
+#  define DCF77_EXTI_PIN_SOURCE         EXTI_PinSource11
+#  define DCF77_EXTI_LINE               EXTI_Line11
+#  define DCF77_IRQ_CHANNEL             EXTI15_10_IRQn
+#  define DCF77_IRQ_HANDLER             dcf77_exti_isr          // EXTI15_10_IRQHandler is shared with IR, see main.c
+
+#  define DCF77_TIM_CLOCK_CMD           RCC_APB1PeriphClockCmd
+#  define DCF77_TIM_CLOCK               RCC_APB1Periph_TIM5
+#  define DCF77_TIM                     TIM5                    // 32 bit timer
+#  define DCF77_TIM_PERIOD              0xFFFFFFFF
+#  define DCF77_TIM_CLK                 84000000L               // timer clock, 84MHz on STM32F401/411 Nucleo Board
+
 #elif defined (STM32F103)                                   // STM32F103 Mini Development Board: DATA=PB8 PON=PB9
 
 #  define DCF77_DATA_PERIPH_CLOCK_CMD   RCC_APB2PeriphClockCmd
@@ -41,51 +75,292 @@
 #  define DCF77_PON_PORT                GPIOB
 #  define DCF77_PON_PIN                 GPIO_Pin_9
 
+#  define DCF77_TIM_CLOCK_CMD           RCC_APB1PeriphClockCmd
+#  define DCF77_TIM_CLOCK               RCC_APB1Periph_TIM4
+#  define DCF77_TIM                     TIM4                    // 16 bit timer, PB8 = TIM4_CH3
+#  define DCF77_TIM_PERIOD              0xFFFF
+#  define DCF77_TIM_CLK                 72000000L               // timer clock, 72MHz on STM32F103
+#  define DCF77_TIM_CHANNEL             TIM_Channel_3
+#  define DCF77_TIM_IT_CC               TIM_IT_CC3
+#  define DCF77_TIM_GET_CAPTURE         TIM_GetCapture3
+#  define DCF77_TIM_CCER_CCP            TIM_CCER_CC3P
+#  define DCF77_IRQ_CHANNEL             TIM4_IRQn
+#  define DCF77_IRQ_HANDLER             TIM4_IRQHandler
+
 #else
 #  error STM32 unknown
 #endif
 
+#define DCF77_TICKS_PER_SEC             10000                   // timestamp resolution: 100 us
+#define DCF77_TICKS_PER_MS              (DCF77_TICKS_PER_SEC / 1000)
+#define DCF77_TIM_PRESCALER             (DCF77_TIM_CLK / DCF77_TICKS_PER_SEC - 1)
+
+
+#define DCF77_GLITCH_MS                 20                      // ignore pulses shorter than 20 ms
+#define DCF77_MIN_PULSE_MS              50                      // high pulse: 100 ms = 0, 200 ms = 1
+#define DCF77_MAX_PULSE_MS              250
+#define DCF77_PULSE_1_MS                150
+#define DCF77_MIN_PAUSE_MS              750                     // low: 800 or 900 ms, 1800 or 1900 ms at minute mark
+#define DCF77_MINUTE_MARK_MS            1200
+
+static uint_fast8_t                     has_pending;            // flag: edge waits for glitch check
+static uint32_t                         pending_ticks;          // timestamp of pending edge
+static uint_fast8_t                     pending_level;          // level after pending edge
+static uint32_t                         lost_edges;             // last value of event_overflows[EVENT_DCF77_EDGE]
+
+#if defined (STM32F103)
+static volatile uint32_t                dcf77_ticks_high;       // upper 16 bits of timestamps
+#endif
+
 static uint_fast8_t                     time_is_valid = 0;
+static struct tm                        minute_mark_tm;         // decoded time, valid from last minute mark on
+static uint32_t                         minute_mark_ticks;      // timestamp of last minute mark
 
 #define STATE_PON                       0xFF                    // wait 1 sec, then set PON to GND (only for very old Pollin DCF1 versions)
-#define STATE_UNKNOWN                   0
-#define STATE_WAIT                      1
-#define STATE_0                         2
-#define STATE_1                         3
-
-static uint_fast8_t                     isdst;
-static uint_fast8_t                     minute;
-static uint_fast8_t                     hour;
-static uint_fast8_t                     wday;
-static uint_fast8_t                     mday;
-static uint_fast8_t                     month;
-static uint_fast16_t                    year;
+#define STATE_UNKNOWN                   0                       // wait for minute mark
+#define STATE_SYNC                      1                       // second positions known from last minute mark
+
+#define DCF77_FRAME_BITS                59                      // bits 0...58, second 59 has no pulse
+#define DCF77_BIT_A1                    16                      // announcement of CET/CEST switch, set during the hour before
+#define DCF77_BIT_Z1                    17                      // 1 = CEST
+#define DCF77_BIT_Z2                    18                      // 1 = CET
+#define DCF77_ZONE_UNKNOWN              0
+#define DCF77_ZONE_CET                  1
+#define DCF77_ZONE_CEST                 2
+#define DCF77_MIN_A1_FRAMES             10                      // min. frames with A1 in the hour before a zone switch
+#define DCF77_ZONE_FRAMES               3                       // change zone without A1 after 3 frames with other Z1/Z2
+#define DCF77_SECOND_WINDOW_MS          50                      // pulse must begin within +/- 50 ms of second position
+#define DCF77_SOFT_MAX                  50                      // soft bit: -50 = 100 ms pulse (0), +50 = 200 ms pulse (1)
+#define DCF77_LOCK_MARGIN               200                     // min. score margin of each field for a voted time
+#define DCF77_STRICT_MARGIN             150                     // min. score margin for an error free frame: 2 frames agree
+#define DCF77_SCORE_DECAY               3                       // scores lose 1/8 per frame
+#define DCF77_MIN_PULSES                30                      // frames with less valid pulses are bad
+#define DCF77_MAX_BAD_FRAMES            3                       // lose sync after 3 bad frames in a row
+#define DCF77_MAX_INVALID_FRAMES        3                       // sync again to minute mark within frame after 3 frames without time
+#define DCF77_HISTOGRAM_WINDOW          600                     // halve histogram every 600 pulses (10 minutes)
+
+#define DCF77_PARITY_OK                 0
+#define DCF77_PARITY_ERROR              1
+#define DCF77_PARITY_INCOMPLETE         2                       // pulse missing, parity unknown
+
+typedef struct
+{
+    uint8_t                             first_bit;              // first bit in frame
+    uint8_t                             n_bits;                 // number of BCD bits
+    uint8_t                             parity_bit;             // parity bit of field, 0 = none
+    uint8_t                             min_value;              // smallest value, e.g. 1 for day of month
+    uint8_t                             n_values;               // number of values
+    int16_t *                           scores;                 // score of every value, see dcf77_vote()
+} DCF77_FIELD;
+
+#define DCF77_FIELD_MINUTE              0
+#define DCF77_FIELD_HOUR                1
+#define DCF77_FIELD_MDAY                2
+#define DCF77_FIELD_WDAY                3
+#define DCF77_FIELD_MONTH               4
+#define DCF77_FIELD_YEAR                5
+#define DCF77_FIELDS                    6
+
+static int16_t                          minute_scores[60];
+static int16_t                          hour_scores[24];
+static int16_t                          mday_scores[31];
+static int16_t                          wday_scores[7];
+static int16_t                          month_scores[12];
+static int16_t                          year_scores[100];
+
+static const DCF77_FIELD                fields[DCF77_FIELDS] =
+{
+    { 21, 7, 28, 0,  60, minute_scores },                       // minute, parity P1
+    { 29, 6, 35, 0,  24, hour_scores   },                       // hour, parity P2
+    { 36, 6,  0, 1,  31, mday_scores   },                       // day of month, parity P3 covers bits 36...57
+    { 42, 3,  0, 1,   7, wday_scores   },                       // day of week, 1 = monday
+    { 45, 5,  0, 1,  12, month_scores  },                       // month
+    { 50, 8,  0, 0, 100, year_scores   },                       // year
+};
+
+static uint_fast8_t                     dcf77_state = STATE_PON;
+static uint32_t                         second0_ticks;          // begin of current minute (second 0)
+static uint32_t                         pulse_ticks;            // begin of current pulse
+static uint_fast8_t                     pulse_second = 0xff;    // second of current pulse, 0xff = no pulse
+static int8_t                           soft_bits[DCF77_FRAME_BITS];    // soft bits of current frame, 0 = no valid pulse
+static uint_fast8_t                     frame_pulses;           // number of valid pulses in current frame
+static uint_fast8_t                     bad_frames;             // number of bad frames in a row
+static uint_fast16_t                    confidence;             // min. score margin of all fields of last frame
+static uint_fast8_t                     zone = DCF77_ZONE_UNKNOWN;  // time zone of last frame with valid Z1/Z2
+static uint_fast8_t                     a1_frames;              // frames with A1 in current hour
+static uint_fast8_t                     zone_frames;            // frames in a row with other Z1/Z2 than zone
+
+static uint_fast8_t                     invalid_frames;         // frames in a row without valid time
+static uint64_t                         pause_seconds;          // bit n: pause longer than minute mark before second n
+static uint64_t                         last_pause_seconds;     // pause_seconds of last frame
+static uint64_t                         repeated_pause_seconds; // pause_seconds of last two frames
+
+static const uint8_t                    parity_bits[DCF77_PARITY_FIELDS][2] =
+{
+    { 21, 28 },                                                 // P1: minute
+    { 29, 35 },                                                 // P2: hour
+    { 36, 58 },                                                 // P3: date
+};
+
+static DCF77_STATS                      dcf77_stats;
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: get current timestamp
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint32_t
+dcf77_get_ticks (void)
+{
+#if defined (STM32F103)
+    uint32_t    high;
+    uint16_t    low;
+
+    __disable_irq();
+    high    = dcf77_ticks_high;
+    low     = TIM_GetCounter (DCF77_TIM);
+
+    if (TIM_GetFlagStatus (DCF77_TIM, TIM_FLAG_Update) != RESET && low < 0x8000)   // overflow not handled yet
+    {
+        high++;
+    }
+    __enable_irq();
+
+    return (high << 16) | low;
+#else
+    return TIM_GetCounter (DCF77_TIM);
+#endif
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: queue edge (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_put_edge (uint32_t ticks, uint_fast8_t level)
+{
+    (void) event_put_timestamp (EVENT_DCF77_EDGE, level, ticks);
+}
+
+#if defined (STM32F103)
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * TIM4 IRQ handler: input capture of DCF77 edges and counter overflow
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+DCF77_IRQ_HANDLER (void)
+{
+    uint32_t        high;
+    uint16_t        capture;
+    uint_fast8_t    level;
+
+    if (TIM_GetITStatus (DCF77_TIM, DCF77_TIM_IT_CC) != RESET)                 // flag is cleared by reading capture register
+    {
+        capture = DCF77_TIM_GET_CAPTURE (DCF77_TIM);
+        high    = dcf77_ticks_high;
+
+        if (TIM_GetITStatus (DCF77_TIM, TIM_IT_Update) != RESET && capture < 0x8000)   // captured after overflow
+        {
+            high++;
+        }
+
+        level = (DCF77_TIM->CCER & DCF77_TIM_CCER_CCP) ? 0 : 1;                 // falling edge captured: level is 0
+        DCF77_TIM->CCER ^= DCF77_TIM_CCER_CCP;                                  // capture the opposite edge next time
+        dcf77_put_edge ((high << 16) | capture, level);
+    }
+
+    if (TIM_GetITStatus (DCF77_TIM, TIM_IT_Update) != RESET)
+    {
+        TIM_ClearITPendingBit (DCF77_TIM, TIM_IT_Update);
+        dcf77_ticks_high++;
+    }
+}
+#else
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * EXTI IRQ handler: timestamp DCF77 edges
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+DCF77_IRQ_HANDLER (void)
+{
+    uint32_t    ticks = TIM_GetCounter (DCF77_TIM);
+
+    if (EXTI_GetITStatus (DCF77_EXTI_LINE) != RESET)
+    {
+        EXTI_ClearITPendingBit (DCF77_EXTI_LINE);
+        dcf77_put_edge (ticks, GPIO_ReadInputDataBit (DCF77_DATA_PORT, DCF77_DATA_PIN) == Bit_RESET ? 0 : 1);
+    }
+}
+#endif
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * DCF77 get time
+ *
+ * tm:          time of last minute mark
+ * age_ms:      time since last minute mark in ms
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
-dcf77_time (struct tm * tm)
+dcf77_time (struct tm * tm, uint_fast16_t * age_ms)
 {
     uint_fast8_t    rtc = time_is_valid;
 
     if (time_is_valid)
     {
-        tm->tm_year     = year + 100;                   // tm_year begins with 1900
-        tm->tm_mon      = month - 1;                    // tm_month begins with 0
-        tm->tm_mday     = mday;
-        tm->tm_wday     = wday == 7 ? 0 : wday;
-        tm->tm_isdst    = 0;
-        tm->tm_hour     = hour;
-        tm->tm_min      = minute;
-        tm->tm_sec      = 0;
-
+        *tm             = minute_mark_tm;
+        *age_ms         = (dcf77_get_ticks () - minute_mark_ticks) / DCF77_TICKS_PER_MS;
         time_is_valid   = 0;
     }
     return rtc;
 }
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * DCF77 get confidence of last frame: smallest score margin of all fields, each bit of an error free frame adds 100
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast16_t
+dcf77_get_confidence (void)
+{
+    return confidence;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * DCF77 get reception statistics
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+const DCF77_STATS *
+dcf77_get_stats (void)
+{
+    return &dcf77_stats;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: add pulse width to rolling histogram
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_histogram (uint32_t ms)
+{
+    uint_fast8_t    bin = ms / DCF77_HISTOGRAM_BIN_MS;
+    uint_fast8_t    i;
+
+    if (bin >= DCF77_HISTOGRAM_BINS)
+    {
+        bin = DCF77_HISTOGRAM_BINS - 1;
+    }
+
+    if (++dcf77_stats.histogram_pulses >= DCF77_HISTOGRAM_WINDOW)          // old pulses lose weight
+    {
+        for (i = 0; i < DCF77_HISTOGRAM_BINS; i++)
+        {
+            dcf77_stats.histogram[i] >>= 1;
+        }
+
+        dcf77_stats.histogram_pulses = 0;
+    }
+
+    dcf77_stats.histogram[bin]++;
+}
+
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * set pon (high)
  *-------------------------------------------------------------------------------------------------------------------------------------------
@@ -106,6 +381,67 @@ dcf77_pon_reset (void)
     GPIO_WriteBit(DCF77_PON_PORT, DCF77_PON_PIN, RESET);
 }
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: initialize timestamp timer and edge interrupt
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_capture_init (void)
+{
+    TIM_TimeBaseInitTypeDef     tim;
+    NVIC_InitTypeDef            nvic;
+#if defined (STM32F103)
+    TIM_ICInitTypeDef           ic;
+#else
+    EXTI_InitTypeDef            exti;
+#endif
+
+    TIM_TimeBaseStructInit (&tim);
+    DCF77_TIM_CLOCK_CMD (DCF77_TIM_CLOCK, ENABLE);
+
+    tim.TIM_ClockDivision   = TIM_CKD_DIV1;
+    tim.TIM_CounterMode     = TIM_CounterMode_Up;
+    tim.TIM_Period          = DCF77_TIM_PERIOD;                         // free running
+    tim.TIM_Prescaler       = DCF77_TIM_PRESCALER;
+    TIM_TimeBaseInit (DCF77_TIM, &tim);
+
+#if defined (STM32F103)
+    TIM_ICStructInit (&ic);
+    ic.TIM_Channel          = DCF77_TIM_CHANNEL;
+    ic.TIM_ICPolarity       = TIM_ICPolarity_Rising;                    // polarity is toggled in ISR
+    ic.TIM_ICSelection      = TIM_ICSelection_DirectTI;
+    ic.TIM_ICPrescaler      = TIM_ICPSC_DIV1;
+    ic.TIM_ICFilter         = 0x0F;                                     // strongest digital filter
+    TIM_ICInit (DCF77_TIM, &ic);
+
+    if (GPIO_ReadInputDataBit (DCF77_DATA_PORT, DCF77_DATA_PIN) != Bit_RESET)
+    {
+        DCF77_TIM->CCER |= DCF77_TIM_CCER_CCP;                          // signal is high, wait for falling edge
+    }
+
+    TIM_ClearITPendingBit (DCF77_TIM, DCF77_TIM_IT_CC | TIM_IT_Update);
+    TIM_ITConfig (DCF77_TIM, DCF77_TIM_IT_CC | TIM_IT_Update, ENABLE);
+#else
+    RCC_APB2PeriphClockCmd (RCC_APB2Periph_SYSCFG, ENABLE);
+    SYSCFG_EXTILineConfig (DCF77_EXTI_PORT_SOURCE, DCF77_EXTI_PIN_SOURCE);
+
+    EXTI_StructInit (&exti);
+    exti.EXTI_Line          = DCF77_EXTI_LINE;
+    exti.EXTI_Mode          = EXTI_Mode_Interrupt;
+    exti.EXTI_Trigger       = EXTI_Trigger_Rising_Falling;
+    exti.EXTI_LineCmd       = ENABLE;
+    EXTI_Init (&exti);
+#endif
+
+    nvic.NVIC_IRQChannel                    = DCF77_IRQ_CHANNEL;
+    nvic.NVIC_IRQChannelCmd                 = ENABLE;
+    nvic.NVIC_IRQChannelPreemptionPriority  = 0x00;                     // short ISR, highest priority: exact timestamps
+    nvic.NVIC_IRQChannelSubPriority         = 0x00;
+    NVIC_Init (&nvic);
+
+    TIM_Cmd (DCF77_TIM, ENABLE);
+}
+
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * DCF77 init
  *-------------------------------------------------------------------------------------------------------------------------------------------
@@ -149,265 +485,651 @@ dcf77_init (void)
     GPIO_Init(DCF77_PON_PORT, &gpio);
 
     dcf77_pon_set ();                           // Pollin DCF modules want a pulse on PON
+
+    dcf77_capture_init ();
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * DCF77 tick - statemachine, called every 1/100 of a second
+ * INTERN: reset scores of date fields
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
-void
-dcf77_tick (void)
+static void
+dcf77_reset_date_scores (void)
+{
+    memset (mday_scores, 0, sizeof (mday_scores));
+    memset (wday_scores, 0, sizeof (wday_scores));
+    memset (month_scores, 0, sizeof (month_scores));
+    memset (year_scores, 0, sizeof (year_scores));
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: reset all scores, e.g. after loss of sync
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_reset_scores (void)
+{
+    memset (minute_scores, 0, sizeof (minute_scores));
+    memset (hour_scores, 0, sizeof (hour_scores));
+    dcf77_reset_date_scores ();
+    bad_frames = 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: start new frame, second 0 begins with ticks
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_start_frame (uint32_t ticks)
 {
-    static uint_fast8_t cnt         = 0;
-    static uint_fast8_t state       = STATE_PON;
-    static uint_fast8_t last_pin    = 0;
-    static uint_fast8_t bitno       = 0xff;
-    static uint_fast8_t p1          = 0;
-    static uint_fast8_t p2          = 0;
-    static uint_fast8_t p3          = 0;
-    uint_fast16_t       pin;
+    memset (soft_bits, 0, sizeof (soft_bits));
+    repeated_pause_seconds  = last_pause_seconds & pause_seconds;
+    last_pause_seconds      = pause_seconds;
+    pause_seconds           = 0;
+    frame_pulses    = 0;
+    second0_ticks   = ticks;
+    pulse_second    = 0xff;
+}
 
-    if (state == STATE_PON)                             // pseudo state: wait 1 sec before resetting PON after boot
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: BCD value of field with even parity bit in bit n_bits
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast16_t
+dcf77_bcd (const DCF77_FIELD * f, uint_fast8_t value)
+{
+    uint_fast16_t   bcd = ((value / 10) << 4) | (value % 10);
+    uint_fast16_t   b;
+    uint_fast8_t    parity = 0;
+
+    for (b = bcd; b; b >>= 1)
     {
-        static uint_fast8_t pon_cnt = 0;
+        parity ^= b & 0x01;
+    }
 
-        if (pon_cnt == 100)
+    return bcd | (parity << f->n_bits);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: correlate soft bits of frame with a field value
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static int_fast16_t
+dcf77_correlate (const DCF77_FIELD * f, uint_fast8_t value)
+{
+    uint_fast16_t   bcd     = dcf77_bcd (f, value);
+    int_fast16_t    score   = 0;
+    uint_fast8_t    i;
+
+    for (i = 0; i < f->n_bits; i++)
+    {
+        score += (bcd & (1 << i)) ? soft_bits[f->first_bit + i] : -soft_bits[f->first_bit + i];
+    }
+
+    if (f->parity_bit)
+    {
+        score += (bcd & (1 << f->n_bits)) ? soft_bits[f->parity_bit] : -soft_bits[f->parity_bit];
+    }
+
+    return score;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: get value with best score of a field
+ *
+ * Return value: margin of best score to second best score
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast16_t
+dcf77_best (const DCF77_FIELD * f, uint_fast8_t * valuep)
+{
+    int_fast16_t    best    = INT16_MIN;
+    int_fast16_t    second  = INT16_MIN;
+    uint_fast8_t    i;
+
+    for (i = 0; i < f->n_values; i++)
+    {
+        if (f->scores[i] > best)
         {
-            dcf77_pon_reset ();
-            state = STATE_UNKNOWN;                      // start state machine now!
+            second  = best;
+            best    = f->scores[i];
+            *valuep = f->min_value + i;
         }
-        else
+        else if (f->scores[i] > second)
         {
-            pon_cnt++;
+            second  = f->scores[i];
         }
-
-        return;
     }
 
-    if (GPIO_ReadInputDataBit(DCF77_DATA_PORT, DCF77_DATA_PIN) == Bit_RESET)
+    return best - second;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: rotate scores by one value, e.g. minute 17 of last frame is minute 18 now
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_rotate (const DCF77_FIELD * f)
+{
+    int16_t         last = f->scores[f->n_values - 1];
+    uint_fast8_t    i;
+
+    for (i = f->n_values - 1; i > 0; i--)
     {
-        board_led_off ();
-        pin = 0;
+        f->scores[i] = f->scores[i - 1];
     }
-    else
+
+    f->scores[0] = last;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: add soft bits of frame to scores of all fields
+ *
+ * Every frame carries the time of the following minute, so minute scores are rotated by one before the frame is added,
+ * hour scores if the best minute was 59, date scores are reset at midnight. Old scores decay, so a wrong lock vanishes.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_vote (void)
+{
+    const DCF77_FIELD * f;
+    uint_fast8_t        minute;
+    uint_fast8_t        hour;
+    uint_fast8_t        idx;
+    uint_fast8_t        i;
+
+    (void) dcf77_best (&fields[DCF77_FIELD_MINUTE], &minute);
+    (void) dcf77_best (&fields[DCF77_FIELD_HOUR], &hour);
+
+    dcf77_rotate (&fields[DCF77_FIELD_MINUTE]);
+
+    if (minute == 59)
     {
-        board_led_on();
-        pin = 1;
+        dcf77_rotate (&fields[DCF77_FIELD_HOUR]);
+
+        if (hour == 23)
+        {
+            dcf77_reset_date_scores ();
+        }
     }
 
-    switch (state)
+    for (idx = 0; idx < DCF77_FIELDS; idx++)
     {
-        case STATE_UNKNOWN:
+        f = &fields[idx];
+
+        for (i = 0; i < f->n_values; i++)
         {
-            state = STATE_WAIT;
-            last_pin = pin;
-            break;
+            f->scores[i] -= f->scores[i] >> DCF77_SCORE_DECAY;
+            f->scores[i] += dcf77_correlate (f, f->min_value + i);
         }
-        case STATE_WAIT:
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: follow CET/CEST switch, called before the frame is added to the scores
+ *
+ * A1 announces a switch during the hour before. At the next full hour the hour advances by 2 (CET -> CEST) or stays
+ * (CEST -> CET), so the hour scores are rotated once more or once less than usual. Otherwise the rotated hour scores
+ * of the old zone would outvote the new hour for several frames. If A1 has been seen too seldom, e.g. after a reset
+ * during the announcement, the hour scores are reset if Z1/Z2 flip at the full hour. Outside of a switch, Z1/Z2 must
+ * differ in DCF77_ZONE_FRAMES frames in a row before the zone is changed.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_zone (void)
+{
+    uint_fast8_t    announced = a1_frames > 0;
+    uint_fast8_t    frame_zone;
+    uint_fast8_t    minute;
+    uint_fast8_t    i;
+
+    (void) dcf77_best (&fields[DCF77_FIELD_MINUTE], &minute);
+
+    if (minute == 59)                                                       // frame begins a new hour
+    {
+        if (a1_frames >= DCF77_MIN_A1_FRAMES && zone != DCF77_ZONE_UNKNOWN)
         {
-            if (last_pin != pin)
+            if (zone == DCF77_ZONE_CET)                                     // 02:00 CET is 03:00 CEST
+            {
+                dcf77_rotate (&fields[DCF77_FIELD_HOUR]);
+                zone = DCF77_ZONE_CEST;
+            }
+            else                                                            // 03:00 CEST is 02:00 CET
             {
-                state = (pin == 0) ? STATE_0 : STATE_1;
-                last_pin = pin;
-                bitno = 0xff;
-                cnt = 0;
+                for (i = 1; i < fields[DCF77_FIELD_HOUR].n_values; i++)
+                {
+                    dcf77_rotate (&fields[DCF77_FIELD_HOUR]);
+                }
+                zone = DCF77_ZONE_CET;
             }
-            break;
+
+            log_printf ("DCF77: switch to %s\r\n", zone == DCF77_ZONE_CEST ? "CEST" : "CET");
+            zone_frames = 0;
+        }
+
+        a1_frames = 0;
+    }
+
+    if (soft_bits[DCF77_BIT_A1] > 0 && a1_frames < 0xFF)
+    {
+        a1_frames++;
+    }
+
+    if (soft_bits[DCF77_BIT_Z1] > 0 && soft_bits[DCF77_BIT_Z2] < 0)
+    {
+        frame_zone = DCF77_ZONE_CEST;
+    }
+    else if (soft_bits[DCF77_BIT_Z1] < 0 && soft_bits[DCF77_BIT_Z2] > 0)
+    {
+        frame_zone = DCF77_ZONE_CET;
+    }
+    else
+    {
+        return;                                                             // zone bits missing or invalid
+    }
+
+    if (zone == frame_zone)
+    {
+        zone_frames = 0;
+    }
+    else if (zone == DCF77_ZONE_UNKNOWN)
+    {
+        zone = frame_zone;
+    }
+    else if (minute == 59 && announced)                                     // switch without enough A1
+    {
+        log_printf ("DCF77: switch to %s\r\n", frame_zone == DCF77_ZONE_CEST ? "CEST" : "CET");
+        memset (hour_scores, 0, sizeof (hour_scores));
+        zone        = frame_zone;
+        zone_frames = 0;
+    }
+    else if (++zone_frames >= DCF77_ZONE_FRAMES)
+    {
+        zone        = frame_zone;
+        zone_frames = 0;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: check even parity of a field including its parity bit
+ *
+ * Return value: DCF77_PARITY_OK, DCF77_PARITY_ERROR or DCF77_PARITY_INCOMPLETE
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+dcf77_parity (uint_fast8_t parity_idx)
+{
+    uint_fast8_t    parity = 0;
+    uint_fast8_t    i;
+
+    for (i = parity_bits[parity_idx][0]; i <= parity_bits[parity_idx][1]; i++)
+    {
+        if (soft_bits[i] == 0)
+        {
+            return DCF77_PARITY_INCOMPLETE;
         }
-        case STATE_0:
+
+        parity ^= soft_bits[i] > 0;
+    }
+
+    return parity ? DCF77_PARITY_ERROR : DCF77_PARITY_OK;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: decode a frame with all pulses valid, check parity bits P1, P2, P3 and ranges
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+dcf77_decode_strict (uint_fast8_t * values)
+{
+    static const uint8_t    weights[8] = { 1, 2, 4, 8, 10, 20, 40, 80 };
+    const DCF77_FIELD *     f;
+    uint_fast8_t            parity_ok = 1;
+    uint_fast8_t            idx;
+    uint_fast8_t            i;
+
+    for (idx = 0; idx < DCF77_PARITY_FIELDS; idx++)
+    {
+        switch (dcf77_parity (idx))
         {
-            if (pin == last_pin)
+            case DCF77_PARITY_ERROR:
+                dcf77_stats.parity_errors[idx]++;
+                parity_ok = 0;
+                break;
+            case DCF77_PARITY_INCOMPLETE:
+                parity_ok = 0;
+                break;
+        }
+    }
+
+    if (! parity_ok || frame_pulses < DCF77_FRAME_BITS || soft_bits[20] <= 0)  // bit 20: begin of time, always 1
+    {
+        return 0;
+    }
+
+    for (idx = 0; idx < DCF77_FIELDS; idx++)
+    {
+        f = &fields[idx];
+        values[idx] = 0;
+
+        for (i = 0; i < f->n_bits; i++)
+        {
+            if (soft_bits[f->first_bit + i] > 0)
             {
-                cnt++;
+                values[idx] += weights[i];
             }
-            else
+        }
+
+        if (values[idx] < f->min_value || values[idx] >= f->min_value + f->n_values)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: frame complete, next minute begins with ticks
+ *
+ * The time is valid if the scores of all fields have a margin of DCF77_LOCK_MARGIN or more, e.g. after some noisy
+ * frames. Before that, a frame with all pulses valid and correct parity bits is accepted, if it matches the best
+ * scores with a margin of DCF77_STRICT_MARGIN, so at least one former frame agrees. Parity bits do not detect two
+ * wrong bits, so the scores always win. At a CET/CEST switch the hour scores are adjusted, see dcf77_zone().
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_frame (uint32_t ticks)
+{
+    uint_fast8_t    values[DCF77_FIELDS];
+    uint_fast8_t    voted[DCF77_FIELDS];
+    uint_fast16_t   margin;
+    uint_fast8_t    idx;
+    uint_fast8_t    strict;
+
+    dcf77_stats.frame_history <<= 1;
+
+    if (frame_pulses < DCF77_MIN_PULSES)
+    {
+        log_printf ("DCF77 Error: only %d valid pulses\r\n", frame_pulses);
+
+        if (++bad_frames >= DCF77_MAX_BAD_FRAMES)
+        {
+            log_msg ("DCF77 Error: lost sync");
+            dcf77_stats.bad_frames++;
+            dcf77_stats.sync_losses++;
+            dcf77_reset_scores ();
+            dcf77_state = STATE_UNKNOWN;
+            return;
+        }
+    }
+    else
+    {
+        bad_frames = 0;
+    }
+
+    strict = dcf77_decode_strict (values);
+    dcf77_zone ();
+    dcf77_vote ();
+
+    confidence = 0xFFFF;
+
+    for (idx = 0; idx < DCF77_FIELDS; idx++)
+    {
+        margin = dcf77_best (&fields[idx], &voted[idx]);
+
+        if (confidence > margin)
+        {
+            confidence = margin;
+        }
+    }
+
+    if (strict && (confidence < DCF77_STRICT_MARGIN || memcmp (values, voted, sizeof (values)) != 0))  // no former frame agrees
+    {
+        strict = 0;
+    }
+
+    if (strict || confidence >= DCF77_LOCK_MARGIN)
+    {
+        minute_mark_tm.tm_year  = voted[DCF77_FIELD_YEAR] + 100;           // tm_year begins with 1900
+        minute_mark_tm.tm_mon   = voted[DCF77_FIELD_MONTH] - 1;            // tm_month begins with 0
+        minute_mark_tm.tm_mday  = voted[DCF77_FIELD_MDAY];
+        minute_mark_tm.tm_wday  = voted[DCF77_FIELD_WDAY] == 7 ? 0 : voted[DCF77_FIELD_WDAY];
+        minute_mark_tm.tm_isdst = 0;
+        minute_mark_tm.tm_hour  = voted[DCF77_FIELD_HOUR];
+        minute_mark_tm.tm_min   = voted[DCF77_FIELD_MINUTE];
+        minute_mark_tm.tm_sec   = 0;
+        minute_mark_ticks       = ticks;
+
+        time_is_valid   = 1;
+        invalid_frames  = 0;
+
+        dcf77_stats.good_frames++;
+        dcf77_stats.frame_history  |= 0x01;
+        dcf77_stats.last_sync       = softclock_get_uptime ();
+    }
+    else
+    {
+        log_printf ("DCF77 Error: no valid frame, confidence %u\r\n", (unsigned int) confidence);
+        dcf77_stats.bad_frames++;
+
+        if (invalid_frames < DCF77_MAX_INVALID_FRAMES)
+        {
+            invalid_frames++;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: DCF77 statemachine, called for every edge
+ *
+ * level:       level after edge, 1 = pulse (reduced carrier)
+ * ticks:       timestamp of edge
+ *
+ * The minute mark (pause longer than 1.2 seconds) gives the second positions. After that, a pulse belongs to the
+ * second, in whose window it begins. Other edges are ignored, invalid pulse widths are stored as soft bit 0.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_edge (uint_fast8_t level, uint32_t ticks)
+{
+    static uint_fast8_t last_level  = 0xff;
+    static uint32_t     last_ticks  = 0;
+    uint_fast8_t        first_edge  = (last_level == 0xff);
+    uint32_t            ms;
+    uint32_t            pos;
+    uint_fast8_t        second;
+    int32_t             deviation;
+    int_fast16_t        soft;
+
+    if (level == last_level)                                // edge lost, e.g. glitch
+    {
+        return;
+    }
+
+    if (level)
+    {
+        board_led_on();
+    }
+    else
+    {
+        board_led_off ();
+    }
+
+    ms          = (ticks - last_ticks) / DCF77_TICKS_PER_MS;   // duration of last level
+
+    if (! level && last_level == 1)                         // end of pulse: ms is pulse width
+    {
+        dcf77_histogram (ms);
+    }
+
+    last_level  = level;
+    last_ticks  = ticks;
+
+    if (level)                                              // begin of pulse
+    {
+        pos         = ticks - second0_ticks;
+        second      = (pos + DCF77_TICKS_PER_SEC / 2) / DCF77_TICKS_PER_SEC;
+        deviation   = (int32_t) (pos - second * DCF77_TICKS_PER_SEC);
+
+        if (dcf77_state == STATE_SYNC && pos < 61 * DCF77_TICKS_PER_SEC &&
+            deviation <= DCF77_SECOND_WINDOW_MS * DCF77_TICKS_PER_MS && deviation >= -DCF77_SECOND_WINDOW_MS * DCF77_TICKS_PER_MS)
+        {
+            if (second == 60)                               // minute mark: next frame begins
             {
-                state = STATE_1;
-                last_pin = pin;
+                dcf77_frame (ticks);
 
-                if (cnt > 120)
+                if (dcf77_state != STATE_SYNC)
                 {
-                    bitno = 0;
-
-                    p1      = 0;
-                    p2      = 0;
-                    p3      = 0;
-
-                    isdst   = 0;
-                    minute  = 0;
-                    hour    = 0;
-                    wday    = 0;
-                    mday    = 0;
-                    month   = 0;
-                    year    = 0;
+                    return;
+                }
+
+                dcf77_start_frame (ticks);
+                second = 0;
+            }
+            else if (ms > DCF77_MINUTE_MARK_MS && second > 0)       // pause of minute mark within frame: missing pulse or wrong sync
+            {
+                if (invalid_frames >= DCF77_MAX_INVALID_FRAMES && (repeated_pause_seconds & ((uint64_t) 1 << second)))
+                {                                                   // same second in last frames without time: sync again
+                    log_msg ("DCF77 Error: minute mark out of sync");
+                    dcf77_stats.sync_losses++;
+                    dcf77_reset_scores ();
+                    dcf77_start_frame (ticks);
+                    last_pause_seconds  = 0;
+                    invalid_frames      = 0;
+                    second              = 0;
                 }
-                else if (cnt < 75)
+                else
                 {
-                    state = STATE_UNKNOWN;
+                    pause_seconds |= (uint64_t) 1 << second;
                 }
+            }
 
-                cnt = 0;
+            if (second < DCF77_FRAME_BITS)
+            {
+                pulse_ticks     = ticks;
+                pulse_second    = second;
             }
-            break;
         }
-        default: // STATE_1:
+        else if (ms > DCF77_MINUTE_MARK_MS && ! first_edge) // minute mark out of sync, start again, first edge has no duration
         {
-            if (pin == last_pin)
+            if (dcf77_state == STATE_SYNC)
             {
-                cnt++;
+                log_msg ("DCF77 Error: minute mark out of sync");
+                dcf77_stats.sync_losses++;
+                dcf77_reset_scores ();
             }
-            else
+
+            dcf77_state = STATE_SYNC;
+            dcf77_start_frame (ticks);
+            pulse_ticks     = ticks;
+            pulse_second    = 0;
+        }
+    }
+    else if (pulse_second != 0xff)                          // end of pulse
+    {
+        if (ms > DCF77_MIN_PULSE_MS && ms < DCF77_MAX_PULSE_MS && soft_bits[pulse_second] == 0)
+        {
+            soft = (int_fast16_t) ms - DCF77_PULSE_1_MS;
+
+            if (soft > DCF77_SOFT_MAX)
             {
-                state = STATE_0;
-                last_pin = pin;
+                soft = DCF77_SOFT_MAX;
+            }
+            else if (soft < -DCF77_SOFT_MAX)
+            {
+                soft = -DCF77_SOFT_MAX;
+            }
 
-                if (cnt <= 5 || cnt >= 25)
-                {
-                    if (cnt <= 5)
-                    {
-                        log_msg ("DCF77 Error: High pulse <= 5");
-                    }
-                    else
-                    {
-                        log_msg ("DCF77 Error: High pulse >= 25");
-                    }
-
-                    state = STATE_UNKNOWN;
-                }
-                else if (cnt > 15)
-                {
-                    switch (bitno)
-                    {
-                        case 17: isdst   =  1; break;
-
-                        case 21: minute +=  1; p1++; break;
-                        case 22: minute +=  2; p1++; break;
-                        case 23: minute +=  4; p1++; break;
-                        case 24: minute +=  8; p1++; break;
-                        case 25: minute += 10; p1++; break;
-                        case 26: minute += 20; p1++; break;
-                        case 27: minute += 40; p1++; break;
-
-                        case 28:
-                        {
-                            if (! (p1 & 0x01))
-                            {
-                                log_msg ("DCF77 Error: parity P1 incorrect");
-                                state = STATE_UNKNOWN;
-                            }
-                            break;
-                        }
-
-                        case 29: hour   +=  1; p2++; break;
-                        case 30: hour   +=  2; p2++; break;
-                        case 31: hour   +=  4; p2++; break;
-                        case 32: hour   +=  8; p2++; break;
-                        case 33: hour   += 10; p2++; break;
-                        case 34: hour   += 20; p2++; break;
-
-                        case 35:
-                        {
-                            if (! (p2 & 0x01))
-                            {
-                                log_msg ("DCF77 Error: parity P2 incorrect");
-                                state = STATE_UNKNOWN;
-                            }
-                            break;
-                        }
-
-                        case 36: mday   +=  1; p3++; break;
-                        case 37: mday   +=  2; p3++; break;
-                        case 38: mday   +=  4; p3++; break;
-                        case 39: mday   +=  8; p3++; break;
-                        case 40: mday   += 10; p3++; break;
-                        case 41: mday   += 20; p3++; break;
-
-                        case 42: wday   +=  1; p3++; break;
-                        case 43: wday   +=  2; p3++; break;
-                        case 44: wday   +=  4; p3++; break;
-
-                        case 45: month  +=  1; p3++; break;
-                        case 46: month  +=  2; p3++; break;
-                        case 47: month  +=  4; p3++; break;
-                        case 48: month  +=  8; p3++; break;
-                        case 49: month  += 10; p3++; break;
-
-                        case 50: year   +=  1; p3++; break;
-                        case 51: year   +=  2; p3++; break;
-                        case 52: year   +=  4; p3++; break;
-                        case 53: year   +=  8; p3++; break;
-                        case 54: year   += 10; p3++; break;
-                        case 55: year   += 20; p3++; break;
-                        case 56: year   += 40; p3++; break;
-                        case 57: year   += 80; p3++; break;
-
-                        case 58:
-                        {
-                            if (! (p3 & 0x01))
-                            {
-                                log_msg ("DCF77 Error: parity P3 incorrect");
-                                state = STATE_UNKNOWN;
-                            }
-                            break;
-                        }
-                    }
-                }
-                else
-                {
-                    switch (bitno)
-                    {
-                        case 28:
-                        {
-                            if (p1 & 0x01)
-                            {
-                                log_msg ("DCF77 Error: parity P1 incorrect");
-                                state = STATE_UNKNOWN;
-                            }
-                            break;
-                        }
-
-                        case 35:
-                        {
-                            if (p2 & 0x01)
-                            {
-                                log_msg ("DCF77 Error: parity P2 incorrect");
-                                state = STATE_UNKNOWN;
-                            }
-                            break;
-                        }
-
-                        case 58:
-                        {
-                            if (p3 & 0x01)
-                            {
-                                log_msg ("DCF77 Error: parity P3 incorrect");
-                                state = STATE_UNKNOWN;
-                            }
-                            break;
-                        }
-                    }
+            soft_bits[pulse_second] = soft;
+            frame_pulses++;
+        }
 
-                }
+        pulse_second = 0xff;
+    }
+}
 
-                if (bitno != 0xff)
-                {
-                    bitno++;
-
-                    if (bitno == 59)
-                    {
-                        time_is_valid = 1;
-                    }
-                    else if (bitno >= 60)
-                    {
-                        state = STATE_UNKNOWN;
-                    }
-                }
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * DCF77 edge event - pass edge queued by ISR, see EVENT_DCF77_EDGE
+ *
+ * An edge is passed to the statemachine if the next edge follows after DCF77_GLITCH_MS or later. Shorter pulses are
+ * dropped together with their edges.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+dcf77_edge_event (uint32_t ticks, uint_fast8_t level)
+{
+    if (dcf77_state == STATE_PON)                       // drop edges while PON is set
+    {
+        return;
+    }
 
-                cnt = 0;
-            }
+    if (lost_edges != event_overflows[EVENT_DCF77_EDGE])    // lost edges are missing pulses, sync is kept
+    {
+        log_msg ("DCF77 Error: edges lost, event queue full");
+        lost_edges  = event_overflows[EVENT_DCF77_EDGE];
+        has_pending = 0;
+    }
+
+    if (has_pending)
+    {
+        if (ticks - pending_ticks < DCF77_GLITCH_MS * DCF77_TICKS_PER_MS)
+        {                                               // glitch: drop both edges
+            dcf77_stats.glitches++;
+            has_pending = 0;
+            return;
         }
-        break;
+
+        dcf77_edge (pending_level, pending_ticks);
     }
 
-    return;
+    pending_ticks   = ticks;
+    pending_level   = level;
+    has_pending     = 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * DCF77 tick - check timeouts, called every 1/100 of a second
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+dcf77_tick (void)
+{
+    uint32_t            ticks;
+
+    if (dcf77_state == STATE_PON)                       // pseudo state: wait 1 sec before resetting PON after boot
+    {
+        static uint_fast8_t pon_cnt = 0;
+
+        if (pon_cnt == 100)
+        {
+            dcf77_pon_reset ();
+            lost_edges      = event_overflows[EVENT_DCF77_EDGE];
+            dcf77_state     = STATE_UNKNOWN;            // start state machine now!
+        }
+        else
+        {
+            pon_cnt++;
+        }
+
+        return;
+    }
+
+    if (has_pending && dcf77_get_ticks () - pending_ticks >= DCF77_GLITCH_MS * DCF77_TICKS_PER_MS)
+    {
+        dcf77_edge (pending_level, pending_ticks);
+        has_pending = 0;
+    }
+
+    if (dcf77_state == STATE_SYNC &&                    // minute mark missed: frame ends anyway
+        dcf77_get_ticks () - second0_ticks > 60 * DCF77_TICKS_PER_SEC + 2 * DCF77_SECOND_WINDOW_MS * DCF77_TICKS_PER_MS)
+    {
+        ticks = second0_ticks + 60 * DCF77_TICKS_PER_SEC;
+        dcf77_frame (ticks);
+
+        if (dcf77_state == STATE_SYNC)
+        {
+            dcf77_start_frame (ticks);
+        }
+    }
 }
@@ -26,8 +26,34 @@
 
 #include <time.h>
 
+#define DCF77_HISTOGRAM_BINS            13                      // pulse widths 0-24 ms, 25-49 ms, ..., 300 ms and more
+#define DCF77_HISTOGRAM_BIN_MS          25                      // width of histogram bin
+#define DCF77_PARITY_P1                 0                       // parity of minute
+#define DCF77_PARITY_P2                 1                       // parity of hour
+#define DCF77_PARITY_P3                 2                       // parity of date
+#define DCF77_PARITY_FIELDS             3
+
+typedef struct
+{
+    uint16_t            histogram[DCF77_HISTOGRAM_BINS];        // pulse widths, rolling: halved every 600 pulses
+    uint16_t            histogram_pulses;                       // pulses since last halving
+    uint64_t            frame_history;                          // one bit per minute, bit 0 = last frame, 1 = good
+    uint32_t            good_frames;                            // frames with valid time
+    uint32_t            bad_frames;                             // frames without valid time
+    uint32_t            parity_errors[DCF77_PARITY_FIELDS];     // frames with wrong parity P1, P2, P3
+    uint32_t            glitches;                               // pulses shorter than 20 ms
+    uint32_t            sync_losses;                            // minute marks lost
+    uint32_t            last_sync;                              // uptime in sec of last good frame, see good_frames
+} DCF77_STATS;
+
+extern void             dcf77_edge_event (uint32_t, uint_fast8_t);
 extern void             dcf77_tick (void);
-extern uint_fast8_t     dcf77_time (struct tm *);
+extern uint_fast8_t     dcf77_time (struct tm *, uint_fast16_t *);
+extern uint_fast16_t    dcf77_get_confidence (void);
+extern const DCF77_STATS * dcf77_get_stats (void);
+#if defined (STM32F401RE) || defined (STM32F411RE)
+extern void             dcf77_exti_isr (void);
+#endif
 extern void             dcf77_init (void);
 
 #endif
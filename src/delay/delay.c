@@ -18,12 +18,33 @@ static uint32_t             msec_factor     = 1000;
 
 volatile uint32_t           delay_counter;
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * SysTick handler: count down delay_counter
+ *
+ * The SysTick interrupt is only enabled while delay_counter is running, so the CPU is not woken up every tick when idle.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
 void SysTick_Handler(void)
 {
     if (delay_counter > 0)
     {
         delay_counter--;
     }
+    else
+    {
+        SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * start delay_counter with given number of ticks
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+delay_start (uint32_t ticks)
+{
+    delay_counter = ticks;
+    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
 }
 
 void
@@ -31,11 +52,11 @@ delay_usec (uint32_t usec)
 {
     if (resolution == DELAY_RESOLUTION_1_US)
     {
-        delay_counter = usec;
+        delay_start (usec);
     }
     else
     {
-        delay_counter = usec / usec_divider;
+        delay_start (usec / usec_divider);
     }
 
     while (delay_counter != 0)
@@ -47,7 +68,7 @@ delay_usec (uint32_t usec)
 void
 delay_msec (uint32_t msec)
 {
-    delay_counter = msec * msec_factor;
+    delay_start (msec * msec_factor);
 
     while (delay_counter != 0)
     {
@@ -92,5 +113,10 @@ delay_init (uint_fast8_t res)
     }
 
     SysTick_Config (SystemCoreClock / divider);
+    SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;                         // interrupt will be enabled by delay_start()
     resolution = res;
+
+    DELAY_DEMCR |= DELAY_DEMCR_TRCENA;                                  // enable DWT cycle counter, see delay_get_cycles()
+    DELAY_DWT_CYCCNT = 0;
+    DELAY_DWT_CTRL |= DELAY_DWT_CTRL_CYCCNTENA;
 }
@@ -21,8 +21,21 @@
 #define DELAY_RESOLUTION_10_US          2
 #define DELAY_RESOLUTION_100_US         3
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * DWT cycle counter of Cortex-M3/M4, the CMSIS version of STM32F4xx does not define DWT
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define DELAY_DWT_CTRL                  (*(volatile uint32_t *) 0xE0001000)
+#define DELAY_DWT_CYCCNT                (*(volatile uint32_t *) 0xE0001004)
+#define DELAY_DEMCR                     (*(volatile uint32_t *) 0xE000EDFC)
+#define DELAY_DEMCR_TRCENA              0x01000000
+#define DELAY_DWT_CTRL_CYCCNTENA        0x00000001
+
+#define delay_get_cycles()              (DELAY_DWT_CYCCNT)
+
 extern volatile uint32_t                delay_counter;
 
+extern void delay_start (uint32_t);
 extern void delay_usec (uint32_t);
 extern void delay_msec (uint32_t);
 extern void delay_sec  (uint32_t);
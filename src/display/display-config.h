@@ -39,3 +39,5 @@
 #define DSP_DISPLAY_LED_OFFSET      (DSP_MINUTE_LED_OFFSET + DSP_MINUTE_LEDS)                   // offset of display LEDs
 #define DSP_AMBILIGHT_LED_OFFSET    (DSP_DISPLAY_LED_OFFSET + DSP_DISPLAY_LEDS)                 // offset of ambilight LEDs
 #define DSP_MAX_LEDS                (DSP_STATUS_LEDS + DSP_MINUTE_LEDS + DSP_DISPLAY_LEDS + DSP_AMBILIGHT_LEDS) // maximum number of LEDs
+
+#define DSP_BRIGHTNESS_RAMP_MS      500                                                         // change here: time of brightness ramp 0 to max
@@ -33,6 +33,7 @@
 #define led_refresh         apa102_refresh
 #define led_set_led         apa102_set_led
 #define led_set_all_leds    apa102_set_all_leds
+#define led_set_dim_factor  apa102_set_dim_factor
 #else
 #include "ws2812.h"
 #define LED_RGB             WS2812_RGB
@@ -40,6 +41,7 @@
 #define led_refresh         ws2812_refresh
 #define led_set_led         ws2812_set_led
 #define led_set_all_leds    ws2812_set_all_leds
+#define led_set_dim_factor  ws2812_set_dim_factor
 #endif
 
 #include "eeprom.h"
@@ -133,11 +135,6 @@ static DSP_COLORS   current_colors =
     MAX_COLOR_STEPS / 2, 0, 0
 };
 
-static DSP_COLORS   dimmed_colors =
-{
-    MAX_COLOR_STEPS / 2, 0, 0
-};
-
 static uint_fast8_t                 display_mode;
 
 static DSP_COLORS                   dimmed_colors_up;
@@ -146,6 +143,17 @@ static DSP_COLORS                   dimmed_colors_down;
 static uint_fast8_t                 brightness = MAX_BRIGHTNESS;
 static uint_fast8_t                 automatic_brightness_control = 0;
 
+static const uint8_t                brightness_factors[MAX_BRIGHTNESS + 1] =        // factor / MAX_BRIGHTNESS in color steps
+{
+    8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15
+};
+
+#define BRIGHTNESS_RAMP_MAX         ((MAX_COLOR_STEPS - 1) << 8)                    // full brightness: color steps * 256
+#define BRIGHTNESS_RAMP_VALUE(b)    ((brightness_factors[b] * BRIGHTNESS_RAMP_MAX) / MAX_BRIGHTNESS)
+
+static uint_fast16_t                brightness_ramp = BRIGHTNESS_RAMP_MAX;          // current brightness, follows brightness_target
+static uint_fast16_t                brightness_target = BRIGHTNESS_RAMP_MAX;        // target of ramp, see display_set_brightness()
+
 #define CURRENT_STATE               0x01
 #define TARGET_STATE                0x02
 #define NEW_STATE                   0x04
@@ -677,9 +685,9 @@ display_minute_leds (uint_fast8_t power_is_on, uint_fast8_t minute)
 
         if (power_is_on)
         {
-            rgb.red         = pwmtable8[dimmed_colors.red];
-            rgb.green       = pwmtable8[dimmed_colors.green];
-            rgb.blue        = pwmtable8[dimmed_colors.blue];
+            rgb.red         = pwmtable8[current_colors.red];
+            rgb.green       = pwmtable8[current_colors.green];
+            rgb.blue        = pwmtable8[current_colors.blue];
 
             n_leds = minute % 5;
 
@@ -831,9 +839,9 @@ display_animation_flush (uint_fast8_t flush_ambi)
         already_called = 1;
     }
 
-    rgb.red         = pwmtable8[dimmed_colors.red];
-    rgb.green       = pwmtable8[dimmed_colors.green];
-    rgb.blue        = pwmtable8[dimmed_colors.blue];
+    rgb.red         = pwmtable8[current_colors.red];
+    rgb.green       = pwmtable8[current_colors.green];
+    rgb.blue        = pwmtable8[current_colors.blue];
 
     rgb0.red        = 0;
     rgb0.green      = 0;
@@ -896,23 +904,23 @@ display_animation_fade (void)
         animation_start_flag = 0;
         animation_stop_flag = 0;
 
-        red_step = dimmed_colors.red / 5;
+        red_step = current_colors.red / 5;
 
-        if (red_step == 0 && dimmed_colors.red > 0)
+        if (red_step == 0 && current_colors.red > 0)
         {
             red_step = 1;
         }
 
-        green_step = dimmed_colors.green / 5;
+        green_step = current_colors.green / 5;
 
-        if (green_step == 0 && dimmed_colors.green > 0)
+        if (green_step == 0 && current_colors.green > 0)
         {
             green_step = 1;
         }
 
-        blue_step = dimmed_colors.blue / 5;
+        blue_step = current_colors.blue / 5;
 
-        if (blue_step == 0 && dimmed_colors.blue > 0)
+        if (blue_step == 0 && current_colors.blue > 0)
         {
             blue_step = 1;
         }
@@ -921,9 +929,9 @@ display_animation_fade (void)
         dimmed_colors_up.green     = 0;
         dimmed_colors_up.blue      = 0;
 
-        dimmed_colors_down.red     = dimmed_colors.red;
-        dimmed_colors_down.green   = dimmed_colors.green;
-        dimmed_colors_down.blue    = dimmed_colors.blue;
+        dimmed_colors_down.red     = current_colors.red;
+        dimmed_colors_down.green   = current_colors.green;
+        dimmed_colors_down.blue    = current_colors.blue;
     }
 
     if (! animation_stop_flag)
@@ -941,14 +949,14 @@ display_animation_fade (void)
                 changed = 1;
             }
 
-            if (dimmed_colors_up.red + red_step <= dimmed_colors.red)
+            if (dimmed_colors_up.red + red_step <= current_colors.red)
             {
                 dimmed_colors_up.red += red_step;
                 changed = 1;
             }
-            else if (dimmed_colors_up.red != dimmed_colors.red)
+            else if (dimmed_colors_up.red != current_colors.red)
             {
-                dimmed_colors_up.red = dimmed_colors.red;
+                dimmed_colors_up.red = current_colors.red;
                 changed = 1;
             }
         }
@@ -966,14 +974,14 @@ display_animation_fade (void)
                 changed = 1;
             }
 
-            if (dimmed_colors_up.green + green_step <= dimmed_colors.green)
+            if (dimmed_colors_up.green + green_step <= current_colors.green)
             {
                 dimmed_colors_up.green += green_step;
                 changed = 1;
             }
-            else if (dimmed_colors_up.green != dimmed_colors.green)
+            else if (dimmed_colors_up.green != current_colors.green)
             {
-                dimmed_colors_up.green = dimmed_colors.green;
+                dimmed_colors_up.green = current_colors.green;
                 changed = 1;
             }
         }
@@ -991,14 +999,14 @@ display_animation_fade (void)
                 changed = 1;
             }
 
-            if (dimmed_colors_up.blue + blue_step <= dimmed_colors.blue)
+            if (dimmed_colors_up.blue + blue_step <= current_colors.blue)
             {
                 dimmed_colors_up.blue += blue_step;
                 changed = 1;
             }
-            else if (dimmed_colors_up.blue != dimmed_colors.blue)
+            else if (dimmed_colors_up.blue != current_colors.blue)
             {
-                dimmed_colors_up.blue = dimmed_colors.blue;
+                dimmed_colors_up.blue = current_colors.blue;
                 changed = 1;
             }
         }
@@ -1009,9 +1017,9 @@ display_animation_fade (void)
             LED_RGB  rgb_up;
             LED_RGB  rgb_down;
 
-            rgb.red         = pwmtable8[dimmed_colors.red];
-            rgb.green       = pwmtable8[dimmed_colors.green];
-            rgb.blue        = pwmtable8[dimmed_colors.blue];
+            rgb.red         = pwmtable8[current_colors.red];
+            rgb.green       = pwmtable8[current_colors.green];
+            rgb.blue        = pwmtable8[current_colors.blue];
 
             rgb_up.red      = pwmtable8[dimmed_colors_up.red];
             rgb_up.green    = pwmtable8[dimmed_colors_up.green];
@@ -1053,9 +1061,9 @@ display_show_new_display (void)
     LED_RGB          rgb0;
     uint_fast16_t       idx;
 
-    rgb.red         = pwmtable8[dimmed_colors.red];
-    rgb.green       = pwmtable8[dimmed_colors.green];
-    rgb.blue        = pwmtable8[dimmed_colors.blue];
+    rgb.red         = pwmtable8[current_colors.red];
+    rgb.green       = pwmtable8[current_colors.green];
+    rgb.blue        = pwmtable8[current_colors.blue];
 
     rgb0.red        = 0;
     rgb0.green      = 0;
@@ -1561,12 +1569,79 @@ display_animation_random ()
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * animation
+ * set dim factor of LED driver from brightness_ramp
+ *
+ * brightness_ramp is the perceived brightness in color steps * 256. pwmtable8 maps it to the PWM value, interpolated
+ * between two table entries, so 256 ramp values give a linear ramp of perceived brightness. The status LED is not dimmed.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+display_set_dim_factor (void)
+{
+    uint_fast8_t    idx     = brightness_ramp >> 8;
+    uint_fast8_t    frac    = brightness_ramp & 0xFF;
+    uint_fast16_t   pwm;
+
+    pwm = pwmtable8[idx] << 8;
+
+    if (frac)                                                               // idx < MAX_COLOR_STEPS - 1
+    {
+        pwm += (pwmtable8[idx + 1] - pwmtable8[idx]) * frac;
+    }
+
+    led_set_dim_factor (DSP_MINUTE_LED_OFFSET, (pwm + 127) / 255);          // 0 ... 256
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * brightness ramp: move brightness_ramp one step to brightness_target, called every DSP_ANIMATION_PERIOD_MS
+ *
+ * The whole range from brightness 0 to MAX_BRIGHTNESS takes DSP_BRIGHTNESS_RAMP_MS. Only the lookup table of the LED
+ * driver changes, LED states and colors are untouched.
+ *
+ * Return values:
+ *  1: dim factor changed, LEDs must be refreshed
+ *  0: brightness reached
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+display_brightness_ramp (void)
+{
+    uint_fast16_t   target = brightness_target;
+    uint_fast16_t   step;
+
+#if DSP_BRIGHTNESS_RAMP_MS > DSP_ANIMATION_PERIOD_MS
+    step = ((BRIGHTNESS_RAMP_MAX - BRIGHTNESS_RAMP_VALUE(0)) * DSP_ANIMATION_PERIOD_MS) / DSP_BRIGHTNESS_RAMP_MS;
+#else
+    step = BRIGHTNESS_RAMP_MAX;                                             // no ramp
+#endif
+
+    if (brightness_ramp == target)
+    {
+        return 0;
+    }
+
+    if (brightness_ramp < target)
+    {
+        brightness_ramp = (target - brightness_ramp > step) ? brightness_ramp + step : target;
+    }
+    else
+    {
+        brightness_ramp = (brightness_ramp - target > step) ? brightness_ramp - step : target;
+    }
+
+    display_set_dim_factor ();
+    return 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * animation, called every DSP_ANIMATION_PERIOD_MS
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 void
 display_animation (void)
 {
+    uint_fast8_t    ramp = display_brightness_ramp ();
+
     switch (animation_mode)
     {
         case ANIMATION_MODE_FADE:       display_animation_fade ();      break;
@@ -1575,6 +1650,11 @@ display_animation (void)
         case ANIMATION_MODE_RANDOM:     display_animation_random ();    break;
         default:                        display_animation_none ();      break;
     }
+
+    if (ramp)
+    {
+        display_refresh_ambilight_leds ();                                  // animations refresh display LEDs only
+    }
 }
 
 #if WCLOCK24H == 1                                                          // yet only available on WC24H
@@ -1927,49 +2007,6 @@ display_decrement_animation_mode (void)
     return animation_mode;
 }
 
-/*-------------------------------------------------------------------------------------------------------------------------------------------
- * calculate dimmed colors
- *-------------------------------------------------------------------------------------------------------------------------------------------
- */
-static void
-display_calc_dimmed_colors ()
-{
-    static uint8_t  b[16] = { 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15 };
-    uint_fast8_t    factor;
-
-    if (brightness == MAX_BRIGHTNESS)
-    {
-        dimmed_colors.red   = current_colors.red;
-        dimmed_colors.green = current_colors.green;
-        dimmed_colors.blue  = current_colors.blue;
-    }
-    else
-    {
-        factor = b[brightness];
-
-        dimmed_colors.red = (current_colors.red * factor) / MAX_BRIGHTNESS;
-
-        if (current_colors.red > 0 && dimmed_colors.red == 0)
-        {
-            dimmed_colors.red = 1;
-        }
-
-        dimmed_colors.green = (current_colors.green * factor) / MAX_BRIGHTNESS;
-
-        if (current_colors.green > 0 && dimmed_colors.green == 0)
-        {
-            dimmed_colors.green = 1;
-        }
-
-        dimmed_colors.blue = (current_colors.blue * factor) / MAX_BRIGHTNESS;
-
-        if (current_colors.blue > 0 && dimmed_colors.blue == 0)
-        {
-            dimmed_colors.blue = 1;
-        }
-    }
-}
-
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * increment red color by 2
  *-------------------------------------------------------------------------------------------------------------------------------------------
@@ -1986,7 +2023,6 @@ display_increment_color_red (void)
             current_colors.red++;
         }
 
-        display_calc_dimmed_colors ();
         display_animation_flush (TRUE);
     }
 }
@@ -2007,7 +2043,6 @@ display_decrement_color_red (void)
             current_colors.red--;
         }
 
-        display_calc_dimmed_colors ();
         display_animation_flush (TRUE);
     }
 }
@@ -2028,7 +2063,6 @@ display_increment_color_green (void)
             current_colors.green++;
         }
 
-        display_calc_dimmed_colors ();
         display_animation_flush (TRUE);
     }
 }
@@ -2049,7 +2083,6 @@ display_decrement_color_green (void)
             current_colors.green--;
         }
 
-        display_calc_dimmed_colors ();
         display_animation_flush (TRUE);
     }
 }
@@ -2070,7 +2103,6 @@ display_increment_color_blue (void)
             current_colors.blue++;
         }
 
-        display_calc_dimmed_colors ();
         display_animation_flush (TRUE);
     }
 }
@@ -2091,7 +2123,6 @@ display_decrement_color_blue (void)
             current_colors.blue--;
         }
 
-        display_calc_dimmed_colors ();
         display_animation_flush (TRUE);
     }
 }
@@ -2119,7 +2150,6 @@ display_set_colors (DSP_COLORS * rgb)
     current_colors.green    = (rgb->green < MAX_COLOR_STEPS) ? rgb->green : MAX_COLOR_STEPS;
     current_colors.blue     = (rgb->blue < MAX_COLOR_STEPS)  ? rgb->blue : MAX_COLOR_STEPS;
 
-    display_calc_dimmed_colors ();
     display_animation_flush (TRUE);
 }
 
@@ -2137,6 +2167,8 @@ display_get_brightness (void)
  * set brightness
  *  MAX_BRIGHTNESS  = full brightness
  *   0              = lowest brightness
+ *
+ * display_animation() ramps to the new brightness, see display_brightness_ramp().
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 void
@@ -2151,8 +2183,29 @@ display_set_brightness (uint_fast8_t new_brightness)
         brightness = new_brightness;
     }
 
-    display_calc_dimmed_colors ();
-    display_animation_flush (TRUE);
+    brightness_target = BRIGHTNESS_RAMP_VALUE(brightness);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * set brightness in n_steps (>= 2) steps, finer than MAX_BRIGHTNESS, e.g. by the LDR
+ *  n_steps - 1    = full brightness
+ *   0             = lowest brightness
+ *
+ * The ramp target is interpolated linearly between lowest and full brightness, so every step changes the brightness.
+ * display_get_brightness() returns the nearest of the MAX_BRIGHTNESS + 1 levels.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+display_set_brightness_step (uint_fast8_t step, uint_fast8_t n_steps)
+{
+    if (step >= n_steps)
+    {
+        step = n_steps - 1;
+    }
+
+    brightness          = (step * (MAX_BRIGHTNESS + 1)) / n_steps;
+    brightness_target   = BRIGHTNESS_RAMP_VALUE(0) +
+                          ((uint32_t) (BRIGHTNESS_RAMP_MAX - BRIGHTNESS_RAMP_VALUE(0)) * step) / (n_steps - 1);
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
@@ -2165,9 +2218,9 @@ display_decrement_brightness (void)
     if (brightness > 0)
     {
         brightness--;
-        display_calc_dimmed_colors ();
-        display_animation_flush (TRUE);
     }
+
+    brightness_target = BRIGHTNESS_RAMP_VALUE(brightness);
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
@@ -2180,9 +2233,9 @@ display_increment_brightness (void)
     if (brightness < MAX_BRIGHTNESS)
     {
         brightness++;
-        display_calc_dimmed_colors ();
-        display_animation_flush (TRUE);
     }
+
+    brightness_target = BRIGHTNESS_RAMP_VALUE(brightness);
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
@@ -2451,8 +2504,8 @@ display_read_config_from_eeprom (void)
             animation_mode                  = animation_mode8;
             brightness                      = brightness8;
             automatic_brightness_control    = automatic_brightness_control8;
-
-            display_calc_dimmed_colors ();
+            brightness_target               = BRIGHTNESS_RAMP_VALUE(brightness);
+            brightness_ramp                 = brightness_target;                // no ramp at boot
 
             rtc = 1;
         }
@@ -2508,4 +2561,5 @@ void
 display_init (void)
 {
     led_init ();
+    display_set_dim_factor ();
 }
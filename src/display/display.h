@@ -13,6 +13,7 @@
 #define DSP_H
 
 #define MAX_BRIGHTNESS                      15
+#define DSP_ANIMATION_PERIOD_MS             25                      // display_animation() must be called every 25 ms
 
 // display flags:
 #define DISPLAY_FLAG_NONE                   0                       // nothing to do
@@ -62,6 +63,7 @@ extern void         display_get_colors (DSP_COLORS *);
 extern void         display_set_colors (DSP_COLORS *);
 extern uint_fast8_t display_get_brightness (void);
 extern void         display_set_brightness  (uint_fast8_t);
+extern void         display_set_brightness_step (uint_fast8_t, uint_fast8_t);
 extern void         display_decrement_brightness (void);
 extern void         display_increment_brightness (void);
 extern void         display_test (void);
@@ -11,6 +11,10 @@
  *   DS1822         0x22
  *   DS18B20        0x28
  *
+ * Up to DS18XX_MAX_SENSORS sensors can be connected to the bus, they are found by SEARCH ROM in ds18xx_init().
+ * All sensors convert at the same time (SKIP ROM), then the scratchpads are read one after the other (MATCH ROM).
+ * Sensors must not be connected in parasite power mode.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -29,34 +33,74 @@
 #define ONEWIRE_WR_SCRATCH_CMD      0x4E                                        // write configuration register
 #define ONEWIRE_COPY_SCRATCH_CMD    0x48                                        // copy configuration register into EEPROM
 
-#define DS18XX_ROM_CODE_LEN         8                                           // ROM code is 8 bytes long
 #define DS18XX_FAMILY_CODE_POS      0                                           // first byte is family code
 
-#define DS18XX_DATA_BUF_LEN         9
+#define DS18XX_DATA_BUF_LEN         9                                           // scratchpad: 8 bytes and CRC8
 
 
 uint_fast8_t                        ds18xx_is_up = 0;                           // flag: DS18xx is up
 
-static uint8_t                      ds18xx_rom_code[DS18XX_ROM_CODE_LEN];       // ROM code of DS18xx
+static DS18XX_SENSOR                ds18xx_sensors[DS18XX_MAX_SENSORS];         // sensors found by ds18xx_init()
+static uint_fast8_t                 ds18xx_n_sensors;                           // number of sensors
 static uint8_t                      ds18xx_data_buf[DS18XX_DATA_BUF_LEN];       // data from DS18xx
-static uint_fast8_t                 family_code;
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * ds18xx_select () - reset bus and select one sensor
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+ds18xx_select (uint8_t * rom_code)
+{
+    uint_fast8_t    rtc = 0;
+
+    if (onewire_reset ())
+    {
+        onewire_write_byte (ONEWIRE_MATCH_ROM_CMD);                             // send command: select slave
+        onewire_write (rom_code, DS18XX_ROM_CODE_LEN);                          // send ROM code
+        rtc = 1;
+    }
+
+    return rtc;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * ds18xx_read_scratchpad () - read scratchpad of one sensor into ds18xx_data_buf, check CRC
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+ds18xx_read_scratchpad (uint8_t * rom_code)
+{
+    uint_fast8_t    rtc = 0;
+
+    if (ds18xx_select (rom_code))
+    {
+        onewire_write_byte (ONEWIRE_RD_SCRATCH_CMD);                            // send command: read scratchpad
+        onewire_read (ds18xx_data_buf, DS18XX_DATA_BUF_LEN);                    // read 9 bytes from slave
+        onewire_reset ();
+
+        if (onewire_crc8 (ds18xx_data_buf, DS18XX_DATA_BUF_LEN) == 0 && ds18xx_data_buf[4] != 0x00) // all zero: no answer
+        {
+            rtc = 1;
+        }
+    }
+
+    return rtc;
+}
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
  * ds1822B20_set_resolution () - set resolution
  *-----------------------------------------------------------------------------------------------------------------------------------------------
  */
 static uint8_t
-ds1822B20_set_resolution (uint_fast8_t resolution)
+ds1822B20_set_resolution (uint8_t * rom_code, uint_fast8_t resolution)
 {
     uint8_t   rtc = 0;
     uint8_t   conf_reg;
 
     conf_reg = (resolution - 9) << 5;                                   // 9->0x00 10->0x20 11->0x40 12->0x60
 
-    if (onewire_reset ())
+    if (ds18xx_select (rom_code))
     {
-        onewire_write_byte (ONEWIRE_MATCH_ROM_CMD);                     // send command: select slave
-        onewire_write (ds18xx_rom_code, DS18XX_ROM_CODE_LEN);           // send ROM code
         onewire_write_byte (ONEWIRE_WR_SCRATCH_CMD);                    // send command: write configuration register
 
         onewire_write_byte (0x7F);                                      // alarm high register
@@ -79,20 +123,20 @@ ds1822B20_set_resolution (uint_fast8_t resolution)
 #define EEPROM_WRITE_TIMEOUT        (15000/60)                          // we wait 15ms (in 60us slots)
 
 static uint8_t
-ds1822B20_write_resolution (uint_fast8_t resolution)
+ds1822B20_write_resolution (uint8_t * rom_code, uint_fast8_t resolution)
 {
     uint8_t         rtc = 0;
     uint_fast8_t    wait_bit;
     uint32_t        timeout = 0;
 
-    rtc = ds1822B20_set_resolution (resolution);
+    rtc = ds1822B20_set_resolution (rom_code, resolution);
 
     if (rtc)
     {
-        if (onewire_reset ())
+        rtc = 0;
+
+        if (ds18xx_select (rom_code))
         {
-            onewire_write_byte (ONEWIRE_MATCH_ROM_CMD);                 // send command: select slave
-            onewire_write (ds18xx_rom_code, DS18XX_ROM_CODE_LEN);       // send ROM code
             onewire_write_byte (ONEWIRE_COPY_SCRATCH_CMD);              // send command: copy configuration register into EEPROM
 
             timeout = 0;
@@ -116,84 +160,190 @@ ds1822B20_write_resolution (uint_fast8_t resolution)
 }
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
- * ds18xx_read_raw_temp () - read temperature
+ * ds18xx_decode () - get temperature of sensor from scratchpad in ds18xx_data_buf
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+ds18xx_decode (DS18XX_SENSOR * sensor)
+{
+    switch (sensor->rom_code[DS18XX_FAMILY_CODE_POS])
+    {
+        case DS1822_FAMILY_CODE:
+        case DS18B20_FAMILY_CODE:
+        {
+            uint8_t lower_byte = ds18xx_data_buf[0];                                // lower byte of temperature
+            uint8_t upper_byte = ds18xx_data_buf[1];                                // higher byte of temperature
+            uint8_t conf_reg   = ds18xx_data_buf[4];                                // configuration register
+            uint8_t resolution = ((conf_reg >> 5) & 0x03) + DS_RESOLUTION_9_BIT;    // resolution: 9, 10, 11, or 12
+
+            sensor->resolution  = resolution;
+            sensor->is_negative = (upper_byte & 0x80) ? 1 : 0;
+            sensor->raw_temp    = ((upper_byte & 0x07) << (resolution - 4)) | (lower_byte >> (DS_RESOLUTION_12_BIT - resolution));
+            break;
+        }
+
+        case DS1820_FAMILY_CODE:
+        default:
+        {
+            sensor->resolution  = DS_RESOLUTION_9_BIT;
+            sensor->is_negative = (ds18xx_data_buf[1] & 0x80) ? 1 : 0;              // 9 bit resolution
+            sensor->raw_temp    = ds18xx_data_buf[0];
+            break;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * ds18xx_read_raw_temp_start () - start reading temperature with ds18xx_read_raw_temp_pt ()
  *
  * conversion times:
- *   DS_RESOLUTION_12_BIT: 12 bit resolution 0.0625 C - conversion time ~750 ms: wait 800ms = 13333 x 60 us
- *   DS_RESOLUTION_11_BIT: 11 bit resolution 0.125  C - conversion time ~375 ms: wait 400ms =  6666 x 60 us
- *   DS_RESOLUTION_10_BIT: 10 bit resolution 0.25   C - conversion time ~187 ms: wait 200ms =  3333 x 60 us
- *   DS_RESOLUTION_9_BIT:   9 bit resolution 0.5    C - conversion time  ~93 ms: wait 100ms =  1666 x 60 us
+ *   DS_RESOLUTION_12_BIT: 12 bit resolution 0.0625 C - conversion time ~750 ms: wait 800ms
+ *   DS_RESOLUTION_11_BIT: 11 bit resolution 0.125  C - conversion time ~375 ms: wait 400ms
+ *   DS_RESOLUTION_10_BIT: 10 bit resolution 0.25   C - conversion time ~187 ms: wait 200ms
+ *   DS_RESOLUTION_9_BIT:   9 bit resolution 0.5    C - conversion time  ~93 ms: wait 100ms
  *-----------------------------------------------------------------------------------------------------------------------------------------------
  */
-#define CONVERSION_TIMEOUT_MAX  (800000/60)                         // timeout after 800ms
+#define CONVERSION_TIMEOUT_MS   800                                 // timeout after 800ms
+#define CONVERSION_POLL_MS      10                                  // check every 10ms if conversion is finished
 
-uint_fast8_t
-ds18xx_read_raw_temp (uint_fast8_t * resolution_p, uint_fast8_t * is_negative_p, uint_fast16_t * raw_temp_p)
+#define DS18XX_WAIT(ctx)        PT_WAIT_UNTIL(&(ctx)->pt, onewire_poll ())  // yield until OneWire transfer has finished
+
+void
+ds18xx_read_raw_temp_start (DS18XX_READ_CTX * ctx)
 {
-    uint_fast8_t    rtc = 0;
-    uint_fast8_t    wait_bit;
-    uint32_t        timeout = 0;
+    PT_INIT(&ctx->pt);
+    ctx->rtc = 0;
+}
 
-    if (onewire_reset ())
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * ds18xx_read_raw_temp_pt () - read temperature of all sensors (protothread), yields while the DS18xx are converting
+ *
+ * Result in ctx->rtc: number of sensors read successfully, 0 = failed. Values of first sensor in ctx->resolution,
+ * ctx->is_negative and ctx->raw_temp, values of all sensors see ds18xx_get_sensor().
+ *
+ * Every OneWire transfer is started with onewire_xxx_start(), then the protothread yields until onewire_poll() reports
+ * the end of the transfer. With the USART driver, the CPU does not wait for the bus at all.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+PT_THREAD(ds18xx_read_raw_temp_pt (DS18XX_READ_CTX * ctx))
+{
+    uint8_t         cmd[1 + DS18XX_ROM_CODE_LEN];
+    uint_fast8_t    idx;
+
+    PT_BEGIN(&ctx->pt);
+
+    onewire_reset_start ();
+    DS18XX_WAIT(ctx);
+
+    if (onewire_reset_result ())
     {
-        onewire_write_byte (ONEWIRE_MATCH_ROM_CMD);                                             // send command: select slave
-        onewire_write (ds18xx_rom_code, DS18XX_ROM_CODE_LEN);                                   // send ROM code
-        onewire_write_byte (ONEWIRE_CONVERT_CMD);                                               // send command: start temp measurement
+        cmd[0] = ONEWIRE_SKIP_ROM_CMD;                                                          // send command: select all slaves
+        cmd[1] = ONEWIRE_CONVERT_CMD;                                                           // send command: start temp measurement
+        onewire_write_start (cmd, 2);
+        DS18XX_WAIT(ctx);
 
-        timeout = 0;
+        ctx->start = timer_ms;
 
-        do
+        while (! PT_TIMEOUT(ctx->start, CONVERSION_TIMEOUT_MS))
         {
-            wait_bit = onewire_read_bit ();
-            timeout++;
-        } while (! wait_bit && timeout < CONVERSION_TIMEOUT_MAX);
+            onewire_read_bit_start ();                                                          // DS18xx hold bus low while converting
+            DS18XX_WAIT(ctx);
 
-        if (timeout < CONVERSION_TIMEOUT_MAX)
+            if (onewire_read_bit_result ())
+            {
+                break;
+            }
+
+            PT_DELAY(&ctx->pt, ctx->poll_start, CONVERSION_POLL_MS);
+        }
+
+        if (onewire_read_bit_result ())
         {
-            if (onewire_reset ())
+            for (ctx->idx = 0; ctx->idx < ds18xx_n_sensors; ctx->idx++)
             {
-                onewire_write_byte (ONEWIRE_MATCH_ROM_CMD);                                     // send command: select slave
-                onewire_write (ds18xx_rom_code, DS18XX_ROM_CODE_LEN);                           // send ROM code
-                onewire_write_byte (ONEWIRE_RD_SCRATCH_CMD);                                    // send command: read temperature
-                onewire_read (ds18xx_data_buf, DS18XX_DATA_BUF_LEN);                            // read 9 bytes from slave
+                ds18xx_sensors[ctx->idx].valid = 0;
+
+                onewire_reset_start ();
+                DS18XX_WAIT(ctx);
+
+                if (! onewire_reset_result ())
+                {
+                    continue;
+                }
+
+                cmd[0] = ONEWIRE_MATCH_ROM_CMD;                                                 // send command: select slave
+                memcpy (cmd + 1, ds18xx_sensors[ctx->idx].rom_code, DS18XX_ROM_CODE_LEN);      // send ROM code
+                onewire_write_start (cmd, 1 + DS18XX_ROM_CODE_LEN);
+                DS18XX_WAIT(ctx);
+
+                cmd[0] = ONEWIRE_RD_SCRATCH_CMD;                                                // send command: read scratchpad
+                onewire_write_start (cmd, 1);
+                DS18XX_WAIT(ctx);
+
+                onewire_read_start (DS18XX_DATA_BUF_LEN);                                       // read 9 bytes from slave
+                DS18XX_WAIT(ctx);
+                onewire_read_result (ds18xx_data_buf);
 
-                onewire_reset ();
+                onewire_reset_start ();
+                DS18XX_WAIT(ctx);
 
-                switch (family_code)
+                idx = ctx->idx;
+
+                if (onewire_crc8 (ds18xx_data_buf, DS18XX_DATA_BUF_LEN) == 0 && ds18xx_data_buf[4] != 0x00) // all zero: no answer
                 {
-                    case DS1822_FAMILY_CODE:
-                    case DS18B20_FAMILY_CODE:
-                    {
-                        uint8_t lower_byte = ds18xx_data_buf[0];                                // lower byte of temperature
-                        uint8_t upper_byte = ds18xx_data_buf[1];                                // higher byte of temperature
-                        uint8_t conf_reg   = ds18xx_data_buf[4];                                // configuration register
-                        uint8_t resolution = ((conf_reg >> 5) & 0x03) + DS_RESOLUTION_9_BIT;    // resolution: 9, 10, 11, or 12
-
-                        *resolution_p   = resolution;
-                        *is_negative_p  = (upper_byte & 0x80) ? 1 : 0;
-                        *raw_temp_p     = ((upper_byte & 0x07) << (resolution - 4)) | (lower_byte >> (DS_RESOLUTION_12_BIT - resolution));
-                        rtc = 1;
-                        break;
-                    }
-
-                    case DS1820_FAMILY_CODE:
-                    default:
-                    {
-                        *resolution_p   = DS_RESOLUTION_9_BIT;
-                        *is_negative_p  = (ds18xx_data_buf[1] & 0x80) ? 1 : 0;                  // 9 bit resolution
-                        *raw_temp_p     = ds18xx_data_buf[0];
-                        rtc = 1;
-                        break;
-                    }
+                    ds18xx_sensors[idx].valid = 1;
+                    ds18xx_decode (ds18xx_sensors + idx);
+                    ctx->rtc++;
                 }
             }
+
+            if (ds18xx_sensors[0].valid)
+            {
+                ctx->resolution     = ds18xx_sensors[0].resolution;
+                ctx->is_negative    = ds18xx_sensors[0].is_negative;
+                ctx->raw_temp       = ds18xx_sensors[0].raw_temp;
+            }
         }
         else
         {
-            onewire_reset ();                                                                   // timeout -> reset
+            onewire_reset_start ();                                                             // timeout -> reset
+            DS18XX_WAIT(ctx);
+
+            for (idx = 0; idx < ds18xx_n_sensors; idx++)
+            {
+                ds18xx_sensors[idx].valid = 0;
+            }
         }
     }
 
+    PT_END(&ctx->pt);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * ds18xx_read_raw_temp () - read temperature of first sensor, blocking version of ds18xx_read_raw_temp_pt()
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+ds18xx_read_raw_temp (uint_fast8_t * resolution_p, uint_fast8_t * is_negative_p, uint_fast16_t * raw_temp_p)
+{
+    DS18XX_READ_CTX     ctx;
+    uint_fast8_t        rtc = 0;
+
+    ds18xx_read_raw_temp_start (&ctx);
+
+    while (PT_SCHEDULE(ds18xx_read_raw_temp_pt (&ctx)))
+    {
+        ;
+    }
+
+    if (ctx.rtc && ds18xx_sensors[0].valid)
+    {
+        *resolution_p   = ctx.resolution;
+        *is_negative_p  = ctx.is_negative;
+        *raw_temp_p     = ctx.raw_temp;
+        rtc = 1;
+    }
+
     return rtc;
 }
 
@@ -244,7 +394,7 @@ ds18xx_read_temp (float * temperature_p)
 #endif
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
- * ds18xx_get_family_code () - get family code of DS18xx
+ * ds18xx_get_family_code () - get family code of first DS18xx
  *
  * Return values:
  *
@@ -253,11 +403,31 @@ ds18xx_read_temp (float * temperature_p)
 uint_fast8_t
 ds18xx_get_family_code (void)
 {
-    return family_code;
+    return ds18xx_sensors[0].rom_code[DS18XX_FAMILY_CODE_POS];
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * ds18xx_get_n_sensors () - get number of sensors found by ds18xx_init()
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+ds18xx_get_n_sensors (void)
+{
+    return ds18xx_n_sensors;
 }
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
- * ds18xx_init () - initialize DS18xx routines
+ * ds18xx_get_sensor () - get ROM code and last temperature of sensor, see ds18xx_read_raw_temp_pt()
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+const DS18XX_SENSOR *
+ds18xx_get_sensor (uint_fast8_t idx)
+{
+    return (idx < ds18xx_n_sensors) ? ds18xx_sensors + idx : (const DS18XX_SENSOR *) 0;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * ds18xx_init () - initialize DS18xx routines, search all DS18xx on bus
  *
  * resolution:  only for DS18B20 and DS1822, otherwise ignored:
  *              DS_RESOLUTION_9_BIT
@@ -269,46 +439,53 @@ ds18xx_get_family_code (void)
 uint_fast8_t
 ds18xx_init (uint_fast8_t resolution)
 {
-    uint_fast8_t rtc = 0;
-    uint_fast8_t conf_reg;
-    uint_fast8_t old_resolution;
+    uint8_t         rom_codes[DS18XX_MAX_SENSORS][DS18XX_ROM_CODE_LEN];
+    uint_fast8_t    n_rom_codes;
+    uint_fast8_t    idx;
+    uint_fast8_t    conf_reg;
+    uint_fast8_t    old_resolution;
 
     if (resolution >= DS_RESOLUTION_9_BIT && resolution <= DS_RESOLUTION_12_BIT)
     {
         onewire_init ();
 
-        if (onewire_reset ())
-        {
-            rtc = onewire_get_rom_code (ds18xx_rom_code);
-            family_code = ds18xx_rom_code[DS18XX_FAMILY_CODE_POS];
-
-            ds18xx_is_up = 1;
+        n_rom_codes = onewire_search_rom (rom_codes, DS18XX_MAX_SENSORS);
+        ds18xx_n_sensors = 0;
 
-            switch (family_code)                                                // get and set resolution (DS18B20 and DS1822 only)
+        for (idx = 0; idx < n_rom_codes; idx++)
+        {
+            switch (rom_codes[idx][DS18XX_FAMILY_CODE_POS])                     // ignore other OneWire devices
             {
+                case DS1820_FAMILY_CODE:
                 case DS1822_FAMILY_CODE:
                 case DS18B20_FAMILY_CODE:
                 {
-                    if (onewire_reset ())
-                    {
-                        onewire_write_byte (ONEWIRE_MATCH_ROM_CMD);             // send command: select slave
-                        onewire_write (ds18xx_rom_code, DS18XX_ROM_CODE_LEN);   // send rom code
-                        onewire_write_byte (ONEWIRE_RD_SCRATCH_CMD);            // send command: read from scratch
-                        onewire_read (ds18xx_data_buf, DS18XX_DATA_BUF_LEN);    // read 9 bytes from slave
-
-                        conf_reg = ds18xx_data_buf[4];                          // configuration register
-                        old_resolution = ((conf_reg >> 5) & 0x03) + 9;          // resolution: 9, 10, 11, or 12
-
-                        if (old_resolution != resolution)
-                        {
-                            ds1822B20_write_resolution (resolution);
-                        }
-                    }
+                    memcpy (ds18xx_sensors[ds18xx_n_sensors].rom_code, rom_codes[idx], DS18XX_ROM_CODE_LEN);
+                    ds18xx_sensors[ds18xx_n_sensors].valid = 0;
+                    ds18xx_n_sensors++;
                     break;
                 }
             }
         }
+
+        for (idx = 0; idx < ds18xx_n_sensors; idx++)                            // get and set resolution (DS18B20 and DS1822 only)
+        {
+            uint8_t * rom_code = ds18xx_sensors[idx].rom_code;
+
+            if (rom_code[DS18XX_FAMILY_CODE_POS] != DS1820_FAMILY_CODE && ds18xx_read_scratchpad (rom_code))
+            {
+                conf_reg = ds18xx_data_buf[4];                                  // configuration register
+                old_resolution = ((conf_reg >> 5) & 0x03) + 9;                  // resolution: 9, 10, 11, or 12
+
+                if (old_resolution != resolution)
+                {
+                    ds1822B20_write_resolution (rom_code, resolution);
+                }
+            }
+        }
+
+        ds18xx_is_up = (ds18xx_n_sensors > 0);
     }
 
-    return rtc;
+    return ds18xx_is_up;
 }
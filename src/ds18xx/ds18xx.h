@@ -20,6 +20,7 @@
 #endif
 
 #include "onewire.h"
+#include "pt.h"
 
 #define DS_RESOLUTION_9_BIT         9
 #define DS_RESOLUTION_10_BIT        10
@@ -30,12 +31,39 @@
 #define DS1822_FAMILY_CODE          0x22
 #define DS18B20_FAMILY_CODE         0x28
 
+#define DS18XX_MAX_SENSORS          4                                           // max. number of sensors on bus
+#define DS18XX_ROM_CODE_LEN         ONEWIRE_ROM_CODE_LEN
+
+typedef struct
+{
+    uint8_t                         rom_code[DS18XX_ROM_CODE_LEN];              // ROM code, byte 0 is family code
+    uint_fast8_t                    resolution;                                 // resolution in bits
+    uint_fast8_t                    is_negative;                                // flag: temperature is negative
+    uint_fast16_t                   raw_temp;                                   // raw temperature
+    uint_fast8_t                    valid;                                      // flag: last read successful, CRC ok
+} DS18XX_SENSOR;
+
+typedef struct
+{
+    PT                              pt;
+    uint32_t                        start;                                      // start of conversion, see timer_ms
+    uint32_t                        poll_start;                                 // start of poll interval, see timer_ms
+    uint_fast8_t                    idx;                                        // index of sensor being read
+    uint_fast8_t                    resolution;                                 // result: resolution in bits of first sensor
+    uint_fast8_t                    is_negative;                                // result: flag: temperature of first sensor is negative
+    uint_fast16_t                   raw_temp;                                   // result: raw temperature of first sensor
+    uint_fast8_t                    rtc;                                        // result: number of sensors read, 0 = failed
+} DS18XX_READ_CTX;
 
 extern uint_fast8_t                 ds18xx_is_up;
 
+extern void                         ds18xx_read_raw_temp_start (DS18XX_READ_CTX *);
+extern uint_fast8_t                 ds18xx_read_raw_temp_pt (DS18XX_READ_CTX *);
 extern uint_fast8_t                 ds18xx_read_raw_temp (uint_fast8_t *, uint_fast8_t *, uint_fast16_t *);
 extern uint_fast8_t                 ds18xx_read_temp (float *);
 extern uint_fast8_t                 ds18xx_get_family_code (void);
+extern uint_fast8_t                 ds18xx_get_n_sensors (void);
+extern const DS18XX_SENSOR *        ds18xx_get_sensor (uint_fast8_t);
 extern uint_fast8_t                 ds18xx_init (uint_fast8_t);
 
 #endif
@@ -0,0 +1,53 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * eeprom-config.h - configuration of I2C EEPROM
+ *
+ * Copyright (c) 2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef EEPROM_CONFIG_H
+#define EEPROM_CONFIG_H
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * page size of 24Cxx EEPROM with 16 bit addresses:
+ *
+ *   24C32, 24C64:          32 bytes
+ *   24C128, 24C256:        64 bytes
+ *   24C512:               128 bytes
+ *
+ * One write cycle writes up to one page, a write must not cross a page boundary. 32 works with every EEPROM above.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define EEPROM_PAGE_SIZE            32                                      // change here: page size of EEPROM
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * end of write cycle: the EEPROM does not acknowledge its address while writing (typ. 5 ms, max. 10 ms for 24Cxx).
+ * It is polled until it acknowledges again, but not longer than EEPROM_WRITE_TIMEOUT_MS.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define EEPROM_WRITE_TIMEOUT_MS     20                                      // change here: max. time of write cycle
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * RAM shadow: eeprom_read() and eeprom_write() use a RAM image of the settings with EEPROM_SHADOW_SIZE bytes. eeprom_poll()
+ * writes changed fields EEPROM_FLUSH_DELAY_MS after the last change. Settings changed within this time are lost on
+ * power failure. EEPROM_SHADOW_SIZE must not be less than EEPROM_DATA_END, the first EEPROM_SHADOW_SIZE bytes of the
+ * EEPROM hold the fixed layout of older firmware and are only read for import.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define EEPROM_SHADOW_SIZE          256                                     // change here: size of RAM shadow
+#define EEPROM_FLUSH_DELAY_MS       2000                                    // change here: quiet time before flush
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * log of configuration records: every changed field is appended as a record of 32 bytes, round robin over
+ * EEPROM_LOG_SLOTS slots behind the fixed area. More slots spread the wear but need a longer scan at boot,
+ * approx. 2.9 ms per slot at 100 kHz. The log must fit into the EEPROM: EEPROM_SHADOW_SIZE + 32 * EEPROM_LOG_SLOTS,
+ * 64 slots need 2304 bytes (24C32 and above). Values: number of tags + 1 ... 254
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define EEPROM_LOG_SLOTS            64                                      // change here: number of record slots
+
+#endif // EEPROM_CONFIG_H
@@ -16,7 +16,8 @@
 #define EEPROM_VERSION_1_5_0        0x00010500                  // version 1.5.0
 #define EEPROM_VERSION_1_6_0        0x00010600                  // version 1.6.0
 #define EEPROM_VERSION_1_7_0        0x00010700                  // version 1.7.0
-#define EEPROM_VERSION              EEPROM_VERSION_1_7_0        // current version
+#define EEPROM_VERSION_1_8_0        0x00010800                  // version 1.8.0
+#define EEPROM_VERSION              EEPROM_VERSION_1_8_0        // current version
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * Some packed structures to minimize used EEPROM space
@@ -52,8 +53,11 @@ typedef struct __attribute__ ((__packed__))
  *      Global brightness     1 Byte    ( 1 *  1)
  *      Automatic brightness  1 Byte    ( 1 *  1)
  *      Night time           32 Byte    ( 8 *  4)
+ *      Clock drift           4 Bytes   ( 1 *  4)
  *      =========================================
- *      Sum                 227 Bytes
+ *      Sum                 231 Bytes
+ *
+ * Every field is stored as a record in the log of eeprom.c. A new field needs a new entry in eeprom_tags[] there.
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 
@@ -77,6 +81,7 @@ typedef struct __attribute__ ((__packed__))
 #define EEPROM_DATA_SIZE_BRIGHTNESS         sizeof (uint8_t)
 #define EEPROM_DATA_SIZE_AUTO_BRIGHTNESS    sizeof (uint8_t)
 #define EEPROM_DATA_NIGHT_TIME              (EEPROM_MAX_NIGHT_TIME_LEN)
+#define EEPROM_DATA_SIZE_CLOCK_DRIFT        sizeof (int32_t)
 
 #define EEPROM_DATA_OFFSET_VERSION          0
 #define EEPROM_DATA_OFFSET_IRMP_DATA        (EEPROM_DATA_OFFSET_VERSION             + EEPROM_DATA_SIZE_VERSION)
@@ -91,6 +96,8 @@ typedef struct __attribute__ ((__packed__))
 #define EEPROM_DATA_OFFSET_AUTO_BRIGHTNESS  (EEPROM_DATA_OFFSET_BRIGHTNESS          + EEPROM_DATA_SIZE_BRIGHTNESS)
 #define EEPROM_DATA_OFFSET_NIGHT_TIME       (EEPROM_DATA_OFFSET_AUTO_BRIGHTNESS     + EEPROM_DATA_SIZE_AUTO_BRIGHTNESS)
 
-#define EEPROM_DATA_END                     (EEPROM_DATA_OFFSET_NIGHT_TIME          + EEPROM_MAX_NIGHT_TIME_LEN)
+#define EEPROM_DATA_OFFSET_CLOCK_DRIFT      (EEPROM_DATA_OFFSET_NIGHT_TIME          + EEPROM_MAX_NIGHT_TIME_LEN)
+
+#define EEPROM_DATA_END                     (EEPROM_DATA_OFFSET_CLOCK_DRIFT         + EEPROM_DATA_SIZE_CLOCK_DRIFT)
 
 #endif
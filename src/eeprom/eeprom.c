@@ -3,49 +3,289 @@
  *
  * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
  *
+ * The settings are kept in a RAM image with the layout of eeprom-data.h. The image is split into fields by the tag table
+ * eeprom_tags[]. Every field is stored as a record of EEPROM_RECORD_SIZE bytes in a log behind the old fixed area:
+ *
+ *   tag (1), version (1), length (1), sequence number (4), payload (up to 23), CRC16-CCITT of the bytes before (2)
+ *
+ * A changed field is appended as a new record to the next slot of the log which does not hold a live record, so the
+ * slots are written round robin and the previous record of the field stays valid until the new one is complete.
+ * At boot the log is scanned once, the valid record with the highest sequence number of every tag wins. A record with
+ * another version than the tag table is ignored, so the field reads 0xFF and the module writes its default.
+ *
+ * The fixed area [0, EEPROM_SHADOW_SIZE) of older firmware is not written anymore. It is imported once if the log is empty.
+ *
+ * If no I2C EEPROM is found, the image is stored in the internal flash instead, see flash-eeprom.c.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
+#include <string.h>
+#include <stddef.h>
 #include "eeprom.h"
+#include "eeprom-config.h"
+#include "eeprom-data.h"
+#include "night.h"
+#include "flash-eeprom.h"
 #include "i2c.h"
+#include "pt.h"
 
 #define EEPROM_FIRST_ADDR       0xA0
-#define EEPROM_WAITSTATES       15                              // we have to wait 15ms after each write cycle
+
+#define EEPROM_RECORD_SIZE      32                              // size of one slot in log
+#define EEPROM_RECORD_HEADER    7                               // tag, version, len, seq
+#define EEPROM_MAX_PAYLOAD      (EEPROM_RECORD_SIZE - EEPROM_RECORD_HEADER - sizeof (uint16_t))
+#define EEPROM_LOG_START        EEPROM_SHADOW_SIZE              // log starts behind old fixed area
+#define EEPROM_LOG_ADDR(s)      (EEPROM_LOG_START + (s) * EEPROM_RECORD_SIZE)
+#define EEPROM_NO_SLOT          0xFF
+
+typedef struct __attribute__ ((__packed__))
+{
+    uint8_t                     tag;                            // index of eeprom_tags[], 0xFF = erased slot
+    uint8_t                     version;                        // version of payload, see eeprom_tags[]
+    uint8_t                     len;                            // length of payload
+    uint32_t                    seq;                            // sequence number, the highest one wins
+    uint8_t                     payload[EEPROM_MAX_PAYLOAD];
+    uint16_t                    crc;                            // CRC16-CCITT of all bytes before
+} EEPROM_RECORD;
+
+typedef struct
+{
+    uint16_t                    offset;                         // offset in image, see eeprom-data.h
+    uint8_t                     size;                           // size of field
+    uint8_t                     version;                        // increment it if the format of the field changes
+} EEPROM_TAG;
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * tag table: index = tag. Never reorder or remove entries, append new ones. Fields larger than EEPROM_MAX_PAYLOAD are
+ * split into several tags.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define EEPROM_TAGS             19
+#define EEPROM_IRMP_CHUNK       (4 * sizeof (PACKED_IRMP_DATA))                 // 4 IR codes per record, 20 bytes
+#define EEPROM_NIGHT_CHUNK      (EEPROM_MAX_NIGHT_TIME_LEN / 2)                 // 4 night times per record, 12 bytes
+
+#if EEPROM_MAX_IR_CODES != 32 || MAX_NIGHT_TIMES != 8
+#error EEPROM_MAX_IR_CODES or MAX_NIGHT_TIMES changed, adjust eeprom_tags[]
+#endif
+
+static const EEPROM_TAG         eeprom_tags[EEPROM_TAGS] =
+{
+    { EEPROM_DATA_OFFSET_VERSION,                               EEPROM_DATA_SIZE_VERSION,           1 },    //  0
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 0 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  1
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 1 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  2
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 2 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  3
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 3 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  4
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 4 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  5
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 5 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  6
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 6 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  7
+    { EEPROM_DATA_OFFSET_IRMP_DATA + 7 * EEPROM_IRMP_CHUNK,     EEPROM_IRMP_CHUNK,                  1 },    //  8
+    { EEPROM_DATA_OFFSET_DSP_COLORS,                            EEPROM_DATA_SIZE_DSP_COLORS,        1 },    //  9
+    { EEPROM_DATA_OFFSET_DISPLAY_MODE,                          EEPROM_DATA_SIZE_DISPLAY_MODE,      1 },    // 10
+    { EEPROM_DATA_OFFSET_ANIMATION_MODE,                        EEPROM_DATA_SIZE_ANIMATION_MODE,    1 },    // 11
+    { EEPROM_DATA_OFFSET_TIMESERVER,                            EEPROM_DATA_SIZE_TIMESERVER,        1 },    // 12
+    { EEPROM_DATA_OFFSET_TIMEZONE,                              EEPROM_DATA_SIZE_TIMEZONE,          1 },    // 13
+    { EEPROM_DATA_OFFSET_BRIGHTNESS,                            EEPROM_DATA_SIZE_BRIGHTNESS,        1 },    // 14
+    { EEPROM_DATA_OFFSET_AUTO_BRIGHTNESS,                       EEPROM_DATA_SIZE_AUTO_BRIGHTNESS,   1 },    // 15
+    { EEPROM_DATA_OFFSET_NIGHT_TIME + 0 * EEPROM_NIGHT_CHUNK,   EEPROM_NIGHT_CHUNK,                 1 },    // 16
+    { EEPROM_DATA_OFFSET_NIGHT_TIME + 1 * EEPROM_NIGHT_CHUNK,   EEPROM_NIGHT_CHUNK,                 1 },    // 17
+    { EEPROM_DATA_OFFSET_CLOCK_DRIFT,                           EEPROM_DATA_SIZE_CLOCK_DRIFT,       1 },    // 18
+};
+
+#if EEPROM_LOG_SLOTS >= EEPROM_NO_SLOT
+#error EEPROM_LOG_SLOTS too large, see EEPROM_NO_SLOT
+#endif
+
+typedef struct
+{
+    PT                          pt;
+    uint_fast16_t               addr;                           // next EEPROM address to write
+    uint8_t *                   buffer;                         // next byte to write
+    uint_fast16_t               cnt;                            // number of bytes left
+    uint_fast16_t               len;                            // number of bytes in current page
+    uint32_t                    start;                          // start of write cycle, see timer_ms
+    uint_fast8_t                rtc;                            // result: 1 = successful, 0 = failed
+} EEPROM_WRITE_CTX;
+
+typedef struct
+{
+    PT                          pt;
+    uint_fast8_t                active;                         // flag: flush is running
+    uint_fast8_t                tag;                            // current tag
+    uint_fast8_t                slot;                           // slot of new record
+    EEPROM_RECORD               rec;                            // new record
+    EEPROM_WRITE_CTX            write_ctx;
+} EEPROM_FLUSH_CTX;
 
 uint_fast8_t                    eeprom_is_up = 0;
-volatile uint_fast8_t           eeprom_ms_tick;                 // should be set every 1 ms by IRQ, see main.c
 
-static  uint_fast8_t            eeprom_addr;
+static  uint_fast8_t            eeprom_addr;                    // I2C address of EEPROM, 0 = internal flash
+
+static uint8_t                  eeprom_shadow[EEPROM_SHADOW_SIZE];  // RAM image of settings, setters write here
+static uint32_t                 eeprom_dirty;                   // one bit per tag: changed, not written yet
+static uint32_t                 eeprom_last_change;             // time of last change of shadow, see timer_ms
+static uint8_t                  eeprom_live_slot[EEPROM_TAGS];  // slot of current record per tag or EEPROM_NO_SLOT
+static uint_fast8_t             eeprom_log_head;                // slot behind newest record
+static uint32_t                 eeprom_next_seq;                // sequence number of next record
+static EEPROM_FLUSH_CTX         flush_ctx;
 
+#if EEPROM_TAGS > 32
+#error too many tags, see eeprom_dirty
+#endif
 
-/*--------------------------------------------------------------------------------------------------------------------------------------
- * eeprom_waitstates() - wait 15 ms after each write cycle
- *--------------------------------------------------------------------------------------------------------------------------------------
+#if EEPROM_LOG_SLOTS <= EEPROM_TAGS
+#error EEPROM_LOG_SLOTS must be greater than number of tags
+#endif
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: CRC16-CCITT (polynomial 0x1021, start value 0xFFFF)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint16_t
+eeprom_crc16 (const uint8_t * buffer, uint_fast8_t cnt)
+{
+    uint16_t        crc = 0xFFFF;
+    uint_fast8_t    i;
+
+    while (cnt--)
+    {
+        crc ^= (uint16_t) *buffer++ << 8;
+
+        for (i = 0; i < 8; i++)
+        {
+            if (crc & 0x8000)
+            {
+                crc = (crc << 1) ^ 0x1021;
+            }
+            else
+            {
+                crc <<= 1;
+            }
+        }
+    }
+
+    return crc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: check record: known tag, length of tag table and CRC
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+eeprom_record_valid (const EEPROM_RECORD * rec)
+{
+    if (rec->tag < EEPROM_TAGS && rec->len == eeprom_tags[rec->tag].size &&
+        rec->crc == eeprom_crc16 ((const uint8_t *) rec, offsetof (EEPROM_RECORD, crc)))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct
+{
+    uint32_t                    best_seq[EEPROM_TAGS];          // sequence number of newest record per tag
+    uint32_t                    seen;                           // one bit per tag: record found
+    uint_fast8_t                found;                          // flag: log has at least one valid record
+} EEPROM_SCAN_CTX;
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: parse one record of the log, called by i2c_read_chunks() for every slot
+ *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 static void
-eeprom_waitstates (void)
+eeprom_scan_record (void * vctx, uint8_t * data, uint_fast16_t slot)
 {
-    uint_fast16_t  cnt = 0;
+    EEPROM_SCAN_CTX *       ctx = vctx;
+    const EEPROM_RECORD *   rec = (const EEPROM_RECORD *) data;
+    uint_fast8_t            tag;
 
-    while (1)
+    if (eeprom_record_valid (rec))
     {
-        if (eeprom_ms_tick)
+        tag = rec->tag;
+
+        if (! ctx->found || rec->seq >= eeprom_next_seq)
         {
-            eeprom_ms_tick = 0;
+            eeprom_next_seq = rec->seq + 1;
+            eeprom_log_head = (slot + 1) % EEPROM_LOG_SLOTS;
+            ctx->found = 1;
+        }
 
-            cnt++;
+        if (! (ctx->seen & (1UL << tag)) || rec->seq > ctx->best_seq[tag])
+        {
+            ctx->best_seq[tag] = rec->seq;
+            ctx->seen |= 1UL << tag;
 
-            if (cnt > EEPROM_WAITSTATES)
+            if (rec->version == eeprom_tags[tag].version)
             {
-                break;
+                memcpy (eeprom_shadow + eeprom_tags[tag].offset, rec->payload, rec->len);
+                eeprom_live_slot[tag] = slot;
+            }
+            else
+            {                                                       // other format: field reads 0xFF, module writes default
+                memset (eeprom_shadow + eeprom_tags[tag].offset, 0xFF, rec->len);
+                eeprom_live_slot[tag] = EEPROM_NO_SLOT;
             }
         }
     }
 }
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: scan log, load newest record of every tag into shadow
+ *
+ * The whole log is read in one sequential I2C transfer, only one record at a time is held in RAM.
+ *
+ * Return value: 1 = ok, 0 = I2C error. If the log is empty, the fixed area of older firmware is imported.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+eeprom_scan (void)
+{
+    EEPROM_RECORD   rec;
+    EEPROM_SCAN_CTX ctx;
+    uint_fast8_t    tag;
+
+    memset (eeprom_shadow, 0xFF, EEPROM_SHADOW_SIZE);
+    memset (eeprom_live_slot, EEPROM_NO_SLOT, EEPROM_TAGS);
+    eeprom_log_head = 0;
+    eeprom_next_seq = 0;
+    ctx.seen        = 0;
+    ctx.found       = 0;
+
+    if (i2c_read_chunks (eeprom_addr, EEPROM_LOG_ADDR(0), 1, (uint8_t *) &rec, EEPROM_RECORD_SIZE, EEPROM_LOG_SLOTS,
+                         eeprom_scan_record, &ctx) != I2C_OK)
+    {
+        return 0;
+    }
+
+    if (! ctx.found)                                                // empty log: import fixed area of older firmware
+    {
+        if (i2c_read (eeprom_addr, 0x00, 1, eeprom_shadow, EEPROM_SHADOW_SIZE) != I2C_OK)
+        {
+            return 0;
+        }
+
+        for (tag = 0; tag < EEPROM_TAGS; tag++)
+        {
+            uint_fast8_t i;
+
+            for (i = 0; i < eeprom_tags[tag].size; i++)
+            {
+                if (eeprom_shadow[eeprom_tags[tag].offset + i] != 0xFF)
+                {
+                    eeprom_dirty |= 1UL << tag;
+                    eeprom_last_change = timer_ms;
+                    break;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * initialize EEPROM functions
@@ -65,16 +305,26 @@ eeprom_init (void)
 
         if (i2c_read (eeprom_addr, 0x00, 1, &value, 1) == I2C_OK)
         {
-            eeprom_is_up = 1;
-            break;
+            if (eeprom_scan ())
+            {
+                eeprom_is_up = 1;
+            }
+            return eeprom_is_up;
         }
     }
 
+    eeprom_addr = 0;                                            // no I2C EEPROM fitted: use internal flash
+
+    if (flash_eeprom_init (eeprom_shadow))
+    {
+        eeprom_is_up = 1;
+    }
+
     return eeprom_is_up;
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * get address of EEPROM
+ * get address of EEPROM, 0 = EEPROM emulated in internal flash
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
@@ -84,7 +334,7 @@ eeprom_get_address (void)
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * read EEPROM
+ * read EEPROM, served by the shadow
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
@@ -92,55 +342,243 @@ eeprom_read (uint_fast16_t start_addr, uint8_t * buffer, uint_fast16_t cnt)
 {
     uint_fast8_t    rtc;
 
+    if (eeprom_is_up && start_addr + cnt <= EEPROM_SHADOW_SIZE)
+    {
+        memcpy (buffer, eeprom_shadow + start_addr, cnt);
+        rtc = 1;
+    }
+    else
+    {
+        rtc = 0;
+    }
+    return rtc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: start writing EEPROM with eeprom_write_pt()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+eeprom_write_start (EEPROM_WRITE_CTX * ctx, uint_fast16_t start_addr, uint8_t * buffer, uint_fast16_t cnt)
+{
+    PT_INIT(&ctx->pt);
+    ctx->addr   = start_addr;
+    ctx->buffer = buffer;
+    ctx->cnt    = cnt;
+    ctx->rtc    = 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: write EEPROM (protothread), yields while waiting for the write cycle of each page
+ *
+ * Every write cycle writes the bytes up to the next page boundary, see EEPROM_PAGE_SIZE. The end of the write cycle is
+ * detected by polling the EEPROM until it acknowledges its address again.
+ *
+ * Result in ctx->rtc: 1 = successful, 0 = failed
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static PT_THREAD(eeprom_write_pt (EEPROM_WRITE_CTX * ctx))
+{
+    PT_BEGIN(&ctx->pt);
+
     if (eeprom_is_up)
     {
-        if (i2c_read (eeprom_addr, start_addr, 1, buffer, cnt) == I2C_OK)
+        ctx->rtc = 1;
+
+        while (ctx->cnt > 0)
+        {
+            ctx->len = EEPROM_PAGE_SIZE - (ctx->addr % EEPROM_PAGE_SIZE);
+
+            if (ctx->len > ctx->cnt)
+            {
+                ctx->len = ctx->cnt;
+            }
+
+            if (i2c_write (eeprom_addr, ctx->addr, 1, ctx->buffer, ctx->len) != I2C_OK)
+            {
+                ctx->rtc = 0;
+                break;
+            }
+
+            ctx->start = timer_ms;
+            PT_WAIT_UNTIL(&ctx->pt, (ctx->rtc = (i2c_poll (eeprom_addr) == I2C_OK)) || PT_TIMEOUT(ctx->start, EEPROM_WRITE_TIMEOUT_MS));
+
+            if (! ctx->rtc)
+            {
+                break;
+            }
+
+            ctx->addr   += ctx->len;
+            ctx->buffer += ctx->len;
+            ctx->cnt    -= ctx->len;
+        }
+    }
+    else
+    {
+        ctx->rtc = 0;
+    }
+
+    PT_END(&ctx->pt);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: get next slot from head of log which does not hold a live record
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+eeprom_free_slot (void)
+{
+    uint_fast8_t    slot = eeprom_log_head;
+    uint_fast8_t    tag;
+
+    for (;;)                                                    // EEPROM_LOG_SLOTS > EEPROM_TAGS, so there is always one
+    {
+        for (tag = 0; tag < EEPROM_TAGS; tag++)
         {
-            rtc = 1;
+            if (eeprom_live_slot[tag] == slot)
+            {
+                break;
+            }
         }
-        else
+
+        if (tag == EEPROM_TAGS)
         {
-            rtc = 0;
+            return slot;
         }
+
+        slot = (slot + 1) % EEPROM_LOG_SLOTS;
     }
-    else
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: flush dirty tags of shadow (protothread)
+ *
+ * Every dirty field is compared with its live record first, unchanged fields are not written. If a field changes again
+ * while it is written, its dirty bit is set again and it is written by the next flush. On error the field stays dirty.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static PT_THREAD(eeprom_flush_pt (EEPROM_FLUSH_CTX * ctx))
+{
+    const EEPROM_TAG *  tp;
+
+    PT_BEGIN(&ctx->pt);
+
+    for (ctx->tag = 0; ctx->tag < EEPROM_TAGS; ctx->tag++)
     {
-        rtc = 0;
+        if (eeprom_dirty & (1UL << ctx->tag))
+        {
+            eeprom_dirty &= ~(1UL << ctx->tag);
+            tp = eeprom_tags + ctx->tag;
+
+            if (eeprom_live_slot[ctx->tag] != EEPROM_NO_SLOT &&
+                i2c_read (eeprom_addr, EEPROM_LOG_ADDR(eeprom_live_slot[ctx->tag]), 1, (uint8_t *) &ctx->rec, EEPROM_RECORD_SIZE) == I2C_OK &&
+                eeprom_record_valid (&ctx->rec) && ! memcmp (ctx->rec.payload, eeprom_shadow + tp->offset, tp->size))
+            {
+                continue;                                                   // field unchanged, e.g. value set back
+            }
+
+            memset (&ctx->rec, 0xFF, EEPROM_RECORD_SIZE);
+            ctx->rec.tag        = ctx->tag;
+            ctx->rec.version    = tp->version;
+            ctx->rec.len        = tp->size;
+            ctx->rec.seq        = eeprom_next_seq;
+            memcpy (ctx->rec.payload, eeprom_shadow + tp->offset, tp->size);
+            ctx->rec.crc        = eeprom_crc16 ((uint8_t *) &ctx->rec, offsetof (EEPROM_RECORD, crc));
+
+            ctx->slot = eeprom_free_slot ();
+            eeprom_write_start (&ctx->write_ctx, EEPROM_LOG_ADDR(ctx->slot), (uint8_t *) &ctx->rec, EEPROM_RECORD_SIZE);
+            PT_WAIT_WHILE(&ctx->pt, PT_SCHEDULE(eeprom_write_pt (&ctx->write_ctx)));
+
+            if (ctx->write_ctx.rtc)
+            {
+                eeprom_live_slot[ctx->tag] = ctx->slot;                     // old record is free now
+                eeprom_log_head = (ctx->slot + 1) % EEPROM_LOG_SLOTS;
+                eeprom_next_seq++;
+            }
+            else
+            {
+                eeprom_dirty |= 1UL << ctx->tag;                            // try again after EEPROM_FLUSH_DELAY_MS
+                eeprom_last_change = timer_ms;
+            }
+        }
     }
-    return rtc;
+
+    PT_END(&ctx->pt);
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * write EEPROM
+ *
+ * Only the shadow is written and the fields of changed bytes are marked dirty, see eeprom_poll(). Bytes which are not
+ * covered by eeprom_tags[] are not stored.
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
 eeprom_write (uint_fast16_t start_addr, uint8_t * buffer, uint_fast16_t cnt)
 {
-    uint_fast8_t rtc;
+    uint_fast8_t    tag;
+    uint_fast16_t   addr;
 
-    if (eeprom_is_up)
+    if (! eeprom_is_up || start_addr + cnt > EEPROM_SHADOW_SIZE)
+    {
+        return 0;
+    }
+
+    for (addr = start_addr; addr < start_addr + cnt; addr++, buffer++)
     {
-        // we must write every single byte, because we have to wait 15ms every cycle
-        while (cnt--)
+        if (eeprom_shadow[addr] != *buffer)
         {
-            if (i2c_write (eeprom_addr, start_addr, 1, buffer, 1) == I2C_OK)
+            eeprom_shadow[addr] = *buffer;
+
+            for (tag = 0; tag < EEPROM_TAGS; tag++)
             {
-                rtc = 1;
+                if (addr >= eeprom_tags[tag].offset && addr < eeprom_tags[tag].offset + eeprom_tags[tag].size)
+                {
+                    eeprom_dirty |= 1UL << tag;
+                    eeprom_last_change = timer_ms;
+                    break;
+                }
             }
-            else
+        }
+    }
+
+    return 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * write dirty fields of shadow to EEPROM in background, call it in every cycle of main loop
+ *
+ * The flush starts EEPROM_FLUSH_DELAY_MS after the last change, so a burst of settings (e.g. from the web interface)
+ * is written once. While the EEPROM is busy with a write cycle, eeprom_poll() returns immediately.
+ * The internal flash is written in one go, the CPU stalls while programming.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+eeprom_poll (void)
+{
+    if (! eeprom_addr)
+    {
+        if (eeprom_dirty && PT_TIMEOUT(eeprom_last_change, EEPROM_FLUSH_DELAY_MS))
+        {
+            eeprom_dirty = 0;
+
+            if (! flash_eeprom_write (eeprom_shadow))
             {
-                rtc = 0;
-                break;
+                eeprom_dirty = 1;                                           // try again after EEPROM_FLUSH_DELAY_MS
+                eeprom_last_change = timer_ms;
             }
-            eeprom_waitstates ();
-            start_addr++;
-            buffer++;
         }
     }
-    else
+    else if (flush_ctx.active)
     {
-        rtc = 0;
+        if (! PT_SCHEDULE(eeprom_flush_pt (&flush_ctx)))
+        {
+            flush_ctx.active = 0;
+        }
+    }
+    else if (eeprom_dirty && PT_TIMEOUT(eeprom_last_change, EEPROM_FLUSH_DELAY_MS))
+    {
+        PT_INIT(&flush_ctx.pt);
+        flush_ctx.active = 1;
     }
-    return rtc;
 }
@@ -0,0 +1,298 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * flash-eeprom.c - EEPROM emulation in internal flash, used if no I2C EEPROM is fitted
+ *
+ * Copyright (c) 2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * Two flash pages are used alternately. The valid page holds a list of entries, one 32 bit word each:
+ *
+ *   bits 0-15: data, bits 16-31: index of halfword in image
+ *
+ * A changed halfword of the image is appended as a new entry, the last entry of an index wins. A RAM copy of the image
+ * is kept, so reading costs nothing and only changed halfwords are programmed. If the page is full, the image is copied
+ * to the other page and the full page is erased.
+ *
+ *  - STM32F4x1: sector 1 and 2 (16 KB each) at 0x08004000 and 0x08008000, see VECTORS and ROM in stm32f4x1re_flash.ld
+ *  - STM32F103: page 62 and 63 (1 KB each) at 0x0800F800 and 0x0800FC00, see ROM in stm32f103c8_flash.ld
+ *
+ * The CPU stalls while the flash is programmed or erased, interrupts included. Erasing a 16 KB sector of the STM32F4x1
+ * takes up to 500 ms, a page of the STM32F103 up to 40 ms, so the 1 ms ticks of TIM2 are lost meanwhile. The time of
+ * every erase is measured with the DWT cycle counter, the caller fetches it with flash_eeprom_get_stall_ms() and
+ * catches up the lost ticks. An erase happens only after approx. 4000 (STM32F4x1) or 128 (STM32F103) changed halfwords.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include <string.h>
+#include "flash-eeprom.h"
+#include "eeprom-config.h"
+#include "delay.h"
+
+#if defined (STM32F401RE) || defined (STM32F411RE)         // STM32F401 / STM32F411 Nucleo Board: sector 1 + 2
+
+#  define FLASH_EEPROM_PAGE_SIZE        0x4000
+#  define FLASH_EEPROM_PAGE0            0x08004000
+#  define FLASH_EEPROM_PAGE1            0x08008000
+#  define FLASH_EEPROM_PAGE0_SECTOR     FLASH_Sector_1
+#  define FLASH_EEPROM_PAGE1_SECTOR     FLASH_Sector_2
+#  define FLASH_EEPROM_FLAGS            (FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR)
+
+#elif defined (STM32F103)                                   // STM32F103 Mini Development Board: page 62 + 63
+
+#  define FLASH_EEPROM_PAGE_SIZE        0x400
+#  define FLASH_EEPROM_PAGE0            0x0800F800
+#  define FLASH_EEPROM_PAGE1            0x0800FC00
+#  define FLASH_EEPROM_FLAGS            (FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPRTERR)
+
+#else
+#  error STM32 unknown
+#endif
+
+#define FLASH_EEPROM_HALFWORDS          (EEPROM_SHADOW_SIZE / 2)
+
+#define FLASH_EEPROM_ERASED             0xFFFFFFFF              // status of page: erased
+#define FLASH_EEPROM_RECEIVE            0xEEEEEEEE              // status of page: copy in progress
+#define FLASH_EEPROM_VALID              0x00000000              // status of page: valid
+
+#define FLASH_EEPROM_STATUS(p)          (*(volatile uint32_t *) (p))
+#define FLASH_EEPROM_OTHER(p)           ((p) == FLASH_EEPROM_PAGE0 ? FLASH_EEPROM_PAGE1 : FLASH_EEPROM_PAGE0)
+
+#if EEPROM_SHADOW_SIZE % 2 != 0
+#error EEPROM_SHADOW_SIZE must be even
+#endif
+
+#if FLASH_EEPROM_PAGE_SIZE / 4 - 1 <= FLASH_EEPROM_HALFWORDS                    // one full copy plus at least one change
+#error flash page too small for EEPROM_SHADOW_SIZE
+#endif
+
+static uint16_t                         flash_eeprom_cache[FLASH_EEPROM_HALFWORDS];    // image as stored in flash
+static uint32_t                         flash_eeprom_page;      // address of valid page
+static uint32_t                         flash_eeprom_next;      // address of next free entry
+static uint32_t                         flash_eeprom_stall;     // cycles of CPU stalled by erase, see flash_eeprom_get_stall_ms()
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: erase page
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+flash_eeprom_erase (uint32_t page)
+{
+    FLASH_Status    status;
+    uint32_t        start = delay_get_cycles ();
+
+#if defined (STM32F401RE) || defined (STM32F411RE)
+    status = FLASH_EraseSector (page == FLASH_EEPROM_PAGE0 ? FLASH_EEPROM_PAGE0_SECTOR : FLASH_EEPROM_PAGE1_SECTOR, VoltageRange_3);
+#elif defined (STM32F103)
+    status = FLASH_ErasePage (page);
+#endif
+
+    flash_eeprom_stall += delay_get_cycles () - start;
+    return status == FLASH_COMPLETE;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: program one word
+ *
+ * The STM32F103 programs halfwords: data first, index last. So an entry cut by power failure has index 0xFFFF and is ignored.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+flash_eeprom_program (uint32_t addr, uint32_t value)
+{
+#if defined (STM32F401RE) || defined (STM32F411RE)
+    return FLASH_ProgramWord (addr, value) == FLASH_COMPLETE;
+#elif defined (STM32F103)
+    return FLASH_ProgramHalfWord (addr, value & 0xFFFF) == FLASH_COMPLETE &&
+           FLASH_ProgramHalfWord (addr + 2, value >> 16) == FLASH_COMPLETE;
+#endif
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: read entries of valid page into cache
+ *
+ * flash_eeprom_write() skips an entry whose programming failed, so there may be erased or invalid entries between
+ * valid ones. They are skipped up to the last programmed word of the page, the next entry is written behind it.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+flash_eeprom_load (void)
+{
+    uint32_t        addr;
+    uint32_t        entry;
+
+    memset (flash_eeprom_cache, 0xFF, sizeof (flash_eeprom_cache));
+    flash_eeprom_next = flash_eeprom_page + 4;
+
+    for (addr = flash_eeprom_page + 4; addr < flash_eeprom_page + FLASH_EEPROM_PAGE_SIZE; addr += 4)
+    {
+        entry = *(volatile uint32_t *) addr;
+
+        if (entry == 0xFFFFFFFF)                                // erased: end of page or skipped entry
+        {
+            continue;
+        }
+
+        if ((entry >> 16) < FLASH_EEPROM_HALFWORDS)             // index 0xFFFF: STM32F103 entry cut by power failure
+        {
+            flash_eeprom_cache[entry >> 16] = entry & 0xFFFF;
+        }
+
+        flash_eeprom_next = addr + 4;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: copy image to other page, erase full page
+ *
+ * The new page is marked as valid after the old one is erased. If power fails before, the new page is complete and
+ * is found by flash_eeprom_init() in state RECEIVE.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+flash_eeprom_swap (const uint16_t * image)
+{
+    uint32_t        page = FLASH_EEPROM_OTHER(flash_eeprom_page);
+    uint32_t        addr;
+    uint_fast16_t   i;
+
+    if (FLASH_EEPROM_STATUS(page) != FLASH_EEPROM_ERASED && ! flash_eeprom_erase (page))
+    {
+        return 0;
+    }
+
+    if (! flash_eeprom_program (page, FLASH_EEPROM_RECEIVE))
+    {
+        return 0;
+    }
+
+    addr = page + 4;
+
+    for (i = 0; i < FLASH_EEPROM_HALFWORDS; i++)
+    {
+        if (image[i] != 0xFFFF)
+        {
+            if (! flash_eeprom_program (addr, ((uint32_t) i << 16) | image[i]))
+            {
+                return 0;
+            }
+            addr += 4;
+        }
+
+        flash_eeprom_cache[i] = image[i];
+    }
+
+    if (! flash_eeprom_erase (flash_eeprom_page) || ! flash_eeprom_program (page, FLASH_EEPROM_VALID))
+    {
+        return 0;
+    }
+
+    flash_eeprom_page = page;
+    flash_eeprom_next = addr;
+    return 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * initialize EEPROM emulation, copy image of EEPROM_SHADOW_SIZE bytes into buffer
+ *
+ * A page in state RECEIVE without a valid page is the result of a swap cut by power failure after copying, so it is
+ * complete. A page in state RECEIVE beside a valid page may be incomplete and is erased.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+flash_eeprom_init (uint8_t * buffer)
+{
+    uint32_t        status0 = FLASH_EEPROM_STATUS(FLASH_EEPROM_PAGE0);
+    uint32_t        status1 = FLASH_EEPROM_STATUS(FLASH_EEPROM_PAGE1);
+    uint_fast8_t    rtc = 1;
+
+    FLASH_Unlock ();
+    FLASH_ClearFlag (FLASH_EEPROM_FLAGS);
+
+    if (status0 == FLASH_EEPROM_VALID || status1 == FLASH_EEPROM_VALID)
+    {
+        flash_eeprom_page = (status0 == FLASH_EEPROM_VALID) ? FLASH_EEPROM_PAGE0 : FLASH_EEPROM_PAGE1;
+    }
+    else if (status0 == FLASH_EEPROM_RECEIVE || status1 == FLASH_EEPROM_RECEIVE)
+    {
+        flash_eeprom_page = (status0 == FLASH_EEPROM_RECEIVE) ? FLASH_EEPROM_PAGE0 : FLASH_EEPROM_PAGE1;
+        rtc = flash_eeprom_program (flash_eeprom_page, FLASH_EEPROM_VALID);
+    }
+    else                                                        // first use: format
+    {
+        flash_eeprom_page = FLASH_EEPROM_PAGE0;
+        rtc = (status0 == FLASH_EEPROM_ERASED || flash_eeprom_erase (FLASH_EEPROM_PAGE0)) &&
+              flash_eeprom_program (FLASH_EEPROM_PAGE0, FLASH_EEPROM_VALID);
+    }
+
+    if (rtc && FLASH_EEPROM_STATUS(FLASH_EEPROM_OTHER(flash_eeprom_page)) != FLASH_EEPROM_ERASED)
+    {
+        rtc = flash_eeprom_erase (FLASH_EEPROM_OTHER(flash_eeprom_page));
+    }
+
+    FLASH_Lock ();
+
+    if (rtc)
+    {
+        flash_eeprom_load ();
+        memcpy (buffer, flash_eeprom_cache, EEPROM_SHADOW_SIZE);
+    }
+
+    return rtc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get time in ms the CPU has been stalled by erasing flash since last call, interrupts have been blocked meanwhile
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint32_t
+flash_eeprom_get_stall_ms (void)
+{
+    uint32_t    ms = flash_eeprom_stall / (SystemCoreClock / 1000);
+
+    flash_eeprom_stall -= ms * (SystemCoreClock / 1000);        // keep the remainder
+    return ms;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * write image of EEPROM_SHADOW_SIZE bytes, only changed halfwords are programmed
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+flash_eeprom_write (const uint8_t * buffer)
+{
+    uint16_t        image[FLASH_EEPROM_HALFWORDS];
+    uint_fast16_t   i;
+    uint_fast8_t    rtc = 1;
+
+    memcpy (image, buffer, EEPROM_SHADOW_SIZE);
+
+    FLASH_Unlock ();
+    FLASH_ClearFlag (FLASH_EEPROM_FLAGS);
+
+    for (i = 0; i < FLASH_EEPROM_HALFWORDS; i++)
+    {
+        if (image[i] != flash_eeprom_cache[i])
+        {
+            if (flash_eeprom_next >= flash_eeprom_page + FLASH_EEPROM_PAGE_SIZE)
+            {
+                rtc = flash_eeprom_swap (image);                // copies all remaining changes too
+                break;
+            }
+
+            flash_eeprom_next += 4;                             // skip entry on error, it may be written partly
+
+            if (! flash_eeprom_program (flash_eeprom_next - 4, ((uint32_t) i << 16) | image[i]))
+            {
+                rtc = 0;
+                break;
+            }
+
+            flash_eeprom_cache[i] = image[i];
+        }
+    }
+
+    FLASH_Lock ();
+    return rtc;
+}
@@ -0,0 +1,25 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * flash-eeprom.h - declarations of EEPROM emulation in internal flash
+ *
+ * Copyright (c) 2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef FLASH_EEPROM_H
+#define FLASH_EEPROM_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+extern uint_fast8_t             flash_eeprom_init (uint8_t *);
+extern uint_fast8_t             flash_eeprom_write (const uint8_t *);
+extern uint32_t                 flash_eeprom_get_stall_ms (void);
+
+#endif
@@ -0,0 +1,248 @@
+/*---------------------------------------------------------------------------------------------------------------------------------------------------
+ * esp8266-test.c - host test of ESP8266 protothreads, see esp8266-test.sh
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * The protothreads esp8266_send_cmd_pt() and esp8266_reset_pt() are scheduled once per simulated millisecond. The ESP8266
+ * UART is replaced by a script of answers, every character of an answer becomes available one millisecond after the
+ * previous one. A protothread which does not return while the simulated time stands still is reported as blocking.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *---------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp8266.h"
+
+#define MAX_RX_LEN          256
+#define MAX_TX_LEN          256
+#define MAX_CALLS_PER_MS    1000                                        // more polls without time progress: protothread blocks
+#define MAX_TEST_MS         5000
+
+typedef struct
+{
+    uint32_t        at;                                                 // time of first character, relative to start of test
+    const char *    text;
+} ANSWER;
+
+volatile uint32_t   timer_ms;
+GPIO_TypeDef        gpio_a;
+
+static char         rx_buf[MAX_RX_LEN];
+static uint32_t     rx_at[MAX_RX_LEN];
+static uint_fast16_t rx_len;
+static uint_fast16_t rx_pos;
+static char         tx_buf[MAX_TX_LEN];
+static uint_fast16_t tx_len;
+static uint32_t     polls;
+static uint32_t     polls_ms;
+static uint32_t     rst_low_at;
+static uint32_t     rst_high_at;
+static int          errors;
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * stubs of hardware routines
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+void GPIO_StructInit (GPIO_InitTypeDef * gpio)                              { (void) gpio; }
+void GPIO_Init (GPIO_TypeDef * port, GPIO_InitTypeDef * gpio)               { (void) port; (void) gpio; }
+void RCC_APB2PeriphClockCmd (uint32_t periph, FunctionalState state)        { (void) periph; (void) state; }
+
+void
+GPIO_WriteBit (GPIO_TypeDef * port, uint16_t pin, BitAction val)
+{
+    (void) port;
+
+    if (pin == GPIO_Pin_0)                                                  // RST of ESP8266 on STM32F103
+    {
+        if (val == Bit_RESET)
+        {
+            rst_low_at = timer_ms;
+        }
+        else
+        {
+            rst_high_at = timer_ms;
+        }
+    }
+}
+
+void            log_uart_init (uint32_t baud)                               { (void) baud; }
+void            log_uart_putc (uint_fast8_t ch)                             { (void) ch; }
+void            log_uart_puts (char * s)                                    { (void) s; }
+void            log_uart_flush (void)                                       { ; }
+uint_fast8_t    log_uart_poll (uint_fast8_t * chp)                          { (void) chp; return 0; }
+
+void            esp8266_uart_init (uint32_t baud)                           { (void) baud; }
+void            esp8266_uart_flush (void)                                   { ; }
+
+void
+esp8266_uart_putc (uint_fast8_t ch)
+{
+    if (tx_len < MAX_TX_LEN - 1)
+    {
+        tx_buf[tx_len++] = ch;
+        tx_buf[tx_len] = '\0';
+    }
+}
+
+void
+esp8266_uart_puts (char * s)
+{
+    while (*s)
+    {
+        esp8266_uart_putc (*s++);
+    }
+}
+
+uint_fast8_t
+esp8266_uart_char_available (void)
+{
+    if (polls_ms != timer_ms)
+    {
+        polls_ms = timer_ms;
+        polls = 0;
+    }
+
+    if (++polls > MAX_CALLS_PER_MS)
+    {
+        printf ("FAIL: protothread blocks at %u ms\n", (unsigned int) timer_ms);
+        exit (1);
+    }
+
+    return rx_pos < rx_len && rx_at[rx_pos] <= timer_ms;
+}
+
+uint_fast8_t
+esp8266_uart_poll (uint_fast8_t * chp)
+{
+    if (esp8266_uart_char_available ())
+    {
+        *chp = (uint8_t) rx_buf[rx_pos++];
+        return 1;
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * load answers into simulated UART, start new test
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+test_start (const ANSWER * answers)
+{
+    uint32_t    at;
+    const char * p;
+
+    timer_ms    = 1000;
+    rx_len      = 0;
+    rx_pos      = 0;
+    tx_len      = 0;
+    tx_buf[0]   = '\0';
+    rst_low_at  = 0;
+    rst_high_at = 0;
+
+    for ( ; answers && answers->text; answers++)
+    {
+        at = timer_ms + answers->at;
+
+        for (p = answers->text; *p && rx_len < MAX_RX_LEN; p++)
+        {
+            rx_at[rx_len]    = at++;
+            rx_buf[rx_len++] = *p;
+        }
+    }
+}
+
+static void
+check (const char * name, const char * what, long value, long expected)
+{
+    if (value != expected)
+    {
+        printf ("FAIL: %-24s %-10s %ld, expected %ld\n", name, what, value, expected);
+        errors++;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * run esp8266_send_cmd_pt() once per millisecond until it has finished
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+test_send_cmd (const char * name, const ANSWER * answers, uint_fast8_t expected_rtc, uint32_t expected_ms)
+{
+    ESP8266_CTX     ctx;
+    uint32_t        start;
+
+    test_start (answers);
+    start = timer_ms;
+
+    esp8266_send_cmd_start (&ctx, "cmd");
+
+    while (PT_SCHEDULE(esp8266_send_cmd_pt (&ctx)) && timer_ms - start < MAX_TEST_MS)
+    {
+        timer_ms++;
+    }
+
+    check (name, "rtc", ctx.rtc, expected_rtc);
+    check (name, "duration", timer_ms - start, expected_ms);
+    check (name, "command", strcmp (tx_buf, "cmd\r\n"), 0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * run esp8266_reset_pt() once per millisecond until it has finished
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+test_reset (const char * name, const ANSWER * answers, uint32_t expected_ms)
+{
+    ESP8266_CTX     ctx;
+    uint32_t        start;
+
+    test_start (answers);
+    start = timer_ms;
+
+    esp8266_reset_start (&ctx);
+
+    while (PT_SCHEDULE(esp8266_reset_pt (&ctx)) && timer_ms - start < MAX_TEST_MS)
+    {
+        timer_ms++;
+    }
+
+    check (name, "rtc", ctx.rtc, 1);
+    check (name, "rst low", rst_low_at - start, 0);
+    check (name, "rst high", rst_high_at - start, 50);
+    check (name, "duration", timer_ms - start, expected_ms);
+    check (name, "boot msg", rx_len - rx_pos, 0);
+}
+
+int
+main (void)
+{
+    static const ANSWER ok[]        = { { 20, "OK\r\n" }, { 0, NULL } };
+    static const ANSWER error[]     = { { 20, "ERROR\r\n" }, { 0, NULL } };
+    static const ANSWER debug_ok[]  = { { 10, "- busy\r\n" }, { 50, "\r\nOK\r\n" }, { 0, NULL } };
+    static const ANSWER slow_ok[]   = { { 90, "O" }, { 180, "K\r\n" }, { 0, NULL } };
+    static const ANSWER broken[]    = { { 20, "OK" }, { 0, NULL } };
+    static const ANSWER ip_ok[]     = { { 5, "IPADDRESS 192.168.1.2\r\n" }, { 40, "OK\r\n" }, { 0, NULL } };
+    static const ANSWER boot[]      = { { 60, "ready\r\n" }, { 300, "- boot\r\n" }, { 0, NULL } };
+
+    test_send_cmd ("ok",            ok,         1,   23);           // 'O' at 20, '\n' at 23
+    test_send_cmd ("error",         error,      0,   26);
+    test_send_cmd ("debug, ok",     debug_ok,   1,   55);           // debug message does not end the command
+    test_send_cmd ("slow ok",       slow_ok,    1,  182);           // gap of 90 ms between characters is no timeout
+    test_send_cmd ("no answer",     NULL,       0,  100);
+    test_send_cmd ("no line end",   broken,     0,  121);           // timeout 100 ms after last character, no second wait
+    test_send_cmd ("ip address, ok", ip_ok,     1,   43);
+
+    check ("ip address, ok", "ipaddress", strcmp (esp8266_get_ip_address (), "192.168.1.2"), 0);
+    check ("ip address, ok", "online", esp8266_get_online_status (), 1);
+
+    test_reset ("reset, boot message", boot, 807);                  // last character at 307, then 500 ms silence
+    test_reset ("reset, silent", NULL, 550);
+
+    printf ("%s\n", errors ? "FAILED" : "ok");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+#!/bin/sh
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+# esp8266-test.sh - host test of ESP8266 protothreads
+#
+# usage: src/esp8266/esp8266-test.sh
+#
+# Builds esp8266.c together with esp8266-test.c on the host. The STM32 headers are replaced by a small stub header, the
+# UART and GPIO routines are simulated by esp8266-test.c. esp8266_send_cmd_pt() and esp8266_reset_pt() are scheduled once
+# per simulated millisecond against scripted answers of the ESP8266: result, duration and the RST pulse are checked, and a
+# protothread which does not yield while waiting is reported. Prints "ok" and exits with 0 if all checks have passed.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+
+ESP8266_DIR=$(dirname "$0")
+SRC_DIR=$ESP8266_DIR/..
+
+TMP_DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+cat > "$TMP_DIR"/stm32f10x.h << 'STUB'
+#ifndef STM32F10X_H
+#define STM32F10X_H
+#include <stdint.h>
+typedef enum { RESET = 0, SET = !RESET } FlagStatus;
+typedef enum { Bit_RESET = 0, Bit_SET } BitAction;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+typedef struct { int dummy; } GPIO_TypeDef;
+typedef struct { uint16_t GPIO_Pin; int GPIO_Speed; int GPIO_Mode; } GPIO_InitTypeDef;
+extern GPIO_TypeDef                     gpio_a;
+#define GPIOA                           (&gpio_a)
+#define GPIO_Pin_0                      0x0001
+#define GPIO_Pin_1                      0x0002
+#define GPIO_Pin_4                      0x0010
+#define GPIO_Speed_2MHz                 2
+#define GPIO_Mode_Out_PP                0x10
+#define RCC_APB2Periph_GPIOA            0x0004
+extern void GPIO_StructInit (GPIO_InitTypeDef *);
+extern void GPIO_Init (GPIO_TypeDef *, GPIO_InitTypeDef *);
+extern void GPIO_WriteBit (GPIO_TypeDef *, uint16_t, BitAction);
+extern void RCC_APB2PeriphClockCmd (uint32_t, FunctionalState);
+#endif
+STUB
+
+for h in stm32f10x_gpio.h stm32f10x_usart.h stm32f10x_rcc.h misc.h
+do
+    echo '#include "stm32f10x.h"' > "$TMP_DIR"/$h
+done
+
+$CC $CFLAGS -DSTM32F10X -DSTM32F103 -I"$TMP_DIR" -I"$ESP8266_DIR" -I"$SRC_DIR"/pt -I"$SRC_DIR"/timer -I"$SRC_DIR"/log -I"$SRC_DIR"/uart \
+    -o "$TMP_DIR"/esp8266-test "$ESP8266_DIR"/esp8266.c "$ESP8266_DIR"/esp8266-test.c || exit 1
+
+"$TMP_DIR"/esp8266-test
@@ -25,6 +25,8 @@
 
 #define MSEC(x)             (x/10)
 
+#define ESP8266_ANSWER_TIMEOUT_MS   100                         // max. time to wait for next character of answer
+
 /*--------------------------------------------------------------------------------------------------------------------------------------
  * globals:
  *--------------------------------------------------------------------------------------------------------------------------------------
@@ -33,6 +35,7 @@ volatile uint_fast8_t                   esp8266_ten_ms_tick;            // shoul
 
 static ESP8266_INFO                     esp8266_info;
 static char                             cmd[ESP8266_MAX_CMD_LEN];
+static char                             answer[ESP8266_MAX_ANSWER_LEN + 1];
 
 #if defined (STM32F407VG)                                               // STM32F4 Discovery Board PD12
 
@@ -195,6 +198,98 @@ esp8266_poll (uint_fast8_t * chp, uint_fast16_t ten_ms)
     return 0;
 }
 
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: store character of answer, return 1 if a non-empty answer line is complete
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+esp8266_answer_putc (uint_fast8_t ch, uint_fast16_t * lp)
+{
+    esp8266_info.is_up = 1;
+
+    if (ch == '\n')
+    {
+        answer[*lp] = '\0';
+
+        if (*lp > 0)
+        {
+            return 1;
+        }
+
+        log_flush ();                                                               // empty line
+    }
+    else if (ch == '\r')
+    {
+        ;
+    }
+    else if (*lp < ESP8266_MAX_ANSWER_LEN)
+    {
+        answer[(*lp)++] = ch;
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: parse complete answer line
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+esp8266_parse_answer (void)
+{
+    uint_fast8_t    rtc;
+
+    log_message (answer);
+
+    if (! strncmp (answer, "OK", 2))
+    {
+        rtc = ESP8266_OK;
+    }
+    else if (! strncmp (answer, "ERROR", 5))
+    {
+        rtc = ESP8266_ERROR;
+    }
+    else if (! strncmp (answer, "- ", 2))
+    {
+        rtc = ESP8266_DEBUGMSG;
+    }
+    else if (! strncmp (answer, "IPADDRESS ", 10))
+    {
+        strncpy (esp8266_info.ipaddress, answer + 10, ESP8266_MAX_IPADDRESS_SIZE - 1);
+        esp8266_info.is_online = 1;
+        rtc = ESP8266_IPADDRESS;
+    }
+    else if (! strncmp (answer, "AP ", 3))
+    {
+        strncpy (esp8266_info.accesspoint, answer + 3, ESP8266_MAX_ACCESSPOINT_SIZE - 1);
+        rtc = ESP8266_ACCESSPOINT;
+    }
+    else if (! strncmp (answer, "TIME ", 5))
+    {
+        strncpy (esp8266_info.time, answer + 5, ESP8266_MAX_TIME_SIZE - 1);
+        rtc = ESP8266_TIME;
+    }
+    else if (! strncmp (answer, "FIRMWARE ", 9))
+    {
+        strncpy (esp8266_info.firmware, answer + 9, ESP8266_MAX_FIRMWARE_SIZE - 1);
+        rtc = ESP8266_FIRMWARE;
+    }
+    else if (! strncmp (answer, "CMD ", 4))
+    {
+        strncpy (esp8266_info.cmd, answer + 4, ESP8266_MAX_CMD_SIZE - 1);
+        rtc = ESP8266_CMD;
+    }
+    else if (! strncmp (answer, "HTTP GET ", 9))
+    {
+        strncpy (esp8266_info.http_get_param, answer + 9, ESP8266_MAX_HTTP_GET_PARAM_SIZE - 1);
+        rtc = ESP8266_HTTP_GET;
+    }
+    else
+    {
+        rtc = ESP8266_UNSPECIFIED;
+    }
+    return rtc;
+}
+
 /*--------------------------------------------------------------------------------------------------------------------------------------
  * get message from ESP8266
  *--------------------------------------------------------------------------------------------------------------------------------------
@@ -202,8 +297,7 @@ esp8266_poll (uint_fast8_t * chp, uint_fast16_t ten_ms)
 uint_fast8_t
 esp8266_get_message (uint_fast16_t timeout_ten_ms)
 {
-    static char     answer[ESP8266_MAX_ANSWER_LEN + 1];
-    uint_fast8_t    l = 0;
+    uint_fast16_t   l = 0;
     uint_fast8_t    ch;
     uint_fast8_t    rtc = ESP8266_TIMEOUT;
 
@@ -221,86 +315,10 @@ esp8266_get_message (uint_fast16_t timeout_ten_ms)
                 break;
             }
 
-            esp8266_info.is_up = 1;
-
-            if (ch == '\n')
-            {
-                answer[l] = '\0';
-
-                if (l > 0)
-                {
-                    log_message (answer);
-
-                    if (! strncmp (answer, "OK", 2))
-                    {
-                        rtc = ESP8266_OK;
-                        break;
-                    }
-                    else if (! strncmp (answer, "ERROR", 5))
-                    {
-                        rtc = ESP8266_ERROR;
-                        break;
-                    }
-                    else if (! strncmp (answer, "- ", 2))
-                    {
-                        rtc = ESP8266_DEBUGMSG;
-                        break;
-                    }
-                    else if (! strncmp (answer, "IPADDRESS ", 10))
-                    {
-                        strncpy (esp8266_info.ipaddress, answer + 10, ESP8266_MAX_IPADDRESS_SIZE - 1);
-                        esp8266_info.is_online = 1;
-                        rtc = ESP8266_IPADDRESS;
-                        break;
-                    }
-                    else if (! strncmp (answer, "AP ", 3))
-                    {
-                        strncpy (esp8266_info.accesspoint, answer + 3, ESP8266_MAX_ACCESSPOINT_SIZE - 1);
-                        rtc = ESP8266_ACCESSPOINT;
-                        break;
-                    }
-                    else if (! strncmp (answer, "TIME ", 5))
-                    {
-                        strncpy (esp8266_info.time, answer + 5, ESP8266_MAX_TIME_SIZE - 1);
-                        rtc = ESP8266_TIME;
-                        break;
-                    }
-                    else if (! strncmp (answer, "FIRMWARE ", 9))
-                    {
-                        strncpy (esp8266_info.firmware, answer + 9, ESP8266_MAX_FIRMWARE_SIZE - 1);
-                        rtc = ESP8266_FIRMWARE;
-                        break;
-                    }
-                    else if (! strncmp (answer, "CMD ", 4))
-                    {
-                        strncpy (esp8266_info.cmd, answer + 4, ESP8266_MAX_CMD_SIZE - 1);
-                        rtc = ESP8266_CMD;
-                        break;
-                    }
-                    else if (! strncmp (answer, "HTTP GET ", 9))
-                    {
-                        strncpy (esp8266_info.http_get_param, answer + 9, ESP8266_MAX_HTTP_GET_PARAM_SIZE - 1);
-                        rtc = ESP8266_HTTP_GET;
-                        break;
-                    }
-                    else
-                    {
-                        rtc = ESP8266_UNSPECIFIED;
-                        break;
-                    }
-                }
-                else // l == 0
-                {
-                    log_flush ();
-                }
-            }
-            else if (ch == '\r')
-            {
-                ;
-            }
-            else if (l < ESP8266_MAX_ANSWER_LEN)
+            if (esp8266_answer_putc (ch, &l))
             {
-                answer[l++] = ch;
+                rtc = esp8266_parse_answer ();
+                break;
             }
         }
     }
@@ -308,17 +326,30 @@ esp8266_get_message (uint_fast16_t timeout_ten_ms)
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------
- * send a command to ESP8266, wait for OK or ERROR
+ * start sending a command to ESP8266 with esp8266_send_cmd_pt()
  *--------------------------------------------------------------------------------------------------------------------------------------
  */
-uint_fast8_t
-esp8266_send_cmd (char * cmd)
+void
+esp8266_send_cmd_start (ESP8266_CTX * ctx, char * cmd)
+{
+    PT_INIT(&ctx->pt);
+    ctx->cmd = cmd;
+    ctx->rtc = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * send a command to ESP8266, wait for OK or ERROR (protothread), result in ctx->rtc
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+PT_THREAD(esp8266_send_cmd_pt (ESP8266_CTX * ctx))
 {
+    char *          cmd = ctx->cmd;
     uint_fast8_t    length;
     uint_fast8_t    esp8266_rtc;
     uint_fast8_t    ch;
     uint_fast8_t    i;
-    uint_fast8_t    rtc = 0;
+
+    PT_BEGIN(&ctx->pt);
 
     length = strlen (cmd);
 
@@ -345,26 +376,58 @@ esp8266_send_cmd (char * cmd)
     esp8266_uart_puts ("\r\n");
     esp8266_uart_flush();
 
+    ctx->len = 0;
+    ctx->start = timer_ms;
+
     while (1)                                                                       // wait for OK or ERROR
-    {
-        esp8266_rtc = esp8266_get_message (MSEC(100));
+    {                                                                               // yield until next character arrives
+        PT_WAIT_UNTIL(&ctx->pt, esp8266_uart_char_available () || PT_TIMEOUT(ctx->start, ESP8266_ANSWER_TIMEOUT_MS));
 
-        if (esp8266_rtc == ESP8266_OK)
+        if (! esp8266_uart_poll (&ch))
         {
-            rtc = 1;
+            log_message ("Timeout");
             break;
         }
-        else if (esp8266_rtc == ESP8266_ERROR)
-        {
-            break;
-        }
-        else if (esp8266_rtc == ESP8266_TIMEOUT)
+
+        ctx->start = timer_ms;                                                      // timeout restarts with every character
+
+        if (esp8266_answer_putc (ch, &ctx->len))
         {
-            break;
+            esp8266_rtc = esp8266_parse_answer ();
+            ctx->len = 0;
+
+            if (esp8266_rtc == ESP8266_OK)
+            {
+                ctx->rtc = 1;
+                break;
+            }
+            else if (esp8266_rtc == ESP8266_ERROR)
+            {
+                break;
+            }
         }
     }
 
-    return rtc;
+    PT_END(&ctx->pt);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * send a command to ESP8266, blocking version of esp8266_send_cmd_pt()
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+esp8266_send_cmd (char * cmd)
+{
+    ESP8266_CTX     ctx;
+
+    esp8266_send_cmd_start (&ctx, cmd);
+
+    while (PT_SCHEDULE(esp8266_send_cmd_pt (&ctx)))
+    {
+        ;
+    }
+
+    return ctx.rtc;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------
@@ -478,19 +541,61 @@ esp8266_get_firmware_version (void)
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------
- * reset ESP8266
+ * start reset of ESP8266 with esp8266_reset_pt()
  *--------------------------------------------------------------------------------------------------------------------------------------
  */
 void
-esp8266_reset (void)
+esp8266_reset_start (ESP8266_CTX * ctx)
+{
+    PT_INIT(&ctx->pt);
+    ctx->cmd = (char *) 0;
+    ctx->rtc = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * reset ESP8266 (protothread)
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+PT_THREAD(esp8266_reset_pt (ESP8266_CTX * ctx))
 {
     uint_fast8_t    ch;
 
+    PT_BEGIN(&ctx->pt);
+
     GPIO_WriteBit(ESP8266_RST_PORT, ESP8266_RST_PIN, RESET);
-    esp8266_wait (MSEC(50));                                                // wait 50 msec
+    PT_DELAY(&ctx->pt, ctx->start, 50);                                     // wait 50 msec
     GPIO_WriteBit(ESP8266_RST_PORT, ESP8266_RST_PIN, SET);
 
-    while (esp8266_poll (&ch, MSEC(500)))                                   // eat boot message stuff
+    ctx->start = timer_ms;
+
+    while (! PT_TIMEOUT(ctx->start, 500))                                   // eat boot message stuff until 500 msec silence
+    {
+        if (esp8266_uart_poll (&ch))
+        {
+            ctx->start = timer_ms;
+        }
+        else
+        {
+            PT_YIELD(&ctx->pt);
+        }
+    }
+
+    ctx->rtc = 1;
+    PT_END(&ctx->pt);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------
+ * reset ESP8266, blocking version of esp8266_reset_pt()
+ *--------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+esp8266_reset (void)
+{
+    ESP8266_CTX     ctx;
+
+    esp8266_reset_start (&ctx);
+
+    while (PT_SCHEDULE(esp8266_reset_pt (&ctx)))
     {
         ;
     }
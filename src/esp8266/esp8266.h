@@ -15,6 +15,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
+#include "pt.h"
 
 #define ESP8266_MAX_CMD_LEN     80
 #define ESP8266_MAX_ANSWER_LEN  256                             // max length of ESP answer length, could be very long if "HTTP GET ..."
@@ -54,9 +55,20 @@ typedef struct
     char            time[ESP8266_MAX_TIME_SIZE];
 } ESP8266_INFO;
 
+typedef struct
+{
+    PT              pt;
+    char *          cmd;                                        // command to send
+    uint32_t        start;                                      // start of wait time, see timer_ms
+    uint_fast16_t   len;                                        // length of answer line received so far
+    uint_fast8_t    rtc;                                        // result: 1 = successful
+} ESP8266_CTX;
+
 extern volatile uint_fast8_t        esp8266_ten_ms_tick;
 
 extern uint_fast8_t                 esp8266_get_message (uint_fast16_t);
+extern void                         esp8266_send_cmd_start (ESP8266_CTX *, char *);
+extern uint_fast8_t                 esp8266_send_cmd_pt (ESP8266_CTX *);
 extern uint_fast8_t                 esp8266_send_cmd (char *);
 extern void                         esp8266_send_data (unsigned char *, uint_fast8_t);
 extern ESP8266_INFO *               esp8266_get_info (void);
@@ -65,6 +77,8 @@ extern uint_fast8_t                 esp8266_get_online_status (void);
 extern char *                       esp8266_get_access_point_connected (void);
 extern char *                       esp8266_get_ip_address (void);
 extern char *                       esp8266_get_firmware_version (void);
+extern void                         esp8266_reset_start (ESP8266_CTX *);
+extern uint_fast8_t                 esp8266_reset_pt (ESP8266_CTX *);
 extern void                         esp8266_reset (void);
 extern void                         esp8266_powerdown (void);
 extern void                         esp8266_powerup (void);
@@ -0,0 +1,165 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * event.c - ISR to main loop event queue
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * Ring buffer with one consumer: event_put() is called in interrupt context (TIM2_IRQHandler and the DCF77 edge ISR,
+ * see main.c and dcf77.c), event_get() only from the main loop. Producers of different priority may preempt each
+ * other, so a producer claims its slot with interrupts disabled for a few cycles. The consumer owns event_tail and
+ * never disables interrupts.
+ *
+ * If the queue is full, the new event is dropped and counted in event_overflows[type]. Nobody reads the queue while
+ * booting, so events are dropped silently until event_start() is called.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include <string.h>
+#include "event.h"
+#include "timer.h"
+
+#define EVENT_QUEUE_MASK                (EVENT_QUEUE_SIZE - 1)
+
+volatile uint32_t                       event_overflows[EVENT_TYPES];       // number of lost events per type
+volatile uint_fast8_t                   event_high_water;                   // max. number of queued events
+
+static EVENT                            event_queue[EVENT_QUEUE_SIZE];
+static volatile uint_fast8_t            event_head;                         // next slot to write, owned by producer
+static volatile uint_fast8_t            event_tail;                         // next slot to read, owned by consumer
+static volatile uint_fast8_t            event_started;                      // flag: main loop reads the queue
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * put event with own timestamp into queue, call it only in interrupt context
+ *
+ * Return values:
+ *  0   Failed, queue full or not started yet
+ *  1   Successful
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+event_put_timestamp (uint_fast8_t type, uint_fast8_t data, uint32_t timestamp)
+{
+    uint32_t        primask;
+    uint_fast8_t    head;
+    uint_fast8_t    depth;
+    uint_fast8_t    rtc = 0;
+
+    if (! event_started)
+    {
+        return 0;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();                                                        // another ISR may put an event too
+
+    head    = event_head;
+    depth   = (head - event_tail) & EVENT_QUEUE_MASK;
+
+    if (depth == EVENT_QUEUE_MASK)                                          // one slot is always kept free
+    {
+        if (type < EVENT_TYPES)
+        {
+            event_overflows[type]++;
+        }
+    }
+    else
+    {
+        event_queue[head].timestamp = timestamp;
+        event_queue[head].type      = type;
+        event_queue[head].data      = data;
+
+        __DMB();                                                            // event must be written before head is published
+        event_head = (head + 1) & EVENT_QUEUE_MASK;
+
+        if (depth + 1 > event_high_water)
+        {
+            event_high_water = depth + 1;
+        }
+
+        rtc = 1;
+    }
+
+    __set_PRIMASK(primask);
+    return rtc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * put event into queue, call it only in interrupt context
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+event_put (uint_fast8_t type, uint_fast8_t data)
+{
+    return event_put_timestamp (type, data, timer_ms);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get next event from queue, call it only in main loop
+ *
+ * Return values:
+ *  0   queue empty
+ *  1   got event
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+event_get (EVENT * eventp)
+{
+    uint_fast8_t    tail = event_tail;
+
+    if (tail == event_head)
+    {
+        return 0;
+    }
+
+    __DMB();                                                                // read event after head has been read
+    *eventp = event_queue[tail];
+
+    __DMB();                                                                // event must be read before slot is released
+    event_tail = (tail + 1) & EVENT_QUEUE_MASK;
+
+    return 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get number of queued events
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+event_depth (void)
+{
+    return (event_head - event_tail) & EVENT_QUEUE_MASK;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * start queueing events, call it just before the main loop
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+event_start (void)
+{
+    event_started = 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * initialize event queue
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+event_init (void)
+{
+    static uint_fast8_t already_called;
+
+    if (! already_called)
+    {
+        already_called = 1;
+
+        memset ((void *) event_overflows, 0, sizeof (event_overflows));
+        event_high_water    = 0;
+        event_head          = 0;
+        event_tail          = 0;
+        event_started       = 0;
+    }
+}
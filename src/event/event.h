@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * event.h - declarations of ISR to main loop event queue
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef EVENT_H
+#define EVENT_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+#define EVENT_QUEUE_SIZE                32                                  // must be a power of 2
+
+#define EVENT_NONE                      0                                   // no event
+#define EVENT_ANIMATION                 1                                   // animate LEDs
+#define EVENT_DCF77                     2                                   // decode DCF77 edges, check timeouts
+#define EVENT_LDR                       3                                   // start LDR conversion
+#define EVENT_RTC                       4                                   // read date/time from RTC
+#define EVENT_NET_TIME                  5                                   // read date/time from time server
+#define EVENT_MINUTE                    6                                   // soft clock: new minute
+#define EVENT_DCF77_EDGE                7                                   // DCF77 edge: data = level after edge
+#define EVENT_TYPES                     8                                   // number of event types
+
+typedef struct
+{
+    uint32_t                            timestamp;                          // time of event in ms, see timer_ms, EVENT_DCF77_EDGE: time of edge, see dcf77.c
+    uint8_t                             type;                               // EVENT_xxx
+    uint8_t                             data;                               // optional event data
+} EVENT;
+
+extern volatile uint32_t                event_overflows[EVENT_TYPES];       // number of lost events per type
+extern volatile uint_fast8_t            event_high_water;                   // max. number of queued events
+
+extern uint_fast8_t                     event_put_timestamp (uint_fast8_t, uint_fast8_t, uint32_t);
+extern uint_fast8_t                     event_put (uint_fast8_t, uint_fast8_t);
+extern void                             event_start (void);
+extern uint_fast8_t                     event_get (EVENT *);
+extern uint_fast8_t                     event_depth (void);
+extern void                             event_init (void);
+
+#endif
@@ -18,6 +18,7 @@
 #include "esp8266.h"
 #include "timeserver.h"
 #include "ldr.h"
+#include "adc.h"
 #include "remote-ir.h"
 #include "display.h"
 #include "tempsensor.h"
@@ -27,6 +28,11 @@
 #include "rtc.h"
 #include "listener.h"
 #include "night.h"
+#include "event.h"
+#include "sched.h"
+#include "softclock.h"
+#include "timesource.h"
+#include "dcf77.h"
 #include "log.h"
 #include "delay.h"
 #include "http.h"
@@ -65,6 +71,8 @@ static int                          bgcolor_cnt;
 #define NETWORK_HEADER_COLS         3
 #define DISPLAY_HEADER_COLS         3
 #define TIMERS_HEADER_COLS          8
+#define STATUS_HEADER_COLS          7
+#define TIMESOURCE_HEADER_COLS      7
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * flush output buffer
@@ -724,6 +732,74 @@ http_menu (void)
     menu_entry ("network", "Network");
     menu_entry ("display", "Display");
     menu_entry ("timers", "Timers");
+    menu_entry ("status", "Status");
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * count good DCF77 frames of the last 64 minutes
+ *
+ * framesp:     number of frames in history, 64 or less after boot
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+http_dcf77_good_frames (const DCF77_STATS * stats, uint_fast8_t * framesp)
+{
+    uint64_t        history = stats->frame_history;
+    uint32_t        frames  = stats->good_frames + stats->bad_frames;
+    uint_fast8_t    good    = 0;
+
+    *framesp = frames < 64 ? frames : 64;
+
+    while (history)
+    {
+        good += history & 0x01;
+        history >>= 1;
+    }
+
+    return good;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * table rows of DS18xx sensors: ROM code (family-serial number) and cached temperature, see temp_poll()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+http_ds18xx_rows (void)
+{
+    const DS18XX_SENSOR *   sensor;
+    char                    name[32];
+    char                    temp[16];
+    uint_fast8_t            n_sensors;
+    uint_fast8_t            temp_index;
+    uint_fast8_t            idx;
+
+    n_sensors = ds18xx_is_up ? ds18xx_get_n_sensors () : 0;
+
+    if (n_sensors == 0)
+    {
+        table_row ("DS18xx", "offline", "");
+        return;
+    }
+
+    for (idx = 0; idx < n_sensors; idx++)
+    {
+        sensor = ds18xx_get_sensor (idx);
+        sprintf (name, "DS18xx %02X-%02X%02X%02X%02X%02X%02X", sensor->rom_code[0], sensor->rom_code[6], sensor->rom_code[5],
+                 sensor->rom_code[4], sensor->rom_code[3], sensor->rom_code[2], sensor->rom_code[1]);
+
+        temp_index = temp_get_temp_index (idx);
+
+        if (temp_index != TEMP_INVALID)
+        {
+            sprintf (temp, "%d%s&deg;C", temp_index / 2, (temp_index % 2) ? ".5" : "");
+        }
+        else
+        {
+            strcpy (temp, "error");
+        }
+
+        table_row (name, temp, "");
+    }
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
@@ -738,8 +814,29 @@ http_main (LISTENER_DATA * ld)
     char *          message         = (char *) 0;
     uint_fast8_t    rtc             = 0;
     char            rtc_temp[16];
-    char            ds18xx_temp[16];
+    char            event_queue[16];
+    char            missed_animation[16];
+    char            missed_dcf77[16];
+    char            dcf77_reception[40];
+    char            dcf77_last_sync[24];
+    char            dcf77_parity[48];
+    char            dcf77_histogram[DCF77_HISTOGRAM_BINS * 6 + 1];
+    const DCF77_STATS * dcf77_stats;
+    uint_fast8_t    dcf77_frames;
+    char            cpu_idle[16];
+    char            date_time[24];
+    char            clock_drift[24];
+    struct tm       tm;
+    long            drift;
     uint_fast8_t    temp_index;
+    uint_fast8_t    bin;
+
+    softclock_get_tm (&tm);
+    sprintf (date_time, "%s %4d-%02d-%02d %02d:%02d:%02d", wdays_en[tm.tm_wday], tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+    drift = softclock_get_drift ();
+    sprintf (clock_drift, "%s%ld.%03ld ppm", drift < 0 ? "-" : "", labs (drift) / 1000, labs (drift) % 1000);
 
     if (rtc_is_up)
     {
@@ -758,23 +855,36 @@ http_main (LISTENER_DATA * ld)
         strcpy (rtc_temp, "offline");
     }
 
-    if (ds18xx_is_up)
-    {
-        temp_index = temp_read_temp_index ();
-        sprintf (ds18xx_temp, "%d", temp_index / 2);
 
-        if (temp_index % 2)
-        {
-            strcat (ds18xx_temp, ".5");
-        }
+    sprintf (event_queue, "%d / %d", event_high_water, EVENT_QUEUE_SIZE - 1);
+    sprintf (missed_animation, "%lu", (unsigned long) event_overflows[EVENT_ANIMATION]);
+    sprintf (missed_dcf77, "%lu", (unsigned long) event_overflows[EVENT_DCF77_EDGE]);
+
+    dcf77_stats = dcf77_get_stats ();
+    sprintf (dcf77_reception, "%d/%d frames good, confidence %u", http_dcf77_good_frames (dcf77_stats, &dcf77_frames), dcf77_frames,
+             (unsigned int) dcf77_get_confidence ());
 
-        strcat (ds18xx_temp, "&deg;C");
+    if (dcf77_stats->good_frames)
+    {
+        sprintf (dcf77_last_sync, "%lu s ago", (unsigned long) (softclock_get_uptime () - dcf77_stats->last_sync));
     }
     else
     {
-        strcpy (ds18xx_temp, "offline");
+        strcpy (dcf77_last_sync, "never");
+    }
+
+    snprintf (dcf77_parity, sizeof (dcf77_parity), "P1: %lu, P2: %lu, P3: %lu", (unsigned long) dcf77_stats->parity_errors[DCF77_PARITY_P1],
+              (unsigned long) dcf77_stats->parity_errors[DCF77_PARITY_P2], (unsigned long) dcf77_stats->parity_errors[DCF77_PARITY_P3]);
+
+    *dcf77_histogram = '\0';
+
+    for (bin = 0; bin < DCF77_HISTOGRAM_BINS; bin++)
+    {
+        sprintf (dcf77_histogram + strlen (dcf77_histogram), "%s%u", bin ? " " : "", (unsigned int) dcf77_stats->histogram[bin]);
     }
 
+    sprintf (cpu_idle, "%d.%d%%", sched_idle_permille / 10, sched_idle_permille % 10);
+
     action = http_get_param ("action");
 
     if (action)
@@ -807,9 +917,22 @@ http_main (LISTENER_DATA * ld)
     http_menu ();
     table_header (header_cols, MAIN_HEADER_COLS);
 
+    table_row ("Date/Time", date_time, "");
+    table_row ("Clock drift", clock_drift, "");
+    table_row ("Second tick", softclock_sqw_is_active () ? "DS3231 SQW" : "TIM2", "");
+    table_row ("RTC", rtc_is_up ? "online" : "offline", "");
     table_row ("RTC temperature", rtc_temp, "");
-    table_row ("DS18xx", ds18xx_temp, "");
+    http_ds18xx_rows ();
     table_row ("EEPROM", eeprom_is_up ? "online" : "offline", "");
+    table_row ("Event queue max. depth", event_queue, "");
+    table_row ("Missed animation frames", missed_animation, "");
+    table_row ("Lost DCF77 edges", missed_dcf77, "");
+    table_row ("DCF77 reception", dcf77_reception, "");
+    table_row ("DCF77 last sync", dcf77_last_sync, "");
+    table_row ("DCF77 parity errors", dcf77_parity, "");
+    table_row ("DCF77 pulses (25 ms steps)", dcf77_histogram, "");
+    table_row ("CPU idle", cpu_idle, "");
+
     table_trailer ();
 
     http_send ("<form method=\"GET\" action=\"/\">\r\n");
@@ -979,7 +1102,6 @@ http_display (LISTENER_DATA * ld)
     char                blue_buf[MAX_COLOR_VALUE_LEN + 1];
     int                 animation_mode;
     int                 display_mode;
-    uint_fast8_t        ldr_value;
     char                ldr_buf[MAX_BRIGHTNESS_LEN + 1];
     uint_fast8_t        i;
     uint_fast8_t        rtc             = 0;
@@ -1071,30 +1193,13 @@ http_display (LISTENER_DATA * ld)
         }
     }
 
-    *ldr_buf = '\0';
-
-    uint_fast8_t cnt = 0;
-
-    ldr_start_conversion ();
-
-    while (! ldr_poll_brightness (&ldr_value))
+    if (adc_is_up)
     {
-        delay_msec (10);
-        cnt++;
-
-        if (cnt >= 10)
-        {
-            break;
-        }
-    }
-
-    if (cnt >= 10)
-    {
-        strcpy (ldr_buf, "?");
+        sprintf (ldr_buf, "%d", ldr_get_brightness ());                    // filtered, see ldr_task() in main.c
     }
     else
     {
-        sprintf (ldr_buf, "%d", ldr_value);
+        strcpy (ldr_buf, "?");
     }
 
     sprintf (brbuf,     "%d", brightness);
@@ -1264,6 +1369,163 @@ http_timers (void)
     return rtc;
 }
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * status page: task statistics of scheduler and statistics of time sources
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+http_status (void)
+{
+    char *              header_cols[STATUS_HEADER_COLS] = { "Task", "Prio", "Deadline ms", "Calls", "Avg us", "Max us", "Misses" };
+    char *              ts_header_cols[TIMESOURCE_HEADER_COLS] = { "Source", "Accuracy ms", "Reports", "Rejected", "Corrections", "Offset ms", "Age s" };
+    const SCHED_TASK *  t;
+    const TIMESOURCE *  ts;
+    uint64_t            now;
+    char                buf[16];
+    uint32_t            avg_cycles;
+    uint_fast8_t        idx;
+    int                 rtc = 0;
+
+    http_header ("WordClock Status");
+    http_menu ();
+    table_header (header_cols, STATUS_HEADER_COLS);
+
+    for (idx = 0; idx < sched_get_n_tasks (); idx++)
+    {
+        t = sched_get_task (idx);
+        avg_cycles = t->calls ? (uint32_t) (t->total_cycles / t->calls) : 0;
+
+        begin_table_row ();
+        text_column ((char *) t->name);
+        sprintf (buf, "%d", t->priority);
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) t->deadline);
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) t->calls);
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) sched_cycles_to_usec (avg_cycles));
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) sched_cycles_to_usec (t->max_cycles));
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) t->deadline_misses);
+        text_column (buf);
+        end_table_row ();
+    }
+
+    table_trailer ();
+
+    table_header (ts_header_cols, TIMESOURCE_HEADER_COLS);
+    now = softclock_get_ms64 ();
+
+    for (idx = 0; idx < TIMESOURCE_COUNT; idx++)
+    {
+        ts = timesource_get (idx);
+
+        begin_table_row ();
+        text_column ((char *) ts->name);
+        sprintf (buf, "%u", ts->accuracy_ms);
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) ts->reports);
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) ts->rejected);
+        text_column (buf);
+        sprintf (buf, "%lu", (unsigned long) ts->corrections);
+        text_column (buf);
+
+        if (ts->reports)
+        {
+            sprintf (buf, "%ld", (long) ts->last_offset);
+            text_column (buf);
+            sprintf (buf, "%lu", (unsigned long) ((now - ts->last_report_ms) / 1000));
+            text_column (buf);
+        }
+        else
+        {
+            text_column ("-");
+            text_column ("-");
+        }
+
+        end_table_row ();
+    }
+
+    begin_table_row ();
+    text_column ("Soft clock");
+    sprintf (buf, "%lu", (unsigned long) timesource_get_error_ms ());
+    text_column (buf);
+    text_column ("");
+    text_column ("");
+    text_column ("");
+    text_column ("");
+    text_column ("");
+    end_table_row ();
+
+    table_trailer ();
+
+    http_trailer ();
+    http_flush ();
+
+    return rtc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * DCF77 statistics, machine readable (JSON)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+http_dcf77 (void)
+{
+    const DCF77_STATS * stats = dcf77_get_stats ();
+    char                buf[96];
+    uint_fast8_t        frames;
+    uint_fast8_t        good;
+    uint_fast8_t        idx;
+
+    good = http_dcf77_good_frames (stats, &frames);
+
+    http_send ("HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n\r\n");
+
+    snprintf (buf, sizeof (buf), "{\"uptime\":%lu,", (unsigned long) softclock_get_uptime ());
+    http_send (buf);
+
+    if (stats->good_frames)
+    {
+        snprintf (buf, sizeof (buf), "\"last_sync_age\":%lu,", (unsigned long) (softclock_get_uptime () - stats->last_sync));
+    }
+    else
+    {
+        snprintf (buf, sizeof (buf), "\"last_sync_age\":null,");
+    }
+    http_send (buf);
+
+    snprintf (buf, sizeof (buf), "\"confidence\":%u,", (unsigned int) dcf77_get_confidence ());
+    http_send (buf);
+    snprintf (buf, sizeof (buf), "\"good_frames\":%lu,\"bad_frames\":%lu,",
+              (unsigned long) stats->good_frames, (unsigned long) stats->bad_frames);
+    http_send (buf);
+    snprintf (buf, sizeof (buf), "\"history\":\"%08lx%08lx\",\"history_good\":%d,\"history_frames\":%d,",
+              (unsigned long) (stats->frame_history >> 32), (unsigned long) (stats->frame_history & 0xFFFFFFFF), good, frames);
+    http_send (buf);
+    snprintf (buf, sizeof (buf), "\"parity_errors\":[%lu,%lu,%lu],", (unsigned long) stats->parity_errors[DCF77_PARITY_P1],
+              (unsigned long) stats->parity_errors[DCF77_PARITY_P2], (unsigned long) stats->parity_errors[DCF77_PARITY_P3]);
+    http_send (buf);
+    snprintf (buf, sizeof (buf), "\"glitches\":%lu,\"sync_losses\":%lu,",
+              (unsigned long) stats->glitches, (unsigned long) stats->sync_losses);
+    http_send (buf);
+    snprintf (buf, sizeof (buf), "\"histogram_bin_ms\":%d,\"histogram\":[", DCF77_HISTOGRAM_BIN_MS);
+    http_send (buf);
+
+    for (idx = 0; idx < DCF77_HISTOGRAM_BINS; idx++)
+    {
+        snprintf (buf, sizeof (buf), "%s%u", idx ? "," : "", (unsigned int) stats->histogram[idx]);
+        http_send (buf);
+    }
+
+    http_send ("]}\r\n");
+    http_flush ();
+
+    return 0;
+}
+
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * http server
  *-------------------------------------------------------------------------------------------------------------------------------------------
@@ -1326,6 +1588,14 @@ http_server (char * path, char * param, LISTENER_DATA * ld)
     {
         rtc = http_timers ();
     }
+    else if (! strcmp (path, "/status"))
+    {
+        rtc = http_status ();
+    }
+    else if (! strcmp (path, "/dcf77"))
+    {
+        rtc = http_dcf77 ();
+    }
     else
     {
         char * p = "HTTP/1.0 404 Not Found";
@@ -232,7 +232,11 @@ i2c_init (void)
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * read one or more bytes
+ * read n_chunks * chunk_size bytes in one sequential transfer
+ *
+ * Every chunk is read into data, then chunk_func (ctx, data, index of chunk) is called, e.g. to parse records of an
+ * EEPROM without a buffer for all of them. Meanwhile the I2C peripheral stretches the clock. chunk_func may be NULL
+ * if n_chunks is 1.
  *
  * return values:
  * ==  0 OK
@@ -240,12 +244,14 @@ i2c_init (void)
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 int_fast16_t
-i2c_read (uint_fast8_t slave_addr, uint_fast16_t addr, uint_fast8_t is_16_bit_addr, uint8_t * data, uint_fast16_t cnt)
+i2c_read_chunks (uint_fast8_t slave_addr, uint_fast16_t addr, uint_fast8_t is_16_bit_addr, uint8_t * data, uint_fast16_t chunk_size,
+                 uint_fast16_t n_chunks, void (*chunk_func)(void *, uint8_t *, uint_fast16_t), void * ctx)
 {
+    uint_fast16_t   chunk;
     uint_fast16_t   n;
     int_fast16_t    rtc;
 
-    if ((rtc = i2c_send_address (slave_addr, addr, is_16_bit_addr, cnt == 1 ? 1 : 0)) != I2C_OK)
+    if ((rtc = i2c_send_address (slave_addr, addr, is_16_bit_addr, (chunk_size == 1 && n_chunks == 1) ? 1 : 0)) != I2C_OK)
     {
         return rtc;
     }
@@ -271,26 +277,48 @@ i2c_read (uint_fast8_t slave_addr, uint_fast16_t addr, uint_fast8_t is_16_bit_ad
 
     I2C_CHANNEL->SR2;                                                              // clear ADDR flag
 
-    for (n = 0; n < cnt; n++)                                               // read all data
+    for (chunk = 0; chunk < n_chunks; chunk++)
     {
-        if (n + 1 == cnt)
+        for (n = 0; n < chunk_size; n++)                                    // read all data of chunk
         {
-            I2C_AcknowledgeConfig(I2C_CHANNEL, DISABLE);                           // ACK disable
-            I2C_GenerateSTOP(I2C_CHANNEL, ENABLE);                                 // stop sequence
+            if (chunk + 1 == n_chunks && n + 1 == chunk_size)
+            {
+                I2C_AcknowledgeConfig(I2C_CHANNEL, DISABLE);                       // ACK disable
+                I2C_GenerateSTOP(I2C_CHANNEL, ENABLE);                             // stop sequence
+            }
+
+            if (! i2c_wait_for_flags (I2C_FLAG_RXNE, 0))
+            {
+                return I2C_ERROR_NO_FLAG_RXNE;
+            }
+
+            data[n] = I2C_ReceiveData(I2C_CHANNEL);                                // read data
         }
 
-        if (! i2c_wait_for_flags (I2C_FLAG_RXNE, 0))
+        if (chunk_func)
         {
-            return I2C_ERROR_NO_FLAG_RXNE;
+            (*chunk_func) (ctx, data, chunk);
         }
-
-        data[n] = I2C_ReceiveData(I2C_CHANNEL);                                    // read data
     }
 
     I2C_AcknowledgeConfig(I2C_CHANNEL, ENABLE);                                    // ACK enable
     return I2C_OK;
 }
 
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * read one or more bytes
+ *
+ * return values:
+ * ==  0 OK
+ *  <  0 Error
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+int_fast16_t
+i2c_read (uint_fast8_t slave_addr, uint_fast16_t addr, uint_fast8_t is_16_bit_addr, uint8_t * data, uint_fast16_t cnt)
+{
+    return i2c_read_chunks (slave_addr, addr, is_16_bit_addr, data, cnt, 1, 0, 0);
+}
+
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * write one or more bytes
@@ -333,3 +361,66 @@ i2c_write (uint_fast8_t slave_addr, uint_fast16_t addr, uint_fast8_t is_16_bit_a
 
     return I2C_OK;
 }
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * poll slave: send address only, e.g. an EEPROM does not acknowledge its address during a write cycle
+ *
+ * return values:
+ * ==  0 I2C_OK, slave acknowledged
+ *  <  0 Error, I2C_ERROR_NACK: slave did not acknowledge
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+int_fast16_t
+i2c_poll (uint_fast8_t slave_addr)
+{
+    uint32_t  timeout = I2C_TIMEOUT;
+
+    while (I2C_GetFlagStatus(I2C_CHANNEL, I2C_FLAG_BUSY))                          // wait for stop of last transfer
+    {
+        if (timeout > 0)
+        {
+            timeout--;
+        }
+        else
+        {
+            i2c_handle_timeout ();
+            return I2C_ERROR_NO_FLAG_SB;
+        }
+    }
+
+    I2C_GenerateSTART(I2C_CHANNEL, ENABLE);
+
+    if (! i2c_wait_for_flags (I2C_FLAG_SB, 0))
+    {
+        return I2C_ERROR_NO_FLAG_SB;
+    }
+
+    I2C_Send7bitAddress(I2C_CHANNEL, slave_addr, I2C_Direction_Transmitter);        // send slave address (transmitter)
+
+    timeout = I2C_TIMEOUT;
+
+    while (! I2C_GetFlagStatus(I2C_CHANNEL, I2C_FLAG_ADDR))
+    {
+        if (I2C_GetFlagStatus(I2C_CHANNEL, I2C_FLAG_AF))                           // no acknowledge
+        {
+            I2C_ClearFlag(I2C_CHANNEL, I2C_FLAG_AF);
+            I2C_GenerateSTOP(I2C_CHANNEL, ENABLE);                                 // stop sequence
+            return I2C_ERROR_NACK;
+        }
+
+        if (timeout > 0)
+        {
+            timeout--;
+        }
+        else
+        {
+            i2c_handle_timeout ();
+            return I2C_ERROR_NO_FLAG_ADDR;
+        }
+    }
+
+    I2C_CHANNEL->SR2;                                                              // clear ADDR flag
+    I2C_GenerateSTOP(I2C_CHANNEL, ENABLE);                                         // stop sequence
+
+    return I2C_OK;
+}
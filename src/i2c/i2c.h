@@ -31,7 +31,11 @@
 #define I2C_ERROR_NO_FLAG_SB2   (-5)
 #define I2C_ERROR_NO_FLAG_ADDR2 (-6)
 #define I2C_ERROR_NO_FLAG_RXNE  (-7)
+#define I2C_ERROR_NACK          (-8)
 
 void            i2c_init  (void);
+int_fast16_t    i2c_read_chunks (uint_fast8_t, uint_fast16_t, uint_fast8_t, uint8_t *, uint_fast16_t, uint_fast16_t,
+                                 void (*)(void *, uint8_t *, uint_fast16_t), void *);
 int_fast16_t    i2c_read  (uint_fast8_t, uint_fast16_t, uint_fast8_t, uint8_t *, uint_fast16_t);
 int_fast16_t    i2c_write (uint_fast8_t, uint_fast16_t, uint_fast8_t, uint8_t *, uint_fast16_t);
+int_fast16_t    i2c_poll  (uint_fast8_t);
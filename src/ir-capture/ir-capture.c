@@ -0,0 +1,231 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * ir-capture.c - IR edge capture for IRMP
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * IRMP samples the IR receiver F_INTERRUPTS times per second, even if there is no IR signal at all. Here, every edge of
+ * the IR receiver triggers an EXTI interrupt, which stores the edge with a timestamp of a free running timer in a ring:
+ *
+ *  - STM32F4x1: IR=PC10, EXTI10, shares EXTI15_10_IRQHandler with DCF77 (see main.c), timestamps by TIM4
+ *  - STM32F103: IR=PB3,  EXTI3, timestamps by TIM3
+ *
+ * The timer counts with F_INTERRUPTS, so one tick is one IRMP sample. ir_capture_isr_tick() is called every 1/1000 of
+ * a second by TIM2 and feeds irmp_ISR() with the level of every tick since the last call, see IRMP_USE_EXT_INPUT in
+ * irmpconfig.h. So IRMP sees the same samples as before and all protocols and repetition checks work unchanged.
+ *
+ * If the IR receiver is dark for IR_CAPTURE_IDLE_MS, no frame is in flight and irmp_ISR() is not called anymore until
+ * the next edge. The timestamps are 16 bit: 65536 ticks are 4.3 seconds at 15 kHz.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include "wclock24h-config.h"
+#include "irmp.h"
+#include "ir-capture.h"
+
+#if SAVE_RAM == 0
+
+#if defined (STM32F401RE) || defined (STM32F411RE)        // STM32F401 / STM32F411 Nucleo Board: IR=PC10
+
+#  define IR_CAPTURE_EXTI_PORT_SOURCE   EXTI_PortSourceGPIOC
+#  define IR_CAPTURE_EXTI_PIN_SOURCE    EXTI_PinSource10
+#  define IR_CAPTURE_EXTI_LINE          EXTI_Line10
+#  define IR_CAPTURE_IRQ_CHANNEL        EXTI15_10_IRQn
+#  define IR_CAPTURE_IRQ_HANDLER        ir_capture_exti_isr     // EXTI15_10_IRQHandler is shared with DCF77, see main.c
+
+#  define IR_CAPTURE_TIM_CLOCK_CMD      RCC_APB1PeriphClockCmd
+#  define IR_CAPTURE_TIM_CLOCK          RCC_APB1Periph_TIM4
+#  define IR_CAPTURE_TIM                TIM4
+#  define IR_CAPTURE_TIM_CLK            84000000L               // timer clock, 84MHz on STM32F401/411 Nucleo Board
+
+#elif defined (STM32F103)                                   // STM32F103 Mini Development Board: IR=PB3
+
+#  define IR_CAPTURE_EXTI_PORT_SOURCE   GPIO_PortSourceGPIOB
+#  define IR_CAPTURE_EXTI_PIN_SOURCE    GPIO_PinSource3
+#  define IR_CAPTURE_EXTI_LINE          EXTI_Line3
+#  define IR_CAPTURE_IRQ_CHANNEL        EXTI3_IRQn
+#  define IR_CAPTURE_IRQ_HANDLER        EXTI3_IRQHandler
+
+#  define IR_CAPTURE_TIM_CLOCK_CMD      RCC_APB1PeriphClockCmd
+#  define IR_CAPTURE_TIM_CLOCK          RCC_APB1Periph_TIM3
+#  define IR_CAPTURE_TIM                TIM3
+#  define IR_CAPTURE_TIM_CLK            72000000L               // timer clock, 72MHz on STM32F103
+
+#else
+#  error STM32 unknown
+#endif
+
+#define IR_CAPTURE_TIM_PRESCALER        (IR_CAPTURE_TIM_CLK / F_INTERRUPTS - 1)     // one tick per IRMP sample
+
+#define IR_CAPTURE_RING_SIZE            64                      // must be power of 2, one NEC frame has 68 edges
+#define IR_CAPTURE_RING_MASK            (IR_CAPTURE_RING_SIZE - 1)
+
+#define IR_CAPTURE_IDLE_MS              200                     // IRMP needs 150 ms darkness, see IRMP_KEY_REPETITION_LEN
+#define IR_CAPTURE_IDLE_TICKS           ((uint16_t) (F_INTERRUPTS * IR_CAPTURE_IDLE_MS / 1000))
+
+typedef struct
+{
+    uint16_t                            ticks;                  // timestamp of edge
+    uint8_t                             level;                  // level after edge, 0 = IR burst
+} IR_CAPTURE_EDGE;
+
+static volatile IR_CAPTURE_EDGE         ir_edges[IR_CAPTURE_RING_SIZE];
+static volatile uint_fast8_t            ir_edge_head;           // written by ISR only
+static volatile uint_fast8_t            ir_edge_overrun;        // flag: ring was full, edges lost
+static uint_fast8_t                     ir_edge_tail;           // written by ir_capture_isr_tick() only
+
+static uint16_t                         replay_ticks;           // irmp_ISR() got all samples up to this tick
+static uint16_t                         last_edge_ticks;        // timestamp of last edge
+static uint_fast8_t                     ir_idle = 1;            // flag: no frame in flight, irmp_ISR() not called
+
+uint_fast8_t                            irmp_ext_input = 1;     // level of IR receiver, read by irmp_ISR()
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * EXTI IRQ handler: timestamp IR edges
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+IR_CAPTURE_IRQ_HANDLER (void)
+{
+    uint16_t        ticks = TIM_GetCounter (IR_CAPTURE_TIM);
+    uint_fast8_t    next;
+
+    if (EXTI_GetITStatus (IR_CAPTURE_EXTI_LINE) != RESET)
+    {
+        EXTI_ClearITPendingBit (IR_CAPTURE_EXTI_LINE);
+
+        next = (ir_edge_head + 1) & IR_CAPTURE_RING_MASK;
+
+        if (next == ir_edge_tail)
+        {
+            ir_edge_overrun = 1;
+        }
+        else
+        {
+            ir_edges[ir_edge_head].ticks = ticks;
+            ir_edges[ir_edge_head].level = GPIO_ReadInputDataBit (IRMP_PORT, IRMP_BIT) == Bit_RESET ? 0 : 1;
+            ir_edge_head = next;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: feed irmp_ISR() with current level up to ticks
+ *
+ * Longer levels are cut to IR_CAPTURE_IDLE_TICKS samples, IRMP does not distinguish them, e.g. after short_isr in main.c.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+ir_capture_replay (uint16_t ticks)
+{
+    int16_t     n = (int16_t) (ticks - replay_ticks);
+
+    if (n > 0)                                                  // edge may be newer than ticks read by caller
+    {
+        if (n > IR_CAPTURE_IDLE_TICKS)
+        {
+            n = IR_CAPTURE_IDLE_TICKS;
+        }
+
+        while (n--)
+        {
+            (void) irmp_ISR ();
+        }
+
+        replay_ticks = ticks;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * IR capture tick - feed IRMP with stored edges, called every 1/1000 of a second (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+ir_capture_isr_tick (void)
+{
+    uint16_t    now = TIM_GetCounter (IR_CAPTURE_TIM);
+
+    if (ir_edge_overrun)                                        // edges lost: let IRMP time out with darkness
+    {
+        ir_edge_tail    = ir_edge_head;
+        ir_edge_overrun = 0;
+        irmp_ext_input  = 1;
+        replay_ticks    = now;
+        last_edge_ticks = now;
+        ir_idle         = 0;
+    }
+
+    while (ir_edge_tail != ir_edge_head)
+    {
+        if (ir_idle)                                            // IRMP has seen enough darkness, skip the rest
+        {
+            replay_ticks    = ir_edges[ir_edge_tail].ticks;
+            ir_idle         = 0;
+        }
+        else
+        {
+            ir_capture_replay (ir_edges[ir_edge_tail].ticks);
+        }
+
+        irmp_ext_input  = ir_edges[ir_edge_tail].level;
+        last_edge_ticks = ir_edges[ir_edge_tail].ticks;
+        ir_edge_tail    = (ir_edge_tail + 1) & IR_CAPTURE_RING_MASK;
+    }
+
+    if (! ir_idle)
+    {
+        ir_capture_replay (now);
+
+        if (irmp_ext_input && (uint16_t) (now - last_edge_ticks) >= IR_CAPTURE_IDLE_TICKS)
+        {
+            ir_idle = 1;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * initialize timestamp timer and EXTI of IR pin, IR pin must be initialized by irmp_init() before
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+ir_capture_init (void)
+{
+    TIM_TimeBaseInitTypeDef     tim;
+    EXTI_InitTypeDef            exti;
+    NVIC_InitTypeDef            nvic;
+
+    TIM_TimeBaseStructInit (&tim);
+    IR_CAPTURE_TIM_CLOCK_CMD (IR_CAPTURE_TIM_CLOCK, ENABLE);
+
+    tim.TIM_ClockDivision   = TIM_CKD_DIV1;
+    tim.TIM_CounterMode     = TIM_CounterMode_Up;
+    tim.TIM_Period          = 0xFFFF;                                   // free running
+    tim.TIM_Prescaler       = IR_CAPTURE_TIM_PRESCALER;
+    TIM_TimeBaseInit (IR_CAPTURE_TIM, &tim);
+    TIM_Cmd (IR_CAPTURE_TIM, ENABLE);
+
+#if defined (STM32F10X)
+    GPIO_EXTILineConfig (IR_CAPTURE_EXTI_PORT_SOURCE, IR_CAPTURE_EXTI_PIN_SOURCE);
+#elif defined (STM32F4XX)
+    RCC_APB2PeriphClockCmd (RCC_APB2Periph_SYSCFG, ENABLE);
+    SYSCFG_EXTILineConfig (IR_CAPTURE_EXTI_PORT_SOURCE, IR_CAPTURE_EXTI_PIN_SOURCE);
+#endif
+
+    EXTI_StructInit (&exti);
+    exti.EXTI_Line          = IR_CAPTURE_EXTI_LINE;
+    exti.EXTI_Mode          = EXTI_Mode_Interrupt;
+    exti.EXTI_Trigger       = EXTI_Trigger_Rising_Falling;
+    exti.EXTI_LineCmd       = ENABLE;
+    EXTI_Init (&exti);
+
+    nvic.NVIC_IRQChannel                    = IR_CAPTURE_IRQ_CHANNEL;
+    nvic.NVIC_IRQChannelCmd                 = ENABLE;
+    nvic.NVIC_IRQChannelPreemptionPriority  = 0x00;                     // short ISR, highest priority like DCF77
+    nvic.NVIC_IRQChannelSubPriority         = 0x00;
+    NVIC_Init (&nvic);
+}
+
+#endif
@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * ir-capture.h - declarations of IR edge capture routines
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef IR_CAPTURE_H
+#define IR_CAPTURE_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+extern void                             ir_capture_isr_tick (void);
+#if defined (STM32F401RE) || defined (STM32F411RE)
+extern void                             ir_capture_exti_isr (void);
+#endif
+extern void                             ir_capture_init (void);
+
+#endif
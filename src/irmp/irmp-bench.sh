@@ -0,0 +1,81 @@
+#!/bin/sh
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+# irmp-bench.sh - host benchmark of IRMP decoder
+#
+# usage: src/irmp/irmp-bench.sh [scan files...]                 default: src/irmp/IR-Data/*.txt
+#
+# Builds the IRMP analyzer (irmp.c compiled on the host, see main() there) with the protocols of irmpconfig.h and replays the
+# scan files with option -b. Then every protocol of EXTRA_PROTOCOLS is enabled in addition to the previous ones, so the
+# growth of the worst case of irmp_ISR() can be seen. The scan files have one frame per line, sampled with F_INTERRUPTS:
+# '0' = IR burst, '1' = pause. A comment line "# text [protocol 0xaddress 0xcommand frames]" sets the expected values of
+# the following line: the 1st frame and frames - 1 repetition frames, frames is optional and defaults to 1.
+# IR-Data/*.txt have been generated with +/- 0.7 samples of jitter, record real remotes with IRMP_LOGGING.
+#
+# Columns: decoded frames, checked against expected values, wrong values, missed frames, average and worst case of basic
+# blocks run through by one call of irmp_ISR(). The blocks are counted by -fsanitize-coverage=trace-pc (gcc >= 12 or
+# clang), so the numbers are the same on every run and do not depend on load or clock of the host. They are no Cortex-M
+# cycles, only relative values are meaningful, e.g. worst case with JVC / worst case of irmpconfig.h.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+EXTRA_PROTOCOLS="JVC NEC16 NEC42 MATSUSHITA DENON RC5 RC6 IR60 GRUNDIG SIEMENS NOKIA BOSE KATHREIN NUBERT SPEAKER BANG_OLUFSEN
+                 RECS80 RECS80EXT THOMSON NIKON ORTEK TELEFUNKEN FDC RCCAR ROOMBA A1TVBOX LGAIR SAMSUNG48 MERLIN RADIO1"
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+BENCH_CFLAGS="-fsanitize-coverage=trace-pc -DIRMP_BENCH_BLOCKS"
+
+IRMP_DIR=$(dirname "$0")
+SRC_DIR=$IRMP_DIR/..
+
+if [ $# -eq 0 ]
+then
+    set -- "$IRMP_DIR"/IR-Data/*.txt
+fi
+
+TMP_DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+cp "$IRMP_DIR"/irmp.c "$IRMP_DIR"/*.h "$SRC_DIR"/wclock24h-config.h "$TMP_DIR" || exit 1
+cat "$@" > "$TMP_DIR"/input.txt || exit 1
+
+if ! $CC $CFLAGS $BENCH_CFLAGS -I"$TMP_DIR" -o "$TMP_DIR"/irmp "$TMP_DIR"/irmp.c 2> "$TMP_DIR"/cc.log
+then
+    cat "$TMP_DIR"/cc.log >&2
+    echo "$0: $CC cannot count basic blocks, gcc >= 12 or clang needed" >&2
+    exit 1
+fi
+
+bench ()
+{
+    if $CC $CFLAGS $BENCH_CFLAGS -I"$TMP_DIR" -o "$TMP_DIR"/irmp "$TMP_DIR"/irmp.c 2> "$TMP_DIR"/cc.log
+    then
+        "$TMP_DIR"/irmp -b < "$TMP_DIR"/input.txt | tail -2 |
+        sed -n -e 's/^frames: *\([0-9]*\) decoded, \([0-9]*\) checked, \([0-9]*\) wrong, \([0-9]*\) missed/\1 \2 \3 \4/p' \
+               -e 's/^irmp_ISR: [0-9]* calls, avg \([0-9.]*\) \([a-z]*\), max \([0-9]*\) .*/\1 \3 \2/p' |
+        tr '\n' ' ' | (read decoded checked wrong missed avg worst unit
+                       printf "%-16s %7s %7s %7s %7s %9s %9s %s\n" "$1" $decoded $checked $wrong $missed $avg $worst $unit)
+        return 0
+    fi
+
+    printf "%-16s build failed, disabled again\n" "$1"
+    return 1
+}
+
+printf "%-16s %7s %7s %7s %7s %9s %9s\n" "protocols" "decoded" "checked" "wrong" "missed" "avg" "worst"
+bench "irmpconfig.h"
+
+for p in $EXTRA_PROTOCOLS
+do
+    cp "$TMP_DIR"/irmpconfig.h "$TMP_DIR"/irmpconfig.h.last
+    sed -i -e "s/^\(#define IRMP_SUPPORT_${p}_PROTOCOL  *\)0/\11/" "$TMP_DIR"/irmpconfig.h
+
+    if ! bench "+$p"
+    then
+        mv "$TMP_DIR"/irmpconfig.h.last "$TMP_DIR"/irmpconfig.h
+    fi
+done
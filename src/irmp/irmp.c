@@ -4372,7 +4372,7 @@ irmp_ISR (void)
  * Compile it under linux with:
  * cc irmp.c -o irmp
  *
- * usage: ./irmp [-v|-s|-a|-l|-p] < file
+ * usage: ./irmp [-v|-s|-a|-l|-p|-b] < file
  *
  * options:
  *   -v verbose
@@ -4380,9 +4380,85 @@ irmp_ISR (void)
  *   -a analyze
  *   -l list pulse/pauses
  *   -p print timings
+ *   -b benchmark: count decoded, checked, wrong and missed frames and the basic blocks which every call of irmp_ISR()
+ *      runs through. The blocks are counted by the compiler instrumentation -fsanitize-coverage=trace-pc together with
+ *      -DIRMP_BENCH_BLOCKS (gcc >= 12 or clang), see irmp-bench.sh. Unlike host cycles they do not depend on load,
+ *      clock or cache of the host, so avg and max are the same on every run. Without the instrumentation only the
+ *      frames are counted and irmp_ISR() is reported as not measured.
+ *
+ * WordClock: see irmp-bench.sh for a benchmark of the protocols of irmpconfig.h and some additional protocols
  *---------------------------------------------------------------------------------------------------------------------------------------------------
  */
 
+static unsigned long long   bench_blocks;                           // basic blocks run through, see __sanitizer_cov_trace_pc()
+
+#if defined (IRMP_BENCH_BLOCKS)
+#  if defined (__clang__)
+#    define BENCH_NO_COVERAGE                   __attribute__ ((no_sanitize ("coverage")))
+#  elif defined (__GNUC__) && __GNUC__ >= 12
+#    define BENCH_NO_COVERAGE                   __attribute__ ((no_sanitize_coverage))
+#  else
+#    error IRMP_BENCH_BLOCKS needs gcc >= 12 or clang
+#  endif
+#  define BENCH_HAS_BLOCKS                      TRUE
+
+extern void                 __sanitizer_cov_trace_pc (void) BENCH_NO_COVERAGE;
+
+void                                                                // called by -fsanitize-coverage=trace-pc in every basic block
+__sanitizer_cov_trace_pc (void)
+{
+    bench_blocks++;
+}
+#else
+#  define BENCH_HAS_BLOCKS                      FALSE
+#endif
+
+static int                  benchmark = FALSE;
+static unsigned long        bench_calls;                            // calls of irmp_ISR()
+static unsigned long long   bench_sum;                              // sum of blocks of all calls
+static unsigned long long   bench_max;                              // max. blocks of one call
+static int                  bench_max_line;                         // line of input of bench_max
+static int                  bench_line = 1;                         // current line of input
+static int                  bench_frames;                           // decoded frames
+static int                  bench_checked;                          // frames with expected values
+static int                  bench_errors;                           // frames with wrong values
+static int                  bench_missed;                           // expected frames not decoded
+
+static void
+bench_isr (void)
+{
+    unsigned long long  blocks = bench_blocks;
+
+    (void) irmp_ISR ();
+    blocks = bench_blocks - blocks;
+
+    bench_sum += blocks;
+
+    if (bench_max < blocks)
+    {
+        bench_max       = blocks;
+        bench_max_line  = bench_line;
+    }
+
+    bench_calls++;
+}
+
+static void
+bench_print (void)
+{
+    printf ("frames:   %d decoded, %d checked, %d wrong, %d missed\n", bench_frames, bench_checked, bench_errors, bench_missed);
+
+    if (! BENCH_HAS_BLOCKS)
+    {
+        fprintf (stderr, "irmp: no basic block counter, compile with -fsanitize-coverage=trace-pc -DIRMP_BENCH_BLOCKS\n");
+        printf ("irmp_ISR: %lu calls, not measured\n", bench_calls);
+        return;
+    }
+
+    printf ("irmp_ISR: %lu calls, avg %.1f blocks, max %llu blocks (line %d)\n", bench_calls,
+            bench_calls ? (double) bench_sum / bench_calls : 0.0, bench_max, bench_max_line);
+}
+
 static void
 print_timings (void)
 {
@@ -4750,18 +4826,29 @@ static int         expected_protocol;
 static int         expected_address;
 static int         expected_command;
 static int         do_check_expected_values;
+static int         expected_frames;                                 // frames left with expected values, 1st one + repetitions
+static int         expected_flags;                                  // IRMP_FLAG_REPETITION after 1st frame
 
 static void
 next_tick (void)
 {
     if (! analyze && ! list)
     {
-        (void) irmp_ISR ();
+        if (benchmark)
+        {
+            bench_isr ();
+        }
+        else
+        {
+            (void) irmp_ISR ();
+        }
 
         if (irmp_get_data (&irmp_data))
         {
             uint_fast8_t key;
 
+            bench_frames++;
+
             ANALYZE_ONLY_NORMAL_PUTCHAR (' ');
 
             if (verbose)
@@ -4832,18 +4919,28 @@ next_tick (void)
 
             if (do_check_expected_values)
             {
+                bench_checked++;
+
                 if (irmp_data.protocol != expected_protocol ||
                     irmp_data.address  != expected_address  ||
-                    irmp_data.command  != expected_command)
+                    irmp_data.command  != expected_command  ||
+                    (irmp_data.flags & IRMP_FLAG_REPETITION) != expected_flags)
                 {
-                    printf ("\nerror 7: expected values differ: p=%2d (%s), a=0x%04x, c=0x%04x\n",
-                            expected_protocol, irmp_protocol_names[expected_protocol], expected_address, expected_command);
+                    bench_errors++;
+                    printf ("\nerror 7: expected values differ: p=%2d (%s), a=0x%04x, c=0x%04x, f=0x%02x\n",
+                            expected_protocol, irmp_protocol_names[expected_protocol], expected_address, expected_command, expected_flags);
                 }
                 else
                 {
                     printf (" checked!\n");
                 }
-                do_check_expected_values = FALSE;                           // only check 1st frame in a line!
+
+                expected_flags = IRMP_FLAG_REPETITION;
+
+                if (--expected_frames == 0)                                 // check 1st frame and repetitions given in comment
+                {
+                    do_check_expected_values = FALSE;
+                }
             }
             else
             {
@@ -4897,6 +4994,11 @@ main (int argc, char ** argv)
         {
             radio = TRUE;
         }
+        else if (! strcmp (argv[1], "-b"))
+        {
+            benchmark   = TRUE;
+            silent      = TRUE;                                     // no output in irmp_ISR()
+        }
     }
 
     for (i = 0; i < 256; i++)
@@ -4983,6 +5085,7 @@ main (int argc, char ** argv)
         {
             IRMP_PIN = 0xff;
             time_counter = 0;
+            bench_line++;
 
             if (list && pause > 0)
             {
@@ -5004,6 +5107,14 @@ main (int argc, char ** argv)
         {
             time_counter = 0;
 
+            if (do_check_expected_values)                                                   // last expected values not checked
+            {
+                bench_missed += expected_frames;
+                do_check_expected_values = FALSE;
+            }
+
+            bench_line++;
+
             if (analyze)
             {
                 while ((ch = getchar()) != '\n' && ch != EOF)
@@ -5079,6 +5190,15 @@ main (int argc, char ** argv)
                                         if (do_check_expected_values)
                                         {
                                             // printf ("!%2d %04x %04x!\n", expected_protocol, expected_address, expected_command);
+                                            expected_frames = 1;                                // optional: number of frames
+                                            expected_flags  = 0;
+
+                                            p += strspn (p, "0123456789abcdefABCDEF");          // skip command
+
+                                            if (sscanf (p, "%d", &expected_frames) != 1 || expected_frames < 1)
+                                            {
+                                                expected_frames = 1;
+                                            }
                                         }
                                     }
                                 }
@@ -5109,6 +5229,17 @@ main (int argc, char ** argv)
         print_spectrum ("PAUSES", pauses, FALSE);
         puts ("-------------------------------------------------------------------------------");
     }
+
+    if (benchmark)
+    {
+        if (do_check_expected_values)
+        {
+            bench_missed += expected_frames;
+        }
+
+        puts ("-------------------------------------------------------------------------------");
+        bench_print ();
+    }
     return 0;
 }
 
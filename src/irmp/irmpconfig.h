@@ -185,4 +185,13 @@
 #  define IRMP_USE_CALLBACK                     0       // 1: use callbacks. 0: do not. default is 0
 #endif
 
+/*---------------------------------------------------------------------------------------------------------------------------------------------------
+ * Use external input (STM32 only): irmp_ISR() reads the variable irmp_ext_input instead of the IR pin.
+ * WordClock: irmp_ISR() is fed with timestamped edges, see ir-capture.c
+ *---------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef IRMP_USE_EXT_INPUT
+#  define IRMP_USE_EXT_INPUT                    1       // 1: read irmp_ext_input, 0: read IR pin. default is 0
+#endif
+
 #endif /* _WC_IRMPCONFIG_H_ */
@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * ldr-config.h - configuration of LDR brightness curve
+ *
+ * Copyright (c) 2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef LDR_CONFIG_H
+#define LDR_CONFIG_H
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * brightness curve: the eye sees ambient light logarithmically, so the oversampled ADC value (15 bits, see adc-config.h)
+ * is mapped logarithmically to LDR_BRIGHTNESS_STEPS steps:
+ *
+ *   LDR_ADC_DARK   and below -> step 0
+ *   LDR_ADC_BRIGHT and above -> step LDR_BRIGHTNESS_STEPS - 1
+ *
+ * 256 ... 32767 are 7 octaves, about 9 steps per octave.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define LDR_ADC_DARK                256                                     // change here: ADC value in darkness
+#define LDR_ADC_BRIGHT              32767                                   // change here: ADC value in bright light
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * filter:
+ *   LDR_FILTER_SHIFT: exponential moving average, every poll (250 ms) adds 1/2^LDR_FILTER_SHIFT of the new value
+ *   LDR_HYSTERESIS:   a new step must be reached by LDR_HYSTERESIS/256 of a step to be accepted
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#define LDR_FILTER_SHIFT            2                                       // change here: 2 = time constant ~1 second
+#define LDR_HYSTERESIS              64                                      // change here: 1/4 step
+
+#endif // LDR_CONFIG_H
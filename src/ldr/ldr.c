@@ -3,6 +3,11 @@
  *
  * Copyright (c) 2016 Frank Meyer - frank(at)fli4l.de
  *
+ * The ADC delivers an oversampled value of the last 64 ms, see adc.c. Every poll, it is filtered by an exponential moving
+ * average and mapped logarithmically to LDR_BRIGHTNESS_STEPS steps with hysteresis, see ldr-config.h. The lowest
+ * and highest step are taken without hysteresis, because the curve clamps there.
+ * All calculations are done in fixed point.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -12,37 +17,121 @@
 
 #include "adc.h"
 #include "ldr.h"
+#include "ldr-config.h"
 #include "eeprom.h"
 #include "eeprom-data.h"
 
+static int32_t          ldr_filtered    = -1;                       // filtered ADC value * 256, -1: not initialized
+static uint_fast8_t     ldr_step;                                   // current brightness step
+
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * start conversion
+ * INTERN: log2 (x) * 256, x > 0
+ *
+ * Integer part: position of highest bit, fraction: 8 bits below, corrected by f + 0.34 * f * (1 - f), error < 0.01
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
-void
-ldr_start_conversion (void)
+static uint_fast16_t
+ldr_log2 (uint32_t x)
 {
-    adc_start_single_conversion ();
+    uint_fast8_t    msb = 0;
+    uint_fast16_t   frac;
+
+    while (x >> (msb + 1))
+    {
+        msb++;
+    }
+
+    if (msb >= 8)
+    {
+        frac = (x >> (msb - 8)) & 0xFF;
+    }
+    else
+    {
+        frac = (x << (8 - msb)) & 0xFF;
+    }
+
+    frac += (frac * (256 - frac) * 87) >> 16;                       // 87/256 = 0.34
+
+    return msb * 256 + frac;
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * poll LDR value
+ * INTERN: map filtered ADC value to brightness step * 256
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast16_t
+ldr_curve (uint32_t value)
+{
+    uint_fast16_t   log_dark    = ldr_log2 (LDR_ADC_DARK);
+    uint_fast16_t   log_bright  = ldr_log2 (LDR_ADC_BRIGHT);
+    uint_fast16_t   log_value;
+
+    if (value <= LDR_ADC_DARK)
+    {
+        return 0;
+    }
+
+    if (value >= LDR_ADC_BRIGHT)
+    {
+        return (LDR_BRIGHTNESS_STEPS - 1) * 256;
+    }
+
+    log_value = ldr_log2 (value);
+
+    return ((uint32_t) (log_value - log_dark) * (LDR_BRIGHTNESS_STEPS - 1) * 256) / (log_bright - log_dark);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * poll LDR value, call it every LDR_PERIOD_MS (see main.c)
+ *
+ * brightness_p: brightness step, 0 ... LDR_BRIGHTNESS_STEPS - 1
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
 ldr_poll_brightness  (uint_fast8_t * brightness_p)
 {
-    uint16_t        adc_value;
-    uint_fast8_t    rtc;
+    int32_t         value;
+    uint_fast16_t   step256;
+
+    if (! adc_is_up)
+    {
+        return 0;
+    }
 
-    rtc = adc_poll_conversion_value (&adc_value);
+    value = (int32_t) adc_get_oversampled_value () << 8;
 
-    if (rtc)
+    if (ldr_filtered < 0)
+    {
+        ldr_filtered = value;
+    }
+    else
     {
-        *brightness_p = (adc_value >> 8) & 0x0F;    // adc_value has 12 bits, but we need only 4 bits (16 values) for brightness
+        ldr_filtered += (value - ldr_filtered) >> LDR_FILTER_SHIFT;
     }
 
-    return rtc;
+    step256 = ldr_curve (ldr_filtered >> 8);
+
+    if (step256 == 0 || step256 >= (LDR_BRIGHTNESS_STEPS - 1) * 256U)       // curve clamps at both ends: no hysteresis there
+    {
+        ldr_step = step256 >> 8;
+    }
+    else if (step256 >= (ldr_step + 1) * 256U + LDR_HYSTERESIS || step256 + LDR_HYSTERESIS < ldr_step * 256U)
+    {
+        ldr_step = step256 >> 8;
+    }
+
+    *brightness_p = ldr_step;
+    return 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get brightness step of last ldr_poll_brightness()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+ldr_get_brightness (void)
+{
+    return ldr_step;
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
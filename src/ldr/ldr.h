@@ -24,8 +24,10 @@
 #  include "stm32f4xx_adc.h"
 #endif
 
-extern void             ldr_start_conversion (void);
+#define LDR_BRIGHTNESS_STEPS    64                                  // brightness steps of ldr_poll_brightness()
+
 extern uint_fast8_t     ldr_poll_brightness (uint_fast8_t *);
+extern uint_fast8_t     ldr_get_brightness (void);
 extern void             ldr_init (void);
 
 #endif // LDR_H
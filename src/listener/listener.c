@@ -58,7 +58,7 @@ listener (LISTENER_DATA * ld)
             char * endptr;
             uint32_t seconds_since_1900 = strtoul (info->time, &endptr, 10);
             timeserver_convert_time (&(ld->tm), seconds_since_1900);
-            rtc = LISTENER_SET_DATE_TIME_CODE;
+            rtc = LISTENER_NET_TIME_CODE;
             break;
 
         case ESP8266_CMD:
@@ -126,7 +126,7 @@ listener (LISTENER_DATA * ld)
                         if (n == 7)
                         {
                             rtc             = param[0];
-                            ld->tm.tm_year  = param[1] + 2000;
+                            ld->tm.tm_year  = param[1] + 100;                   // tm_year begins with 1900
                             ld->tm.tm_mon   = param[2] - 1;
                             ld->tm.tm_mday  = param[3];
                             ld->tm.tm_hour  = param[4];
@@ -27,6 +27,7 @@
 #define LISTENER_TEST_DISPLAY_CODE              'X'                             // test display
 #define LISTENER_SET_DATE_TIME_CODE             'T'                             // set date/time
 #define LISTENER_GET_NET_TIME_CODE              'N'                             // Get net time
+#define LISTENER_NET_TIME_CODE                  'n'                             // got net time from time server
 #define LISTENER_IR_LEARN_CODE                  'I'                             // IR learn
 #define LISTENER_SET_NIGHT_TIME                 'J'                             // set night off time
 #define LISTENER_SAVE_DISPLAY_CONFIGURATION     'S'                             // save display configuration
@@ -44,14 +44,17 @@
  *    +-------------------------+-------------------------------+-------------------------------+
  *    | Device                  | STM32F4x1 Nucleo              | STM32F103C8T6                 |
  *    +-------------------------+-------------------------------+-------------------------------+
- *    | TSOP31238 (IRMP)        | GPIO:      PC10               | GPIO:      PB3                |
+ *    | TSOP31238 (IRMP)        | EXTI10:    PC10               | EXTI3:     PB3                |
  *    | DS18xx (OneWire)        | GPIO:      PD2                | GPIO:      PB5                |
+ *    | DS18xx (OneWire USART)  | USART1:    TX=PA9             | USART3:    TX=PB10            |
  *    | Logger (Nucleo: USB)    | USART2:    TX=PA2  RX=PA3     | USART1:    TX=PA9  RX=PA10    |
  *    | ESP8266 USART           | USART6:    TX=PA11 RX=PA12    | USART2:    TX=PA2  RX=PA3     |
  *    | ESP8266 GPIO            | GPIO:      RST=PA7 CH_PD=PA6  | GPIO:      RST=PA0 CH_PD=PA1  |
  *    | ESP8266 GPIO (FLASH)    | GPIO:      FLASH=PA4          | GPIO:      FLASH=PA4          |
- *    | DCF77                   | GPIO:      DATA=PC11 PON=PC12 | GPIO:      DATA=PB8  PON=PB9  |
+ *    | DCF77                   | EXTI11:    DATA=PC11          | TIM4_CH3:  DATA=PB8           |
+ *    | DCF77 PON               | GPIO:      PON=PC12           | GPIO:      PON=PB9            |
  *    | I2C DS3231 & EEPROM     | I2C3:      SCL=PA8 SDA=PC9    | I2C1:      SCL=PB6 SDA=PB7    |
+ *    | DS3231 SQW (1Hz)        | EXTI0:     PB0                | EXTI0:     PB0                |
  *    | LDR                     | ADC:       ACD1_IN14=PC4      | ADC:       ADC12_IN5=PA5      |
  *    | WS2812                  | TIM3/DMA1: PC6                | TIM1/DMA1: PA8                |
  *    | APA102                  | SPI2/DMA1: SCK=PB13 MOSI=PB15 | SPI2/DMA1: SCK=PB13 MOSI=PB15 |
@@ -63,9 +66,13 @@
  *    +-------------------------+-------------------------------+-------------------------------+
  *    | Device                  | STM32F4x1 Nucleo              | STM32F103C8T6                 |
  *    +-------------------------+-------------------------------+-------------------------------+
- *    | General (IRMP etc.)     | TIM2                          | TIM2                          |
+ *    | General (1 kHz tick)    | TIM2                          | TIM2                          |
+ *    | LDR (ADC trigger, DMA)  | TIM2 TRGO, DMA2 Stream0       | TIM2 CC2, DMA1 Channel1       |
  *    | WS2812                  | TIM3                          | TIM1                          |
+ *    | DCF77 (edge timestamps) | TIM5                          | TIM4                          |
+ *    | IRMP (edge timestamps)  | TIM4                          | TIM3                          |
  *    | DS18xx (OneWire)        | Systick (see delay.c)         | Systick (see delay.c)         |
+ *    | DS18xx (OneWire USART)  | USART1, DMA2 Stream7/Stream5  | USART3, DMA1 Channel2/3       |
  *    +-------------------------+-------------------------------+-------------------------------+
  *
  * This program is free software; you can redistribute it and/or modify
@@ -89,15 +96,24 @@
 #include "board-led.h"
 #include "irmp.h"
 #include "remote-ir.h"
+#include "ir-capture.h"
 #include "button.h"
 #include "eeprom.h"
+#include "flash-eeprom.h"
 #include "eeprom-data.h"
 #include "tempsensor.h"
 #include "ds18xx.h"
+#include "onewire-config.h"
 #include "rtc.h"
 #include "ldr.h"
 #include "delay.h"
 #include "night.h"
+#include "timer.h"
+#include "event.h"
+#include "sched.h"
+#include "pt.h"
+#include "softclock.h"
+#include "timesource.h"
 #if WCLOCK24H == 1
 #include "tables.h"
 #endif
@@ -116,54 +132,95 @@ uint_fast8_t                    esp8266_is_online           = 0;        // flag,
  * global private variables
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
-static volatile uint_fast8_t    animation_flag              = 0;        // flag: animate LEDs
-static volatile uint_fast8_t    dcf77_flag                  = 0;        // flag: check DCF77 signal
-static volatile uint_fast8_t    ds3231_flag                 = 0;        // flag: read date/time from RTC DS3231
-static volatile uint_fast8_t    net_time_flag               = 0;        // flag: read date/time from time server
-static volatile uint_fast16_t   net_time_countdown          = 3800;     // counter: if it counts to 0, then net_time_flag will be triggered
-static volatile uint_fast8_t    ldr_conversion_flag         = 0;        // flag: read LDR value
-static volatile uint_fast8_t    show_time_flag              = 0;        // flag: update time on display, set every full minute
+static uint_fast8_t             net_time_flag               = 0;        // flag: read date/time from time server
+static uint_fast8_t             net_time_timer              = TIMER_INVALID;    // timer: triggers net_time_flag every 3800 seconds
+static uint_fast8_t             status_led_timer            = TIMER_INVALID;    // timer: switches off status LED
+
+static uint_fast8_t             dcf77_task_id               = SCHED_INVALID;    // task: sample DCF77 signal
+static uint_fast8_t             animation_task_id           = SCHED_INVALID;    // task: animate LEDs
+static uint_fast8_t             ldr_task_id                 = SCHED_INVALID;    // task: read LDR
+static uint_fast8_t             night_task_id               = SCHED_INVALID;    // task: update time on display, check night timers
+static uint_fast8_t             rtc_task_id                 = SCHED_INVALID;    // task: check soft clock against RTC DS3231
+#if SAVE_RAM == 0
+static uint_fast8_t             ir_task_id                  = SCHED_INVALID;    // task: poll IR decoder
+#endif
+static uint_fast8_t             listener_task_id            = SCHED_INVALID;    // task: poll ESP8266 listener
+static uint_fast8_t             display_task_id             = SCHED_INVALID;    // task: refresh display
+static uint_fast8_t             temp_task_id                = SCHED_INVALID;    // task: read DS18xx temperature
+static uint_fast8_t             eeprom_task_id              = SCHED_INVALID;    // task: write EEPROM log
 static volatile uint_fast8_t    short_isr                   = 0;        // flag: run TIM2_IRQHandler() in short version
-static volatile uint32_t        uptime                      = 0;        // uptime in seconds
-static volatile uint_fast8_t    wday                        = 0;        // current weekday, 0=Sunday
-static volatile uint_fast8_t    hour                        = 0;        // current hour
-static volatile uint_fast8_t    minute                      = 0;        // current minute
-static volatile uint_fast8_t    second                      = 0;        // current second
 
 static uint_fast8_t             auto_brightness             = 0;        // flag: LDR controls brightness
 static uint_fast8_t             display_mode                = 0;        // display mode
 static uint_fast8_t             animation_mode              = 0;        // animation mode
+
+static uint_fast8_t             display_flag                = DISPLAY_FLAG_UPDATE_ALL;  // flag: refresh display
+static uint_fast8_t             show_temperature            = 0;        // flag: show temperature
+static uint32_t                 temperature_stop_time       = 0;        // uptime when showing temperature ends, 0 = inactive
+static uint_fast8_t             power_is_on                 = 1;        // flag: display is on
+static uint_fast8_t             night_power_is_on           = 1;        // flag: display is on, changed by night timers
+static uint_fast8_t             last_ldr_value              = 0xFF;     // last brightness value of LDR
+static uint32_t                 first_frame_ms              = 0;        // timer_ms of first display update, see display_task()
+static ESP8266_INFO *           esp8266_infop;                          // esp8266 info, see esp8266_get_info()
+static uint_fast8_t             esp8266_is_up               = 0;        // flag: esp8266 is up
+static uint_fast8_t             ap_mode                     = 0;        // flag: esp8266 is configured as access point
+
+#if SAVE_RAM == 0
+static REMOTE_IR_LEARN_CTX      ir_learn_ctx;                           // state of IR learn function, see ir_task()
+static uint_fast8_t             ir_learn_active             = 0;        // flag: IR learn function is running
+#endif
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * timer definitions:
  *
- *      F_INTERRUPTS    = TIM_CLK / (TIM_PRESCALER + 1) / (TIM_PERIOD + 1)
- * <==> TIM_PRESCALER   = TIM_CLK / F_INTERRUPTS / (TIM_PERIOD + 1) - 1
+ *      TIM_INTERRUPTS  = TIM_CLK / (TIM_PRESCALER + 1) / (TIM_PERIOD + 1)
+ * <==> TIM_PRESCALER   = TIM_CLK / TIM_INTERRUPTS / (TIM_PERIOD + 1) - 1
  *
  * STM32F4x1:
- *      TIM_PERIOD      =   8 - 1 =   7
- *      TIM_PRESCALER   = 700 - 1 = 699
- *      F_INTERRUPTS    = 84000000 / 700 / 8 = 15000
+ *      TIM_PERIOD      = 1000 - 1 = 999
+ *      TIM_PRESCALER   =   84 - 1 =  83
+ *      TIM_INTERRUPTS  = 84000000 / 84 / 1000 = 1000
  * STM32F103:
- *      TIM_PERIOD      =   6 - 1 =   5
- *      TIM_PRESCALER   = 800 - 1 = 799
- *      F_INTERRUPTS    = 72000000 / 800 / 6 = 15000
+ *      TIM_PERIOD      = 1000 - 1 = 999
+ *      TIM_PRESCALER   =   72 - 1 =  71
+ *      TIM_INTERRUPTS  = 72000000 / 72 / 1000 = 1000
+ *
+ * IRMP is fed with timestamped IR edges (see ir-capture.c), so TIM2 does not run with F_INTERRUPTS anymore.
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 #if defined (STM32F401RE) || defined (STM32F411RE)                          // STM32F401/STM32F411 Nucleo Board PC13
 #define TIM_CLK                 84000000L                                   // timer clock, 84MHz on STM32F401/411 Nucleo Board
-#define TIM_PERIOD              7
 
 #elif defined (STM32F103)
 #define TIM_CLK                 72000000L                                   // timer clock, 72MHz on STM32F103
-#define TIM_PERIOD              5
 #else
 #error STM32 unknown
 #endif
 
-#define TIM_PRESCALER           ((TIM_CLK / F_INTERRUPTS) / (TIM_PERIOD + 1) - 1)
+#define TIM_INTERRUPTS          1000                                        // timer wheel and soft clock: 1 ms tick
+#define TIM_PERIOD              999
+#define TIM_PRESCALER           ((TIM_CLK / TIM_INTERRUPTS) / (TIM_PERIOD + 1) - 1)
+
+#define STATUS_LED_FLASH_TIME   50                                          // status LED: time of flash in ms
+
+#define CLOCK_PERIOD_MS         1000                                        // night and rtc task: deadline
+#define ANIMATION_PERIOD_MS     DSP_ANIMATION_PERIOD_MS                     // animation: 40 frames per second
+#define DCF77_PERIOD_MS         10                                          // dcf77: check timeouts every 1/100 of a second
+#define ESP8266_PERIOD_MS       10                                          // esp8266: set ten ms tick every 1/100 of a second
+
+#define LDR_DELAY_MS            2000                                        // ldr: first poll after 2 seconds uptime
+#define LDR_PERIOD_MS           250                                         // ldr: filter LDR value every 1/4 seconds
+#define DS3231_PERIOD_MS        (6 * 3600 * 1000L)                          // rtc: check soft clock every 6 hours
+#define NET_TIME_PERIOD_MS      (3800 * 1000L)                              // net time: update every 3800 seconds
+#define SCHED_LOG_PERIOD_MS     (600 * 1000L)                               // scheduler: log task statistics every 10 minutes
+
 
-#define STATUS_LED_FLASH_TIME   50                                          // status LED: time of flash
+#define IR_DEADLINE_MS          50                                          // ir task: deadline
+#define LISTENER_DEADLINE_MS    100                                         // listener task: deadline
+#define DISPLAY_DEADLINE_MS     100                                         // display task: deadline
+#define TEMP_DEADLINE_MS        100                                         // temp task: deadline
+#define EEPROM_DEADLINE_MS      100                                         // eeprom task: deadline
+#define TEMPERATURE_SHOW_TIME   5                                           // WC24H: show temperature for 5 seconds
 
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
@@ -202,166 +259,190 @@ timer2_init (void)
     TIM_Cmd(TIM2, ENABLE);
 }
 
-/*-------------------------------------------------------------------------------------------------------------------------------------------
- * timer2 IRQ handler for IRMP, soft clock, dcf77, animations, several timeouts
- *-------------------------------------------------------------------------------------------------------------------------------------------
- */
-void
-TIM2_IRQHandler (void)
-{
-    static uint_fast16_t ldr_cnt;
-    static uint_fast16_t animation_cnt;
-    static uint_fast16_t clk_cnt;
-    static uint_fast16_t dcf77_cnt;
-    static uint_fast16_t net_time_cnt;
-    static uint_fast16_t eeprom_cnt;
-    static uint_fast16_t ds3231_cnt;
-
-    TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer callback: set esp8266_ten_ms_tick every 1/100 of a second (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+esp8266_timer_isr (void)
+{
+    esp8266_ten_ms_tick = 1;
+}
 
-    if (short_isr)                                                          // run this handler in short version
-    {
-        clk_cnt++;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer callback: queue animation event (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+animation_timer_isr (void)
+{
+    (void) event_put (EVENT_ANIMATION, 0);
+}
 
-        if (clk_cnt == F_INTERRUPTS)                                        // increment internal clock every second
-        {
-            clk_cnt = 0;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer callback: queue DCF77 timeout check event (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_timer_isr (void)
+{
+    (void) event_put (EVENT_DCF77, 0);
+}
 
-            uptime++;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer callback: queue LDR conversion event (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+ldr_timer_isr (void)
+{
+    (void) event_put (EVENT_LDR, 0);
+}
 
-            second++;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer callback: queue RTC check event (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+ds3231_timer_isr (void)
+{
+    (void) event_put (EVENT_RTC, 0);
+}
 
-            if (second == 60)
-            {
-                second = 0;
-                minute++;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer callback: queue net time event (interrupt context)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+net_time_timer_isr (void)
+{
+    (void) event_put (EVENT_NET_TIME, 0);
+}
 
-                show_time_flag = 1;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer callback: switch off status LED
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+status_led_timer_expired (void)
+{
+    display_set_status_led (0, 0, 0);
+}
 
-                if (minute == 60)
-                {
-                    minute = 0;
-                    hour++;
 
-                    if (hour == 24)
-                    {
-                        hour = 0;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * idle: sleep until next interrupt if nothing is to do
+ *
+ * Interrupts are disabled while checking the queues, so no event can get lost between the check and WFI. WFI wakes up on
+ * a pending interrupt even if interrupts are disabled, the handler is called after __enable_irq().
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+idle (void)
+{
+    uint32_t    start;
 
-                        wday++;
+    __disable_irq();
 
-                        if (wday == 7)
-                        {
-                            wday = 0;
-                        }
-                    }
-                }
-            }
-        }
+    if (! event_depth () && ! timer_is_pending ())
+    {
+        start = delay_get_cycles ();
+        __WFI();
+        sched_add_idle_cycles (delay_get_cycles () - start);
     }
-    else
-    {                                                                       // no short version, run all
-#if SAVE_RAM == 0
-        (void) irmp_ISR ();                                                 // call irmp ISR
-#endif
-
-        if (uptime > 1)
-        {
-            ldr_cnt++;
-
-            if (ldr_cnt == F_INTERRUPTS / 4)                                // start LDR conversion every 1/4 seconds
-            {
-                ldr_conversion_flag = 1;
-                ldr_cnt = 0;
-            }
-        }
-
-        animation_cnt++;
 
-        if (animation_cnt == F_INTERRUPTS / 40)                             // set animation_flag every 1/40 of a second
-        {
-            animation_flag = 1;
-            animation_cnt = 0;
-        }
+    __enable_irq();
+}
 
-        dcf77_cnt++;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * drain event queue and run expired main loop timers
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+process_events (void)
+{
+    EVENT   event;
 
-        if (dcf77_cnt == F_INTERRUPTS / 100)                                // set dcf77_flag every 1/100 of a second
+    while (event_get (&event))
+    {
+        switch (event.type)
         {
-            dcf77_flag = 1;
-            dcf77_cnt = 0;
-        }
-
-        net_time_cnt++;
-
-        if (net_time_cnt == F_INTERRUPTS / 100)                             // set esp8266_ten_ms_tick every 1/100 of a second
-        {
-            esp8266_ten_ms_tick = 1;
-            net_time_cnt = 0;
-        }
-
-        eeprom_cnt++;
-
-        if (eeprom_cnt == F_INTERRUPTS / 1000)                              // set eeprom_ms_tick every 1/1000 of a second
-        {
-            eeprom_ms_tick = 1;
-            eeprom_cnt = 0;
+            case EVENT_ANIMATION:   sched_set_ready (animation_task_id);    break;
+            case EVENT_DCF77:       sched_set_ready (dcf77_task_id);        break;
+            case EVENT_DCF77_EDGE:  dcf77_edge_event (event.timestamp, event.data); break;
+            case EVENT_LDR:         sched_set_ready (ldr_task_id);          break;
+            case EVENT_RTC:         sched_set_ready (rtc_task_id);          break;
+            case EVENT_NET_TIME:    net_time_flag = 1;                      break;
+            case EVENT_MINUTE:      sched_set_ready (night_task_id);        break;
         }
+    }
 
-        clk_cnt++;
-
-        if (clk_cnt == F_INTERRUPTS)                                        // increment internal clock every second
-        {
-            clk_cnt = 0;
-
-            uptime++;
-
-            second++;
-
-            ds3231_cnt++;
-
-            if (ds3231_cnt >= 70)                                           // get rtc time every 70 seconds
-            {
-                ds3231_flag = 1;
-                ds3231_cnt = 0;
-            }
-
-            if (second == 60)
-            {
-                second = 0;
-                minute++;
+    timer_run ();
+}
 
-                show_time_flag = 1;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * register timers
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+timers_init (void)
+{
+    timer_init ();
+    softclock_init ();
+    timesource_init ();
+    event_init ();
+
+    timer_add_periodic (ESP8266_PERIOD_MS, esp8266_timer_isr, TIMER_FLAG_ISR);
+    timer_add_periodic (ANIMATION_PERIOD_MS, animation_timer_isr, TIMER_FLAG_ISR);
+    timer_add_periodic (DCF77_PERIOD_MS, dcf77_timer_isr, TIMER_FLAG_ISR);
+    timer_add (LDR_DELAY_MS, LDR_PERIOD_MS, ldr_timer_isr, TIMER_FLAG_ISR);
+    timer_add_periodic (DS3231_PERIOD_MS, ds3231_timer_isr, TIMER_FLAG_ISR);
+    net_time_timer = timer_add_periodic (NET_TIME_PERIOD_MS, net_time_timer_isr, TIMER_FLAG_ISR);
+    timer_add_periodic (SCHED_IDLE_PERIOD_MS, sched_idle_statistics, TIMER_FLAG_NONE);
+    timer_add_periodic (SCHED_LOG_PERIOD_MS, sched_log_statistics, TIMER_FLAG_NONE);
+
+    status_led_timer = timer_add_oneshot (STATUS_LED_FLASH_TIME, status_led_timer_expired, TIMER_FLAG_NONE);
+    timer_stop (status_led_timer);                                          // will be started by timer_restart()
+}
 
-                if (minute == 60)
-                {
-                    minute = 0;
-                    hour++;
-
-                    if (hour == 24)
-                    {
-                        hour = 0;
-                        wday++;
-
-                        if (wday == 7)
-                        {
-                            wday = 0;
-                        }
-                    }
-                }
-            }
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer2 IRQ handler for IRMP, soft clock and timer wheel (dcf77, animations, several timeouts), called every 1/1000 of a second
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+TIM2_IRQHandler (void)
+{
+    TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
 
-            if (net_time_countdown)
-            {
-                net_time_countdown--;
+    softclock_isr_tick ();
 
-                if (net_time_countdown == 0)                                // net time update every 3800 minutes
-                {
-                    net_time_flag = 1;
-                }
-            }
-        }
+    if (short_isr)                                                          // short version: don't disturb timing of onewire
+    {
+        timer_isr_tick (1);                                                 // keep timer_ms running, ISR callbacks are deferred
+    }
+    else
+    {
+#if SAVE_RAM == 0
+        ir_capture_isr_tick ();                                             // feed IRMP with IR edges, edges are kept until next call
+#endif
+        timer_isr_tick (0);
     }
+}
+
+#if defined (STM32F401RE) || defined (STM32F411RE)
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * EXTI15_10 IRQ handler: edges of IR (EXTI10) and DCF77 (EXTI11)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+EXTI15_10_IRQHandler (void)
+{
+#if SAVE_RAM == 0
+    ir_capture_exti_isr ();
+#endif
+    dcf77_exti_isr ();
 }
+#endif
 
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
@@ -398,479 +479,634 @@ write_version_to_eeprom (void)
     return rtc;
 }
 
-/*-------------------------------------------------------------------------------------------------------------------------------------------
- * main function
- *-------------------------------------------------------------------------------------------------------------------------------------------
- */
-int
-main ()
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * report time of a time source, which began age_ms ago, see timesource_report(). Refresh display if hour or minute
+ * changes. The RTC is only written if the soft clock has been corrected by another source.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+report_time (uint_fast8_t source, struct tm * tmp, uint_fast16_t age_ms)
 {
-    static uint_fast8_t     last_ldr_value = 0xFF;
-    struct tm               tm;
-    LISTENER_DATA           lis;
-    ESP8266_INFO *          esp8266_infop;
-    uint_fast8_t            esp8266_is_up = 0;
-    uint_fast8_t            code;
+    struct tm       now;
+    uint_fast8_t    rtc;
 
-#if SAVE_RAM == 0
-    IRMP_DATA               irmp_data;
-    uint32_t                stop_time;
-    uint_fast8_t            cmd;
-#endif
-    uint_fast8_t            status_led_cnt              = 0;
-    uint_fast8_t            display_flag                = DISPLAY_FLAG_UPDATE_ALL;
-    uint_fast8_t            show_temperature            = 0;
-    uint_fast8_t            time_changed                = 0;
-    uint_fast8_t            power_is_on                 = 1;
-    uint_fast8_t            night_power_is_on           = 1;
-    uint_fast8_t            ldr_value;
-    uint_fast8_t            ap_mode = 0;
+    softclock_get_tm (&now);
+    rtc = timesource_report (source, tmp, age_ms);
 
-    SystemInit ();
-    SystemCoreClockUpdate();                                                // needed for Nucleo board
+    if (rtc == TIMESOURCE_CORRECTED)
+    {
+        if (now.tm_hour != tmp->tm_hour || now.tm_min != tmp->tm_min)
+        {
+            display_flag = DISPLAY_FLAG_UPDATE_ALL;
+        }
 
-#if defined (STM32F103)                                                     // disable JTAG to get back PB3, PB4, PA13, PA14, PA15
-    RCC_APB2PeriphClockCmd(RCC_APB2Periph_AFIO, ENABLE);                    // turn on clock for the alternate function register
-    GPIO_PinRemapConfig(GPIO_Remap_SWJ_JTAGDisable, ENABLE);                // disable the JTAG, enable the SWJ interface
-#endif
+        if (source != TIMESOURCE_RTC && rtc_is_up)
+        {
+            rtc_set_date_time (tmp);
+        }
+    }
 
-    log_init ();                                                            // initilize logger on uart
+    log_printf ("%s: soft clock offset %ld ms\r\n", timesource_get (source)->name, (long) timesource_get (source)->last_offset);
+    return rtc;
+}
 
-#if SAVE_RAM == 0
-    irmp_init ();                                                           // initialize IRMP
-#endif
-    timer2_init ();                                                         // initialize timer2 for IRMP, DCF77, EEPROM etc.
-    delay_init (DELAY_RESOLUTION_1_US);                                     // initialize delay functions with granularity of 1 us
-    board_led_init ();                                                      // initialize GPIO for green LED on disco or nucleo board
-    button_init ();                                                         // initialize GPIO for user button on disco or nucleo board
-    rtc_init ();                                                            // initialize I2C RTC
-    eeprom_init ();                                                         // initialize I2C EEPROM
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: decode DCF77 edges, set soft clock and RTC if a DCF77 frame has been decoded
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+dcf77_task (void)
+{
+    struct tm       tm;
+    uint_fast16_t   age_ms;
 
-    if (button_pressed ())                                                  // set ESP8266 into flash mode
+    dcf77_tick ();
+
+    if (dcf77_time (&tm, &age_ms))
     {
-        board_led_on ();
-        esp8266_flash ();
-    }
+        display_set_status_led (1, 1, 0);                       // got DCF77 time, light yellow = green + red LED
 
-    log_msg ("\r\nWelcome to WordClock Logger!");
-    log_msg ("----------------------------");
-    log_str ("Version: ");
-    log_msg (VERSION);
+        timer_restart (status_led_timer);
 
-    if (rtc_is_up)
-    {
-        log_msg ("rtc is online");
-    }
-    else
-    {
-        log_msg ("rtc is offline");
+        report_time (TIMESOURCE_DCF77, &tm, age_ms);
+
+        log_printf ("dcf77: %s %4d-%02d-%02d %02d:%02d:%02d, confidence %u\r\n",
+                     wdays_en[tm.tm_wday], tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                     (unsigned int) dcf77_get_confidence ());
     }
+}
 
-    if (eeprom_is_up)
-    {
-        log_msg ("eeprom is online");
-        read_version_from_eeprom ();
-        log_printf ("current eeprom version: 0x%08x\r\n", eeprom_version);
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: animate LEDs
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+animation_task (void)
+{
+    display_animation ();
+}
 
-        if ((eeprom_version & 0xFF0000FF) == 0x00000000)
-        {                                                               // Upper and Lower Byte must be 0x00
-            if (eeprom_version >= EEPROM_VERSION_1_5_0)
-            {
 #if SAVE_RAM == 0
-                log_msg ("reading ir codes from eeprom");
-                remote_ir_read_codes_from_eeprom ();
-#endif
-                log_msg ("reading display configuration from eeprom");
-                display_read_config_from_eeprom ();
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * start learning IR codes, see ir_task()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+ir_learn_start (void)
+{
+    remote_ir_learn_start (&ir_learn_ctx);
+    ir_learn_active = 1;
+}
 
-                log_msg ("reading timeserver data from eeprom");
-                timeserver_read_data_from_eeprom ();
-            }
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: learn IR codes or handle IR commands
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+ir_task (void)
+{
+    struct tm       tm;
+    uint_fast8_t    time_changed = 0;
+    uint_fast8_t    cmd;
 
-            if (eeprom_version >= EEPROM_VERSION_1_7_0)
+    if (ir_learn_active)                                                    // learning IR codes, don't interpret IR commands
+    {
+        if (! PT_SCHEDULE(remote_ir_learn_pt (&ir_learn_ctx)))
+        {
+            ir_learn_active = 0;
+
+            if (ir_learn_ctx.rtc)
             {
-                log_msg ("reading night timers from eeprom");
-                night_read_data_from_eeprom ();
+                remote_ir_write_codes_to_eeprom ();                         // if successful, save them in EEPROM
             }
+
+            display_flag = DISPLAY_FLAG_UPDATE_ALL;
         }
+
+        return;
     }
-    else
+
+    cmd = remote_ir_get_cmd ();                                         // get IR command
+
+    if (cmd != REMOTE_IR_CMD_INVALID)                                   // got IR command, light green LED
     {
-        log_msg ("eeprom is offline");
+        display_set_status_led (1, 0, 0);
+        timer_restart (status_led_timer);
     }
 
-    ldr_init ();                                                            // initialize LDR (ADC)
-    display_init ();                                                        // initialize display
-
-    dcf77_init ();                                                          // initialize DCF77
+    if (cmd != REMOTE_IR_CMD_INVALID)                                   // if command valid, log command code
+    {
+        switch (cmd)
+        {
+            case REMOTE_IR_CMD_POWER:                         log_msg ("IRMP: POWER key");                  break;
+            case REMOTE_IR_CMD_OK:                            log_msg ("IRMP: OK key");                     break;
+            case REMOTE_IR_CMD_DECREMENT_DISPLAY_MODE:        log_msg ("IRMP: decrement display mode");     break;
+            case REMOTE_IR_CMD_INCREMENT_DISPLAY_MODE:        log_msg ("IRMP: increment display mode");     break;
+            case REMOTE_IR_CMD_DECREMENT_ANIMATION_MODE:      log_msg ("IRMP: decrement animation mode");   break;
+            case REMOTE_IR_CMD_INCREMENT_ANIMATION_MODE:      log_msg ("IRMP: increment animation mode");   break;
+            case REMOTE_IR_CMD_DECREMENT_HOUR:                log_msg ("IRMP: decrement hour");             break;
+            case REMOTE_IR_CMD_INCREMENT_HOUR:                log_msg ("IRMP: increment hour");             break;
+            case REMOTE_IR_CMD_DECREMENT_MINUTE:              log_msg ("IRMP: decrement minute");           break;
+            case REMOTE_IR_CMD_INCREMENT_MINUTE:              log_msg ("IRMP: increment minute");           break;
+            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_RED:      log_msg ("IRMP: decrement red brightness");   break;
+            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_RED:      log_msg ("IRMP: increment red brightness");   break;
+            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_GREEN:    log_msg ("IRMP: decrement green brightness"); break;
+            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_GREEN:    log_msg ("IRMP: increment green brightness"); break;
+            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_BLUE:     log_msg ("IRMP: decrement blue brightness");  break;
+            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_BLUE:     log_msg ("IRMP: increment blue brightness");  break;
+            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS:          log_msg ("IRMP: decrement brightness");       break;
+            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS:          log_msg ("IRMP: increment brightness");       break;
+            case REMOTE_IR_CMD_GET_TEMPERATURE:               log_msg ("IRMP: get temperature");            break;
+        }
+    }
 
-    night_init ();                                                          // initialize night time routines
+    switch (cmd)
+    {
+        case REMOTE_IR_CMD_POWER:
+        {
+            power_is_on = ! power_is_on;
 
-    short_isr = 1;
-    temp_init ();                                                           // initialize DS18xx
-    short_isr = 0;
+            display_flag        = DISPLAY_FLAG_UPDATE_ALL;
+            break;
+        }
 
-    display_reset_led_states ();
-    display_mode                = display_get_display_mode ();
-    animation_mode              = display_get_animation_mode ();
-    auto_brightness             = display_get_automatic_brightness_control ();
-
-    if (eeprom_is_up)
-    {
-        if (eeprom_version != EEPROM_VERSION)
+        case REMOTE_IR_CMD_OK:
         {
-            log_printf ("updating EEPROM to version 0x%08x\r\n", EEPROM_VERSION);
-
-            eeprom_version = EEPROM_VERSION;
-            write_version_to_eeprom ();
-#if SAVE_RAM == 0
-            remote_ir_write_codes_to_eeprom ();
-#endif
             display_write_config_to_eeprom ();
-            timeserver_write_data_to_eeprom ();
-            night_write_data_to_eeprom ();
-            eeprom_version = EEPROM_VERSION;
-        }
-    }
+            break;
+        }
 
-    ds3231_flag = 1;
+        case REMOTE_IR_CMD_DECREMENT_DISPLAY_MODE:                      // decrement display mode
+        {
+            display_mode = display_decrement_display_mode ();
+            display_flag = DISPLAY_FLAG_UPDATE_ALL;
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_DISPLAY_MODE:                      // increment display mode
+        {
+            display_mode = display_increment_display_mode ();
+            display_flag = DISPLAY_FLAG_UPDATE_ALL;
+            break;
+        }
+
+        case REMOTE_IR_CMD_DECREMENT_ANIMATION_MODE:                    // decrement display mode
+        {
+            animation_mode = display_decrement_animation_mode ();
+            display_flag = DISPLAY_FLAG_UPDATE_ALL;
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_ANIMATION_MODE:                    // increment display mode
+        {
+            animation_mode = display_increment_animation_mode ();
+            display_flag = DISPLAY_FLAG_UPDATE_ALL;
+            break;
+        }
+
+        case REMOTE_IR_CMD_DECREMENT_HOUR:                              // decrement hour
+        {
+            softclock_get_tm (&tm);
 
-#if SAVE_RAM == 0
-    stop_time = uptime + 3;                                                 // wait 3 seconds for IR signal...
-    display_set_status_led (1, 1, 1);                                       // show white status LED
+            if (tm.tm_hour > 0)
+            {
+                tm.tm_hour--;
+            }
+            else
+            {
+                tm.tm_hour = 23;
+            }
 
-    while (uptime < stop_time)
-    {
-        if (irmp_get_data (&irmp_data))                                     // got IR signal?
-        {
-            display_set_status_led (1, 0, 0);                               // yes, show red status LED
-            delay_sec (1);                                                  // and wait 1 second
-            (void) irmp_get_data (&irmp_data);                              // flush input of IRMP now
-            display_set_status_led (0, 0, 0);                               // and switch status LED off
+            tm.tm_sec       = 0;
+            display_flag    = DISPLAY_FLAG_UPDATE_ALL;
+            time_changed    = 1;
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_HOUR:                              // increment hour
+        {
+            softclock_get_tm (&tm);
 
-            log_msg ("calling IR learn function");
-            if (remote_ir_learn ())                                         // learn IR commands
-            {
-                remote_ir_write_codes_to_eeprom ();                         // if successful, save them in EEPROM
+            if (tm.tm_hour < 23)
+            {
+                 tm.tm_hour++;
+            }
+            else
+            {
+                tm.tm_hour =  0;
             }
-            break;                                                          // and break the loop
-        }
-    }
-#endif
 
-    display_set_status_led (0, 0, 0);                                       // switch off status LED
+            tm.tm_sec       = 0;
+            display_flag    = DISPLAY_FLAG_UPDATE_ALL;
+            time_changed    = 1;
+            break;
+        }
+
+        case REMOTE_IR_CMD_DECREMENT_MINUTE:                            // decrement minute
+        {
+            softclock_get_tm (&tm);
 
-    esp8266_init ();
-    esp8266_infop = esp8266_get_info ();
+            if (tm.tm_min > 0)
+            {
+                tm.tm_min--;
+            }
+            else
+            {
+                tm.tm_min = 59;
+            }
 
-    while (1)
-    {
-        if (! ap_mode && esp8266_is_up && button_pressed ())                // if user pressed user button, set ESP8266 to AP mode
-        {
-            ap_mode = 1;
-            log_msg ("user button pressed: configuring esp8266 as access point");
-            esp8266_is_online = 0;
-            esp8266_infop->is_online = 0;
-            esp8266_infop->ipaddress[0] = '\0';
-            esp8266_accesspoint ("wordclock", "1234567890");
-        }
+            tm.tm_sec       = 0;
+            display_flag    = DISPLAY_FLAG_UPDATE_ALL;
+            time_changed    = 1;
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_MINUTE:                            // increment minute
+        {
+            softclock_get_tm (&tm);
+
+            if (tm.tm_min < 59)
+            {
+                tm.tm_min++;
+            }
+            else
+            {
+                tm.tm_min = 0;
+            }
 
+            tm.tm_sec       = 0;
+            display_flag    = DISPLAY_FLAG_UPDATE_ALL;
+            time_changed    = 1;
+            break;
+        }
+
+        case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_RED:                    // decrement red brightness
+        {
+            display_decrement_color_red ();
+            display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_RED:                    // increment red brightness
+        {
+            display_increment_color_red ();
+            display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
+            break;
+        }
+
+        case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_GREEN:                  // decrement green brightness
+        {
+            display_decrement_color_green ();
+            display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_GREEN:                  // increment green brightness
+        {
+            display_increment_color_green ();
+            display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
+            break;
+        }
+
+        case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_BLUE:                   // decrement blue brightness
+        {
+            display_decrement_color_blue ();
+            display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_BLUE:                   // increment blue brightness
+        {
+            display_increment_color_blue ();
+            display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
+            break;
+        }
 
-        if (status_led_cnt)
+        case REMOTE_IR_CMD_AUTO_BRIGHTNESS_CONTROL:                     // toggle auto brightness
         {
-            status_led_cnt--;
+            auto_brightness = ! auto_brightness;
+            last_ldr_value = 0xFF;
+            display_set_automatic_brightness_control (auto_brightness);
+            break;
+        }
 
-            if (! status_led_cnt)
+        case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS:                        // decrement brightness
+        {
+            if (auto_brightness)
             {
-                display_set_status_led (0, 0, 0);
+                auto_brightness = 0;
+                last_ldr_value = 0xFF;
+                display_set_automatic_brightness_control (auto_brightness);
+            }
+
+            display_decrement_brightness ();
+            break;
+        }
+
+        case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS:                        // increment brightness
+        {
+            if (auto_brightness)
+            {
+                auto_brightness = 0;
+                last_ldr_value = 0xFF;
+                display_set_automatic_brightness_control (auto_brightness);
             }
-        }
 
-        if ((code = listener (&lis)) != 0)
+            display_increment_brightness ();
+            break;
+        }
+
+        case REMOTE_IR_CMD_GET_TEMPERATURE:                             // get temperature
         {
-            display_set_status_led (1, 0, 0);                               // got net command, light red status LED
-            status_led_cnt = STATUS_LED_FLASH_TIME;
+            show_temperature    = 1;
+            break;
+        }
 
-            switch (code)
-            {
-                case LISTENER_SET_COLOR_CODE:                               // set color
-                {
-                    display_set_colors (&(lis.rgb));
-                    log_printf ("command: set colors to %d %d %d\r\n", lis.rgb.red, lis.rgb.green, lis.rgb.blue);
-                    break;
-                }
+        default:
+        {
+            break;
+        }
+    }
 
-                case LISTENER_POWER_CODE:                                   // power on/off
-                {
-                    if (power_is_on != lis.power)
-                    {
-                        power_is_on = lis.power;
-                        display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                        log_msg ("command: set power");
-                    }
-                    break;
-                }
+    if (time_changed)
+    {
+        report_time (TIMESOURCE_MANUAL, &tm, 0);
+    }
+}
+#endif // SAVE_RAM == 0
 
-                case LISTENER_DISPLAY_MODE_CODE:                            // set display mode
-                {
-                    if (display_mode != lis.mode)
-                    {
-                        display_mode = display_set_display_mode (lis.mode);
-                        display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                        log_printf ("command: set display mode to %d\r\n", display_mode);
-                    }
-                    break;
-                }
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: handle net commands, esp8266 state and net time requests
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+listener_task (void)
+{
+    LISTENER_DATA   lis;
+    uint_fast8_t    code;
 
-                case LISTENER_ANIMATION_MODE_CODE:                          // set animation mode
-                {
-                    if (animation_mode != lis.mode)
-                    {
-                        animation_mode = display_set_animation_mode (lis.mode);
-                        animation_flag = 0;
-                        display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                        log_printf ("command: set animation mode to %d\r\n", animation_flag);
-                    }
-                    break;
-                }
+    if (! ap_mode && esp8266_is_up && button_pressed ())                // if user pressed user button, set ESP8266 to AP mode
+    {
+        ap_mode = 1;
+        log_msg ("user button pressed: configuring esp8266 as access point");
+        esp8266_is_online = 0;
+        esp8266_infop->is_online = 0;
+        esp8266_infop->ipaddress[0] = '\0';
+        esp8266_accesspoint ("wordclock", "1234567890");
+    }
 
-                case LISTENER_DISPLAY_TEMPERATURE_CODE:                     // set animation mode
-                {
-                    show_temperature = 1;
-                    log_msg ("command: show temperature");
-                    break;
-                }
+    if ((code = listener (&lis)) != 0)
+    {
+        display_set_status_led (1, 0, 0);                               // got net command, light red status LED
+        timer_restart (status_led_timer);
 
-                case LISTENER_SET_BRIGHTNESS_CODE:                          // set brightness
-                {
-                    if (auto_brightness)
-                    {
-                        auto_brightness = 0;
-                        last_ldr_value = 0xFF;
-                        display_set_automatic_brightness_control (auto_brightness);
-                    }
-                    display_set_brightness (lis.brightness);
-                    display_flag = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                    log_printf ("command: set brightness to %d, disable autmomatic brightness control per LDR\r\n", lis.brightness);
-                    break;
-                }
+        switch (code)
+        {
+            case LISTENER_SET_COLOR_CODE:                               // set color
+            {
+                display_set_colors (&(lis.rgb));
+                log_printf ("command: set colors to %d %d %d\r\n", lis.rgb.red, lis.rgb.green, lis.rgb.blue);
+                break;
+            }
 
-                case LISTENER_SET_AUTOMATIC_BRIHGHTNESS_CODE:               // automatic brightness control on/off
+            case LISTENER_POWER_CODE:                                   // power on/off
+            {
+                if (power_is_on != lis.power)
                 {
-                    if (lis.automatic_brightness_control)
-                    {
-                        auto_brightness = 1;
-                        log_msg ("command: enable automatic brightness control");
-                    }
-                    else
-                    {
-                        auto_brightness = 0;
-                        log_msg ("command: disable automatic brightness control");
-                    }
-
-                    last_ldr_value = 0xFF;
-                    display_set_automatic_brightness_control (auto_brightness);
-                    break;
+                    power_is_on = lis.power;
+                    display_flag = DISPLAY_FLAG_UPDATE_ALL;
+                    log_msg ("command: set power");
                 }
+                break;
+            }
 
-                case LISTENER_TEST_DISPLAY_CODE:                            // test display
+            case LISTENER_DISPLAY_MODE_CODE:                            // set display mode
+            {
+                if (display_mode != lis.mode)
                 {
-                    log_msg ("command: start display test");
-                    display_test ();
-                    break;
+                    display_mode = display_set_display_mode (lis.mode);
+                    display_flag = DISPLAY_FLAG_UPDATE_ALL;
+                    log_printf ("command: set display mode to %d\r\n", display_mode);
                 }
+                break;
+            }
 
-                case LISTENER_SET_DATE_TIME_CODE:                           // set date/time
+            case LISTENER_ANIMATION_MODE_CODE:                          // set animation mode
+            {
+                if (animation_mode != lis.mode)
                 {
-                    if (rtc_is_up)
-                    {
-                        rtc_set_date_time (&(lis.tm));
-                    }
-
-                    if (hour != (uint_fast8_t) lis.tm.tm_hour || minute != (uint_fast8_t) lis.tm.tm_min)
-                    {
-                        display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                    }
-
-                    wday   = lis.tm.tm_wday;
-                    hour   = lis.tm.tm_hour;
-                    minute = lis.tm.tm_min;
-                    second = lis.tm.tm_sec;
-
-                    log_printf ("command: set time to %s %4d-%02d-%02d %02d:%02d:%02d\r\n",
-                                wdays_en[lis.tm.tm_wday], lis.tm.tm_year + 1900, lis.tm.tm_mon + 1, lis.tm.tm_mday,
-                                lis.tm.tm_hour, lis.tm.tm_min, lis.tm.tm_sec);
-                    break;
+                    animation_mode = display_set_animation_mode (lis.mode);
+                    display_flag = DISPLAY_FLAG_UPDATE_ALL;
+                    log_printf ("command: set animation mode to %d\r\n", animation_mode);
                 }
+                break;
+            }
+
+            case LISTENER_DISPLAY_TEMPERATURE_CODE:                     // set animation mode
+            {
+                show_temperature = 1;
+                log_msg ("command: show temperature");
+                break;
+            }
 
-                case LISTENER_GET_NET_TIME_CODE:                            // get net time
+            case LISTENER_SET_BRIGHTNESS_CODE:                          // set brightness
+            {
+                if (auto_brightness)
                 {
-                    net_time_flag = 1;
-                    log_msg ("command: start net time request");
-                    break;
+                    auto_brightness = 0;
+                    last_ldr_value = 0xFF;
+                    display_set_automatic_brightness_control (auto_brightness);
                 }
+                display_set_brightness (lis.brightness);
+                log_printf ("command: set brightness to %d, disable autmomatic brightness control per LDR\r\n", lis.brightness);
+                break;
+            }
 
-                case LISTENER_IR_LEARN_CODE:                                // IR learn
+            case LISTENER_SET_AUTOMATIC_BRIHGHTNESS_CODE:               // automatic brightness control on/off
+            {
+                if (lis.automatic_brightness_control)
                 {
-#if SAVE_RAM == 0
-                    log_msg ("command: learn IR codes");
-
-                    if (remote_ir_learn ())
-                    {
-                        remote_ir_write_codes_to_eeprom ();
-                    }
-#endif
-                    break;
+                    auto_brightness = 1;
+                    log_msg ("command: enable automatic brightness control");
                 }
-
-                case LISTENER_SAVE_DISPLAY_CONFIGURATION:                   // save display configuration
+                else
                 {
-                    display_write_config_to_eeprom ();
-                    log_msg ("command: save display settings");
-                    break;
+                    auto_brightness = 0;
+                    log_msg ("command: disable automatic brightness control");
                 }
-            }
-        }
 
-        if (auto_brightness && ldr_poll_brightness (&ldr_value))
-        {
-            if (ldr_value + 1 < last_ldr_value || ldr_value > last_ldr_value + 1)           // difference greater than 2
-            {
-                log_printf ("ldr: old brightnes: %d new brightness: %d\r\n", last_ldr_value, ldr_value);
-                last_ldr_value = ldr_value;
-                display_set_brightness (ldr_value);
-                display_flag = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
+                last_ldr_value = 0xFF;
+                display_set_automatic_brightness_control (auto_brightness);
+                break;
             }
-        }
 
-        if (!esp8266_is_up)                                                 // esp8266 up yet?
-        {
-            if (esp8266_infop->is_up)
+            case LISTENER_TEST_DISPLAY_CODE:                            // test display
             {
-                esp8266_is_up = 1;
-                log_msg ("esp8266 now up");
+                log_msg ("command: start display test");
+                display_test ();
+                break;
             }
-        }
-        else
-        {                                                                   // esp8266 is up...
-            if (! esp8266_is_online)                                        // but not online yet...
-            {
-                if (esp8266_infop->is_online)                               // now online?
-                {
-                    char buf[32];
-                    esp8266_is_online = 1;
 
-                    log_msg ("esp8266 now online");
-                    sprintf (buf, "  IP %s", esp8266_infop->ipaddress);
-                    display_banner (buf);
-                    display_flag = DISPLAY_FLAG_UPDATE_ALL;
+            case LISTENER_SET_DATE_TIME_CODE:                           // set date/time
+            {
+                report_time (TIMESOURCE_MANUAL, &(lis.tm), 0);
 
-                    net_time_flag = 1;
-                }
+                log_printf ("command: set time to %s %4d-%02d-%02d %02d:%02d:%02d\r\n",
+                            wdays_en[lis.tm.tm_wday], lis.tm.tm_year + 1900, lis.tm.tm_mon + 1, lis.tm.tm_mday,
+                            lis.tm.tm_hour, lis.tm.tm_min, lis.tm.tm_sec);
+                break;
             }
-        }
 
-        if (dcf77_time(&tm))
-        {
-            display_set_status_led (1, 1, 0);                       // got DCF77 time, light yellow = green + red LED
+            case LISTENER_NET_TIME_CODE:                                // got net time
+            {
+                report_time (TIMESOURCE_NET, &(lis.tm), 0);
 
-            status_led_cnt = 50;
+                log_printf ("net time: %s %4d-%02d-%02d %02d:%02d:%02d\r\n",
+                            wdays_en[lis.tm.tm_wday], lis.tm.tm_year + 1900, lis.tm.tm_mon + 1, lis.tm.tm_mday,
+                            lis.tm.tm_hour, lis.tm.tm_min, lis.tm.tm_sec);
+                break;
+            }
 
-            if (rtc_is_up)
+            case LISTENER_GET_NET_TIME_CODE:                            // get net time
             {
-                rtc_set_date_time (&tm);
+                net_time_flag = 1;
+                log_msg ("command: start net time request");
+                break;
             }
 
-            if (hour != (uint_fast8_t) tm.tm_hour || minute != (uint_fast8_t) tm.tm_min)
+            case LISTENER_IR_LEARN_CODE:                                // IR learn
             {
-                display_flag = DISPLAY_FLAG_UPDATE_ALL;
+#if SAVE_RAM == 0
+                log_msg ("command: learn IR codes");
+                ir_learn_start ();
+#endif
+                break;
             }
 
-            wday        = tm.tm_wday;
-            hour        = tm.tm_hour;
-            minute      = tm.tm_min;
-            second      = tm.tm_sec;
-
-            log_printf ("dcf77: %s %4d-%02d-%02d %02d:%02d:%02d\r\n",
-                         wdays_en[tm.tm_wday], tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+            case LISTENER_SAVE_DISPLAY_CONFIGURATION:                   // save display configuration
+            {
+                display_write_config_to_eeprom ();
+                log_msg ("command: save display settings");
+                break;
+            }
         }
+    }
 
-        if (ds3231_flag)
+    if (!esp8266_is_up)                                                 // esp8266 up yet?
+    {
+        if (esp8266_infop->is_up)
+        {
+            esp8266_is_up = 1;
+            log_msg ("esp8266 now up");
+        }
+    }
+    else
+    {                                                                   // esp8266 is up...
+        if (! esp8266_is_online)                                        // but not online yet...
         {
-            if (rtc_is_up && rtc_get_date_time (&tm))
+            if (esp8266_infop->is_online)                               // now online?
             {
-                if (hour != (uint_fast8_t) tm.tm_hour || minute != (uint_fast8_t) tm.tm_min)
-                {
-                    display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                }
+                char buf[32];
+                esp8266_is_online = 1;
 
-                wday        = tm.tm_wday;
-                hour        = tm.tm_hour;
-                minute      = tm.tm_min;
-                second      = tm.tm_sec;
+                log_msg ("esp8266 now online");
+                sprintf (buf, "  IP %s", esp8266_infop->ipaddress);
+                display_banner (buf);
+                display_flag = DISPLAY_FLAG_UPDATE_ALL;
 
-                log_printf ("read rtc: %s %4d-%02d-%02d %02d:%02d:%02d\r\n",
-                             wdays_en[tm.tm_wday], tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+                net_time_flag = 1;
             }
-
-            ds3231_flag = 0;
         }
+    }
 
-        if (auto_brightness && ldr_conversion_flag)
+    if (net_time_flag)
+    {
+        if (esp8266_infop->is_online)
         {
-            ldr_start_conversion ();
-            ldr_conversion_flag = 0;
+            display_set_status_led (0, 0, 1);                       // light blue status LED
+            timer_restart (status_led_timer);
+            timeserver_start_timeserver_request ();                 // start a timeserver request, answer follows...
         }
 
-        if (net_time_flag)
-        {
-            if (esp8266_infop->is_online)
-            {
-                display_set_status_led (0, 0, 1);                       // light blue status LED
-                status_led_cnt = STATUS_LED_FLASH_TIME;
-                timeserver_start_timeserver_request ();                 // start a timeserver request, answer follows...
-            }
-
-            net_time_flag = 0;
-            net_time_countdown = 3800;                                  // next net time after 3800 sec
-        }
+        net_time_flag = 0;
+        timer_restart (net_time_timer);                             // next net time after 3800 sec
+    }
+}
 
-        if (show_time_flag)                                             // set every full minute
-        {
-#if WCLOCK24H == 1
-            display_flag = DISPLAY_FLAG_UPDATE_ALL;
-#else
-            if (minute % 5)
-            {
-                display_flag = DISPLAY_FLAG_UPDATE_MINUTES;             // only update minute LEDs
-            }
-            else
-            {
-                display_flag = DISPLAY_FLAG_UPDATE_ALL;
-            }
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: show temperature and refresh display if time or mode changed
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+display_task (void)
+{
+#if SAVE_RAM == 0
+    if (ir_learn_active)                                                    // IR learn function shows its banners
+    {
+        return;
+    }
 #endif
-            show_time_flag = 0;
-        }
 
-        if (power_is_on == night_power_is_on && night_check_night_times (power_is_on, wday, hour * 60 + minute))
+    if (temperature_stop_time)                                              // WC24H: temperature is shown, don't update display
+    {
+        if (softclock_get_uptime () < temperature_stop_time)
         {
-            power_is_on         = ! power_is_on;
-            night_power_is_on   = ! night_power_is_on;
-            display_flag        = DISPLAY_FLAG_UPDATE_ALL;
-            log_printf ("Found Timer: %s at %02d:%02d\r\n", power_is_on ? "on" : "off", hour, minute);
+            return;
         }
 
-        if (show_temperature)
-        {
-            uint_fast8_t temperature_index;
+        temperature_stop_time = 0;
+        display_flag = DISPLAY_FLAG_UPDATE_ALL;                             // force update
+    }
 
-            show_temperature = 0;
+    if (show_temperature)
+    {
+        uint_fast8_t temperature_index;
 
-            if (ds18xx_is_up)
-            {
-                short_isr = 1;
+        if (ds18xx_is_up && temp_read_temp_index () != TEMP_INVALID)       // cached by temp_task()
+        {
+            temperature_index = temp_read_temp_index ();
+            log_printf ("got temperature from DS18xxx: %d%s\r\n", temperature_index / 2, (temperature_index % 2) ? ".5" : "");
+        }
+        else if (rtc_is_up)
+        {
+            temperature_index = rtc_get_temperature_index ();
+            log_printf ("got temperature from RTC: %d%s\r\n", temperature_index / 2, (temperature_index % 2) ? ".5" : "");
+        }
+        else
+        {
+            temperature_index = 0xFF;
+            log_msg ("no temperature available");
+        }
+
+        show_temperature = 0;
+
+        if (temperature_index != 0xFF)
+        {
+            display_temperature (power_is_on, temperature_index);
+
+#if WCLOCK24H == 1                                                      // WC24H shows temperature with animation, WC12H rolls itself
+            temperature_stop_time = softclock_get_uptime () + TEMPERATURE_SHOW_TIME;  // show it for 5 seconds, animation goes on
+#else
+            display_flag = DISPLAY_FLAG_UPDATE_ALL;                         // force update
+#endif
+        }
+    }
+
+    if (display_flag)                                                   // refresh display (time/mode changed)
+    {
+        struct tm   tm;
+
+        log_msg ("update display");
+        softclock_get_tm (&tm);
+
+#if WCLOCK24H == 1
+        if (display_mode == MODES_COUNT - 1)                            // temperature
+        {
+            uint_fast8_t temperature_index;
+
+            if (ds18xx_is_up && temp_read_temp_index () != TEMP_INVALID)   // cached by temp_task()
+            {
                 temperature_index = temp_read_temp_index ();
-                short_isr = 0;
                 log_printf ("got temperature from DS18xxx: %d%s\r\n", temperature_index / 2, (temperature_index % 2) ? ".5" : "");
             }
             else if (rtc_is_up)
@@ -880,336 +1116,373 @@ main ()
             }
             else
             {
-                temperature_index = 0xFF;
+                temperature_index = 0x00;
                 log_msg ("no temperature available");
             }
 
-            if (temperature_index != 0xFF)
-            {
-                display_temperature (power_is_on, temperature_index);
+            display_clock (power_is_on, 0, temperature_index - 20, display_flag);    // show new time
+        }
+        else
+        {
+            display_clock (power_is_on, tm.tm_hour, tm.tm_min, display_flag);  // show new time
+        }
+#else
+        display_clock (power_is_on, tm.tm_hour, tm.tm_min, display_flag);      // show new time
+#endif
+        display_flag = DISPLAY_FLAG_NONE;
 
-#if WCLOCK24H == 1                                                          // WC24H shows temperature with animation, WC12H rolls itself
-                uint32_t    stop_time;
+        if (! first_frame_ms)                                           // boot time: timer_ms starts in timers_init()
+        {
+            first_frame_ms = timer_ms;
+            log_printf ("boot: first frame after %lu ms\r\n", (unsigned long) first_frame_ms);
+        }
+    }
+}
 
-                stop_time = uptime + 5;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: filter LDR value, set brightness if step of LDR has changed
+ *
+ * ldr.c filters and has a hysteresis in its LDR_BRIGHTNESS_STEPS steps, so every change is taken. The step is passed
+ * to the display without reducing it to MAX_BRIGHTNESS levels, display_animation() ramps to the new brightness, the
+ * display content does not change.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+ldr_task (void)
+{
+    uint_fast8_t    ldr_value;
 
-                while (uptime < stop_time)
-                {
-                    if (animation_flag)
-                    {
-                        animation_flag = 0;
-                        display_animation ();
-                    }
-                }
+    if (ldr_poll_brightness (&ldr_value) && auto_brightness && ldr_value != last_ldr_value)   // filter runs always
+    {
+        log_printf ("ldr: new brightness step: %d of %d\r\n", ldr_value, LDR_BRIGHTNESS_STEPS);
+        last_ldr_value = ldr_value;
+        display_set_brightness_step (ldr_value, LDR_BRIGHTNESS_STEPS);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: read DS18xx temperature in background, see temp_poll()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+temp_task (void)
+{
+    if (ds18xx_is_up)
+    {
+#if ONE_WIRE_USE_USART == 1                                                 // USART generates timing of onewire
+        temp_poll ();
+#else
+        short_isr = 1;                                                      // don't disturb timing of onewire
+        temp_poll ();
+        short_isr = 0;
 #endif
-                display_flag = DISPLAY_FLAG_UPDATE_ALL;                     // force update
-            }
-        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: write changed settings to EEPROM in background, see eeprom_poll()
+ *
+ * Erasing the internal flash stalls the CPU with interrupts for up to 500 ms. TIM2 has counted on, but only one of its
+ * interrupts is pending afterwards, so the lost ticks of the soft clock and the timer wheel are caught up here.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+eeprom_task (void)
+{
+    uint32_t    stall_ms;
+
+    eeprom_poll ();
+
+    stall_ms = flash_eeprom_get_stall_ms ();
+
+    if (stall_ms > 1)
+    {
+        log_printf ("eeprom: flash erase stalled cpu for %lu ms, catching up\r\n", (unsigned long) stall_ms);
 
-        if (display_flag)                                                   // refresh display (time/mode changed)
+        while (--stall_ms > 0)                                              // one tick has been run by pending interrupt
         {
-            log_msg ("update display");
+            __disable_irq();
+            softclock_isr_tick ();
+            timer_isr_tick (1);                                             // ISR callbacks are run by next TIM2 interrupt
+            __enable_irq();
+        }
+    }
+}
 
-#if WCLOCK24H == 1
-            if (display_mode == MODES_COUNT - 1)                            // temperature
-            {
-                uint_fast8_t temperature_index;
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: update time on display and check night timers, runs every full minute
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+night_task (void)
+{
+    struct tm   tm;
 
-                if (ds18xx_is_up)
-                {
-                    short_isr = 1;
-                    temperature_index = temp_read_temp_index ();
-                    short_isr = 0;
-                    log_printf ("got temperature from DS18xxx: %d%s\r\n", temperature_index / 2, (temperature_index % 2) ? ".5" : "");
-                }
-                else if (rtc_is_up)
-                {
-                    temperature_index = rtc_get_temperature_index ();
-                    log_printf ("got temperature from RTC: %d%s\r\n", temperature_index / 2, (temperature_index % 2) ? ".5" : "");
-                }
-                else
-                {
-                    temperature_index = 0x00;
-                    log_msg ("no temperature available");
-                }
+    softclock_get_tm (&tm);
 
-                display_clock (power_is_on, 0, temperature_index - 20, display_flag);    // show new time
-            }
-            else
-            {
-                display_clock (power_is_on, hour, minute, display_flag);    // show new time
-            }
+#if WCLOCK24H == 1
+    display_flag = DISPLAY_FLAG_UPDATE_ALL;
 #else
-            display_clock (power_is_on, hour, minute, display_flag);        // show new time
+    if (tm.tm_min % 5)
+    {
+        display_flag = DISPLAY_FLAG_UPDATE_MINUTES;             // only update minute LEDs
+    }
+    else
+    {
+        display_flag = DISPLAY_FLAG_UPDATE_ALL;
+    }
 #endif
-            display_flag = DISPLAY_FLAG_NONE;
-        }
-
-        if (animation_flag)
-        {
-            animation_flag = 0;
-            display_animation ();
-        }
 
-        if (dcf77_flag)
+    if (power_is_on == night_power_is_on && night_check_night_times (power_is_on, tm.tm_wday, tm.tm_hour * 60 + tm.tm_min))
+    {
+        power_is_on         = ! power_is_on;
+        night_power_is_on   = ! night_power_is_on;
+        display_flag        = DISPLAY_FLAG_UPDATE_ALL;
+        log_printf ("Found Timer: %s at %02d:%02d\r\n", power_is_on ? "on" : "off", tm.tm_hour, tm.tm_min);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * task: read date/time from RTC DS3231
+ *
+ * At boot the soft clock is set from the RTC. Later on the soft clock runs on its own, the RTC is only used as a
+ * reference for the soft clock discipline, see timesource_report(). If the RTC is rejected because the soft clock
+ * is better, the RTC is set again. If the soft clock gets its second tick from the 1Hz square wave of the DS3231,
+ * no check is needed after the first edge.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+rtc_task (void)
+{
+    static uint_fast8_t sqw_synced;
+    struct tm           tm;
+
+    if (! softclock_sqw_is_active ())
+    {
+        sqw_synced = 0;
+    }
+    else if (sqw_synced)                                                    // second tick comes from RTC, nothing to check
+    {
+        return;
+    }
+
+    if (rtc_is_up && rtc_get_date_time (&tm))
+    {
+        log_printf ("read rtc: %s %4d-%02d-%02d %02d:%02d:%02d\r\n",
+                     wdays_en[tm.tm_wday], tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+        if (report_time (TIMESOURCE_RTC, &tm, 0) == TIMESOURCE_REJECTED)   // soft clock is better, RTC is wrong
         {
-            dcf77_flag = 0;
-            dcf77_tick ();
+            softclock_get_tm (&tm);
+            rtc_set_date_time (&tm);
+            log_msg ("rtc: set to soft clock");
         }
 
+        sqw_synced = softclock_sqw_is_active ();                            // called just after first SQW edge, see softclock_sqw_isr()
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * register tasks, see also process_events()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+tasks_init (void)
+{
+    sched_init ();
+
+    dcf77_task_id       = sched_add_task ("dcf77",     dcf77_task,     0, DCF77_PERIOD_MS,      SCHED_FLAG_NONE);
+    animation_task_id   = sched_add_task ("animation", animation_task, 1, ANIMATION_PERIOD_MS,  SCHED_FLAG_NONE);
 #if SAVE_RAM == 0
-        cmd = remote_ir_get_cmd ();                                         // get IR command
-
-        if (cmd != REMOTE_IR_CMD_INVALID)                                   // got IR command, light green LED
-        {
-            display_set_status_led (1, 0, 0);
-            status_led_cnt = STATUS_LED_FLASH_TIME;
-        }
+    ir_task_id          = sched_add_task ("ir",        ir_task,        2, IR_DEADLINE_MS,       SCHED_FLAG_POLL);
+#endif
+    listener_task_id    = sched_add_task ("listener",  listener_task,  3, LISTENER_DEADLINE_MS, SCHED_FLAG_POLL);
+    display_task_id     = sched_add_task ("display",   display_task,   4, DISPLAY_DEADLINE_MS,  SCHED_FLAG_POLL);
+    ldr_task_id         = sched_add_task ("ldr",       ldr_task,       5, LDR_PERIOD_MS,        SCHED_FLAG_NONE);
+    night_task_id       = sched_add_task ("night",     night_task,     6, CLOCK_PERIOD_MS,      SCHED_FLAG_NONE);
+    rtc_task_id         = sched_add_task ("rtc",       rtc_task,       7, CLOCK_PERIOD_MS,      SCHED_FLAG_NONE);
+    temp_task_id        = sched_add_task ("temp",      temp_task,      8, TEMP_DEADLINE_MS,     SCHED_FLAG_POLL);
+    eeprom_task_id      = sched_add_task ("eeprom",    eeprom_task,    9, EEPROM_DEADLINE_MS,   SCHED_FLAG_POLL);
+}
 
-        if (cmd != REMOTE_IR_CMD_INVALID)                                   // if command valid, log command code
-        {
-            switch (cmd)
-            {
-                case REMOTE_IR_CMD_POWER:                         log_msg ("IRMP: POWER key");                  break;
-                case REMOTE_IR_CMD_OK:                            log_msg ("IRMP: OK key");                     break;
-                case REMOTE_IR_CMD_DECREMENT_DISPLAY_MODE:        log_msg ("IRMP: decrement display mode");     break;
-                case REMOTE_IR_CMD_INCREMENT_DISPLAY_MODE:        log_msg ("IRMP: increment display mode");     break;
-                case REMOTE_IR_CMD_DECREMENT_ANIMATION_MODE:      log_msg ("IRMP: decrement animation mode");   break;
-                case REMOTE_IR_CMD_INCREMENT_ANIMATION_MODE:      log_msg ("IRMP: increment animation mode");   break;
-                case REMOTE_IR_CMD_DECREMENT_HOUR:                log_msg ("IRMP: decrement hour");             break;
-                case REMOTE_IR_CMD_INCREMENT_HOUR:                log_msg ("IRMP: increment hour");             break;
-                case REMOTE_IR_CMD_DECREMENT_MINUTE:              log_msg ("IRMP: decrement minute");           break;
-                case REMOTE_IR_CMD_INCREMENT_MINUTE:              log_msg ("IRMP: increment minute");           break;
-                case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_RED:      log_msg ("IRMP: decrement red brightness");   break;
-                case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_RED:      log_msg ("IRMP: increment red brightness");   break;
-                case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_GREEN:    log_msg ("IRMP: decrement green brightness"); break;
-                case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_GREEN:    log_msg ("IRMP: increment green brightness"); break;
-                case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_BLUE:     log_msg ("IRMP: decrement blue brightness");  break;
-                case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_BLUE:     log_msg ("IRMP: increment blue brightness");  break;
-                case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS:          log_msg ("IRMP: decrement brightness");       break;
-                case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS:          log_msg ("IRMP: increment brightness");       break;
-                case REMOTE_IR_CMD_GET_TEMPERATURE:               log_msg ("IRMP: get temperature");            break;
-            }
-        }
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * main function
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+int
+main ()
+{
+#if SAVE_RAM == 0
+    IRMP_DATA               irmp_data;
+    uint32_t                stop_time;
+#endif
+    uint32_t                eeprom_cycles;
 
-        switch (cmd)
-        {
-            case REMOTE_IR_CMD_POWER:
-            {
-                power_is_on = ! power_is_on;
+    SystemInit ();
+    SystemCoreClockUpdate();                                                // needed for Nucleo board
 
-                display_flag        = DISPLAY_FLAG_UPDATE_ALL;
-                break;
-            }
+#if defined (STM32F103)                                                     // disable JTAG to get back PB3, PB4, PA13, PA14, PA15
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_AFIO, ENABLE);                    // turn on clock for the alternate function register
+    GPIO_PinRemapConfig(GPIO_Remap_SWJ_JTAGDisable, ENABLE);                // disable the JTAG, enable the SWJ interface
+#endif
 
-            case REMOTE_IR_CMD_OK:
-            {
-                display_write_config_to_eeprom ();
-                break;
-            }
+    log_init ();                                                            // initilize logger on uart
 
-            case REMOTE_IR_CMD_DECREMENT_DISPLAY_MODE:                      // decrement display mode
-            {
-                display_mode = display_decrement_display_mode ();
-                display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_DISPLAY_MODE:                      // increment display mode
-            {
-                display_mode = display_increment_display_mode ();
-                display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                break;
-            }
-
-            case REMOTE_IR_CMD_DECREMENT_ANIMATION_MODE:                    // decrement display mode
-            {
-                animation_mode = display_decrement_animation_mode ();
-                display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_ANIMATION_MODE:                    // increment display mode
-            {
-                animation_mode = display_increment_animation_mode ();
-                display_flag = DISPLAY_FLAG_UPDATE_ALL;
-                break;
-            }
-
-            case REMOTE_IR_CMD_DECREMENT_HOUR:                              // decrement hour
-            {
-                if (hour > 0)
-                {
-                    hour--;
-                }
-                else
-                {
-                    hour = 23;
-                }
+#if SAVE_RAM == 0
+    irmp_init ();                                                           // initialize IRMP
+    ir_capture_init ();                                                     // initialize EXTI and timestamp timer for IRMP
+#endif
+    timers_init ();                                                         // initialize soft clock and timer wheel for DCF77, EEPROM etc.
+    tasks_init ();                                                          // initialize scheduler tasks
+    timer2_init ();                                                         // initialize timer2 for IRMP and timer wheel
+    delay_init (DELAY_RESOLUTION_1_US);                                     // initialize delay functions with granularity of 1 us
+    board_led_init ();                                                      // initialize GPIO for green LED on disco or nucleo board
+    button_init ();                                                         // initialize GPIO for user button on disco or nucleo board
+    rtc_set_sqw_callback_ptr (softclock_sqw_isr);                           // 1Hz square wave of DS3231 is second tick of soft clock
+    rtc_init ();                                                            // initialize I2C RTC
+    eeprom_cycles = delay_get_cycles ();
+    eeprom_init ();                                                         // initialize I2C EEPROM, read configuration into RAM
+    eeprom_cycles = delay_get_cycles () - eeprom_cycles;
 
-                second          = 0;
-                display_flag    = DISPLAY_FLAG_UPDATE_ALL;
-                time_changed    = 1;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_HOUR:                              // increment hour
-            {
-                if (hour < 23)
-                {
-                     hour++;
-                }
-                else
-                {
-                    hour =  0;
-                }
-
-                second          = 0;
-                display_flag    = DISPLAY_FLAG_UPDATE_ALL;
-                time_changed    = 1;
-                break;
-            }
-
-            case REMOTE_IR_CMD_DECREMENT_MINUTE:                            // decrement minute
-            {
-                if (minute > 0)
-                {
-                    minute--;
-                }
-                else
-                {
-                    minute = 59;
-                }
-
-                second          = 0;
-                display_flag    = DISPLAY_FLAG_UPDATE_ALL;
-                time_changed    = 1;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_MINUTE:                            // increment minute
-            {
-                if (minute < 59)
-                {
-                    minute++;
-                }
-                else
-                {
-                    minute = 0;
-                }
-
-                second          = 0;
-                display_flag    = DISPLAY_FLAG_UPDATE_ALL;
-                time_changed    = 1;
-                break;
-            }
-
-            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_RED:                    // decrement red brightness
-            {
-                display_decrement_color_red ();
-                display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_RED:                    // increment red brightness
-            {
-                display_increment_color_red ();
-                display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
-
-            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_GREEN:                  // decrement green brightness
-            {
-                display_decrement_color_green ();
-                display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_GREEN:                  // increment green brightness
-            {
-                display_increment_color_green ();
-                display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
-
-            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS_BLUE:                   // decrement blue brightness
-            {
-                display_decrement_color_blue ();
-                display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS_BLUE:                   // increment blue brightness
-            {
-                display_increment_color_blue ();
-                display_flag        = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
+    if (button_pressed ())                                                  // set ESP8266 into flash mode
+    {
+        board_led_on ();
+        esp8266_flash ();
+    }
 
-            case REMOTE_IR_CMD_AUTO_BRIGHTNESS_CONTROL:                     // toggle auto brightness
-            {
-                auto_brightness = ! auto_brightness;
-                last_ldr_value = 0xFF;
-                display_set_automatic_brightness_control (auto_brightness);
-                display_flag = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
+    log_msg ("\r\nWelcome to WordClock Logger!");
+    log_msg ("----------------------------");
+    log_str ("Version: ");
+    log_msg (VERSION);
 
-            case REMOTE_IR_CMD_DECREMENT_BRIGHTNESS:                        // decrement brightness
-            {
-                if (auto_brightness)
-                {
-                    auto_brightness = 0;
-                    last_ldr_value = 0xFF;
-                    display_set_automatic_brightness_control (auto_brightness);
-                    display_flag = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                }
+    if (rtc_is_up)
+    {
+        log_msg ("rtc is online");
+    }
+    else
+    {
+        log_msg ("rtc is offline");
+    }
 
-                display_decrement_brightness ();
-                display_flag = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
-
-            case REMOTE_IR_CMD_INCREMENT_BRIGHTNESS:                        // increment brightness
-            {
-                if (auto_brightness)
-                {
-                    auto_brightness = 0;
-                    last_ldr_value = 0xFF;
-                    display_set_automatic_brightness_control (auto_brightness);
-                    display_flag = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                }
+    if (eeprom_is_up)
+    {
+        if (eeprom_get_address ())
+        {
+            log_printf ("eeprom is online, configuration read in %lu usec\r\n", (unsigned long) sched_cycles_to_usec (eeprom_cycles));
+        }
+        else
+        {
+            log_printf ("eeprom is offline, configuration read from internal flash in %lu usec\r\n", (unsigned long) sched_cycles_to_usec (eeprom_cycles));
+        }
+        read_version_from_eeprom ();
+        log_printf ("current eeprom version: 0x%08x\r\n", eeprom_version);
 
-                display_increment_brightness ();
-                display_flag = DISPLAY_FLAG_UPDATE_NO_ANIMATION;
-                break;
-            }
-
-            case REMOTE_IR_CMD_GET_TEMPERATURE:                             // get temperature
+        if ((eeprom_version & 0xFF0000FF) == 0x00000000)
+        {                                                               // Upper and Lower Byte must be 0x00
+            if (eeprom_version >= EEPROM_VERSION_1_5_0)
             {
-                show_temperature    = 1;
-                break;
+#if SAVE_RAM == 0
+                log_msg ("reading ir codes from eeprom");
+                remote_ir_read_codes_from_eeprom ();
+#endif
+                log_msg ("reading display configuration from eeprom");
+                display_read_config_from_eeprom ();
+
+                log_msg ("reading timeserver data from eeprom");
+                timeserver_read_data_from_eeprom ();
             }
 
-            default:
-            {
-                break;
-            }
-        }
-#endif // SAVE_RAM == 0
+            if (eeprom_version >= EEPROM_VERSION_1_7_0)
+            {
+                log_msg ("reading night timers from eeprom");
+                night_read_data_from_eeprom ();
+            }
 
-        if (time_changed)
-        {
-            if (rtc_is_up)
+            if (eeprom_version >= EEPROM_VERSION_1_8_0)
             {
-                tm.tm_hour = hour;
-                tm.tm_min  = minute;
-                tm.tm_sec  = second;
-                rtc_set_date_time (&tm);
+                log_msg ("reading clock drift from eeprom");
+                softclock_read_data_from_eeprom ();
             }
+        }
+    }
+    else
+    {
+        log_msg ("eeprom is offline");
+    }
+
+    ldr_init ();                                                            // initialize LDR (ADC)
+    display_init ();                                                        // initialize display
+
+    dcf77_init ();                                                          // initialize DCF77
+
+    night_init ();                                                          // initialize night time routines
+
+    short_isr = 1;
+    temp_init ();                                                           // initialize DS18xx
+    short_isr = 0;
+
+    display_reset_led_states ();
+    display_mode                = display_get_display_mode ();
+    animation_mode              = display_get_animation_mode ();
+    auto_brightness             = display_get_automatic_brightness_control ();
+
+    if (eeprom_is_up)
+    {
+        if (eeprom_version != EEPROM_VERSION)
+        {
+            log_printf ("updating EEPROM to version 0x%08x\r\n", EEPROM_VERSION);
 
-            time_changed = 0;
+            eeprom_version = EEPROM_VERSION;
+            write_version_to_eeprom ();
+#if SAVE_RAM == 0
+            remote_ir_write_codes_to_eeprom ();
+#endif
+            display_write_config_to_eeprom ();
+            timeserver_write_data_to_eeprom ();
+            night_write_data_to_eeprom ();
+            softclock_write_data_to_eeprom ();
+            eeprom_version = EEPROM_VERSION;
         }
+    }
+
+    sched_set_ready (rtc_task_id);                                          // set soft clock from RTC
+
+#if SAVE_RAM == 0
+    stop_time = softclock_get_uptime () + 3;                                // wait 3 seconds for IR signal...
+    display_set_status_led (1, 1, 1);                                       // show white status LED
+
+    while (softclock_get_uptime () < stop_time)
+    {
+        if (irmp_get_data (&irmp_data))                                     // got IR signal?
+        {
+            display_set_status_led (1, 0, 0);                               // yes, show red status LED
+            delay_sec (1);                                                  // and wait 1 second
+            (void) irmp_get_data (&irmp_data);                              // flush input of IRMP now
+            display_set_status_led (0, 0, 0);                               // and switch status LED off
+
+            log_msg ("starting IR learn function");
+            ir_learn_start ();                                              // learn IR commands in ir task, main loop continues
+            break;                                                          // and break the loop
+        }
+    }
+#endif
+
+    display_set_status_led (0, 0, 0);                                       // switch off status LED
+
+    esp8266_init ();
+    esp8266_infop = esp8266_get_info ();
+
+    event_start ();                                                         // main loop reads events from now on
+
+    while (1)
+    {
+        process_events ();                                                  // handle queued events: set tasks ready
+        sched_run ();                                                       // run ready tasks: dcf77, animation, listener etc.
+
+        if (! sched_is_ready () && ! net_time_flag && (! display_flag || temperature_stop_time))
+        {
+            idle ();                                                        // nothing to do: sleep until next interrupt
+        }
     }
 
     return 0;
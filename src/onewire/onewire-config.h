@@ -12,11 +12,34 @@
 #ifndef ONEWIRE_CONFIG_H
 #define ONEWIRE_CONFIG_H
 
+//-----------------------------------------------------------------------------------------------------------------------------------------------
+// OneWire driver:
+//   0: bit banging on GPIO, timing by delay_usec(), other interrupts must be suppressed meanwhile (see short_isr in main.c)
+//   1: USART in single wire half duplex mode, every bit slot is one UART byte sent and received by DMA, the data pin
+//      is the TX pin of the USART, connect DS18xx there (pull-up 4.7k to 3.3V):
+//        STM32F4x1: USART1 TX=PA9,  DMA2 Stream7 (TX) & Stream5 (RX)
+//        STM32F103: USART3 TX=PB10, DMA1 Channel2 (TX) & Channel3 (RX), Channel2 is used by WS2812: APA102 only
+//-----------------------------------------------------------------------------------------------------------------------------------------------
+#define ONE_WIRE_USE_USART          0                           // change here: 1: USART, 0: bit banging
+
 //-----------------------------------------------------------------------------------------------------------------------------------------------
 // OneWire data pin:
 //-----------------------------------------------------------------------------------------------------------------------------------------------
 
-#if defined (STM32F4XX)
+#if ONE_WIRE_USE_USART == 1
+#  if defined (STM32F4XX)
+#    define ONE_WIRE_PIN            GPIO_Pin_9                  // STM32F411 / F401 Nucleo Board: PA9 = USART1 TX
+#    define ONE_WIRE_PIN_SOURCE     GPIO_PinSource9
+#    define ONE_WIRE_PORT           GPIOA
+#    define ONE_WIRE_CLK_CMD        RCC_AHB1PeriphClockCmd
+#    define ONE_WIRE_CLK            RCC_AHB1Periph_GPIOA
+#  elif defined (STM32F10X)                                     // STM32F103 Mini Development Board: PB10 = USART3 TX
+#    define ONE_WIRE_PIN            GPIO_Pin_10
+#    define ONE_WIRE_PORT           GPIOB
+#    define ONE_WIRE_CLK_CMD        RCC_APB2PeriphClockCmd
+#    define ONE_WIRE_CLK            RCC_APB2Periph_GPIOB
+#  endif
+#elif defined (STM32F4XX)
 #  define ONE_WIRE_PIN              GPIO_Pin_2                  // STM32F411 / F401 Nucleo Board: PD2
 #  define ONE_WIRE_PORT             GPIOD
 #  define ONE_WIRE_CLK_CMD          RCC_AHB1PeriphClockCmd
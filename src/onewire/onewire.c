@@ -13,6 +13,433 @@
 #include "onewire-config.h"
 #include "delay.h"
 
+#if ONE_WIRE_USE_USART == 1
+
+#include "timer.h"
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * USART & DMA: USART1 / DMA2 for STM32F4xx, USART3 / DMA1 for STM32F10X
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#if defined (STM32F4XX)
+// USART:
+#  define ONE_WIRE_USART                USART1
+#  define ONE_WIRE_USART_CLOCK_CMD      RCC_APB2PeriphClockCmd
+#  define ONE_WIRE_USART_CLOCK          RCC_APB2Periph_USART1
+#  define ONE_WIRE_USART_AF             GPIO_AF_USART1
+// DMA USART1 - DMA2, Channel4, Stream7 (TX) & Stream5 (RX)
+#  define ONE_WIRE_DMA_CLOCK_CMD        RCC_AHB1PeriphClockCmd
+#  define ONE_WIRE_DMA_CLOCK            RCC_AHB1Periph_DMA2
+#  define ONE_WIRE_DMA_TX_STREAM        DMA2_Stream7
+#  define ONE_WIRE_DMA_RX_STREAM        DMA2_Stream5
+#  define ONE_WIRE_DMA_CHANNEL          DMA_Channel_4
+#  define ONE_WIRE_DMA_RX_DONE          (DMA_GetFlagStatus (ONE_WIRE_DMA_RX_STREAM, DMA_FLAG_TCIF5) == SET)
+
+#elif defined (STM32F10X)
+#  include "display-config.h"
+#  if DSP_USE_WS2812 == 1
+#    error OneWire USART: DMA1 Channel2 is used by WS2812, use bit banging, see onewire-config.h
+#  endif
+// USART:
+#  define ONE_WIRE_USART                USART3
+#  define ONE_WIRE_USART_CLOCK_CMD      RCC_APB1PeriphClockCmd
+#  define ONE_WIRE_USART_CLOCK          RCC_APB1Periph_USART3
+// DMA USART3 - DMA1, Channel2 (TX) & Channel3 (RX)
+#  define ONE_WIRE_DMA_CLOCK_CMD        RCC_AHBPeriphClockCmd
+#  define ONE_WIRE_DMA_CLOCK            RCC_AHBPeriph_DMA1
+#  define ONE_WIRE_DMA_TX_STREAM        DMA1_Channel2
+#  define ONE_WIRE_DMA_RX_STREAM        DMA1_Channel3
+#  define ONE_WIRE_DMA_RX_DONE          (DMA_GetFlagStatus (DMA1_FLAG_TC3) == SET)
+#endif
+
+#define ONE_WIRE_RESET_BAUDRATE     9600                                // reset: 0xF0 = 520us low, slaves answer in 4 high bits
+#define ONE_WIRE_RESET_BYTE         0xF0
+#define ONE_WIRE_SLOT_BAUDRATE      115200                              // bit slot: 0x00 = 78us low (0), 0xFF = 8.7us low (1 or read)
+#define ONE_WIRE_SLOT_0             0x00
+#define ONE_WIRE_SLOT_1             0xFF
+
+#define ONE_WIRE_TIMEOUT_MS         20                                  // 72 slots need 6.3ms at 115200 Bd
+
+static uint8_t                      onewire_slot_buf[8 * ONEWIRE_MAX_TRANSFER_BYTES];   // one UART byte per bit slot, TX and RX
+static uint32_t                     onewire_start_time;                 // start of transfer, see timer_ms
+static uint_fast8_t                 onewire_busy;                       // flag: transfer running
+static uint_fast8_t                 onewire_ok;                         // flag: last transfer complete, no timeout
+static uint_fast8_t                 onewire_is_reset;                   // flag: transfer is reset with 9600 Bd
+static uint_fast8_t                 onewire_len;                        // number of bytes of last onewire_read_start()
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: set baudrate of USART
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+onewire_set_baudrate (uint32_t baudrate)
+{
+    USART_InitTypeDef   usart;
+
+    USART_Cmd (ONE_WIRE_USART, DISABLE);
+
+    USART_StructInit (&usart);
+    usart.USART_BaudRate            = baudrate;
+    usart.USART_WordLength          = USART_WordLength_8b;
+    usart.USART_StopBits            = USART_StopBits_1;
+    usart.USART_Parity              = USART_Parity_No;
+    usart.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+    usart.USART_Mode                = USART_Mode_Tx | USART_Mode_Rx;
+    USART_Init (ONE_WIRE_USART, &usart);
+
+    USART_HalfDuplexCmd (ONE_WIRE_USART, ENABLE);                       // single wire: RX reads back the TX pin
+    USART_Cmd (ONE_WIRE_USART, ENABLE);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: initialize DMA stream (STM32F4xx) or channel (STM32F10x) for one transfer
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#if defined (STM32F4XX)
+static void
+onewire_dma_init (DMA_Stream_TypeDef * stream, uint32_t dir, uint_fast16_t len)
+#elif defined (STM32F10X)
+static void
+onewire_dma_init (DMA_Channel_TypeDef * stream, uint32_t dir, uint_fast16_t len)
+#endif
+{
+    DMA_InitTypeDef         dma;
+    DMA_StructInit (&dma);
+
+    DMA_Cmd (stream, DISABLE);
+    DMA_DeInit (stream);                                                // clears flags of last transfer
+
+    dma.DMA_Mode                = DMA_Mode_Normal;
+    dma.DMA_PeripheralBaseAddr  = (uint32_t) &ONE_WIRE_USART->DR;
+    dma.DMA_PeripheralDataSize  = DMA_PeripheralDataSize_Byte;
+    dma.DMA_MemoryDataSize      = DMA_MemoryDataSize_Byte;
+    dma.DMA_BufferSize          = len;
+    dma.DMA_PeripheralInc       = DMA_PeripheralInc_Disable;
+    dma.DMA_MemoryInc           = DMA_MemoryInc_Enable;
+    dma.DMA_Priority            = DMA_Priority_High;
+    dma.DMA_DIR                 = dir;
+
+#if defined(STM32F4XX)
+
+    dma.DMA_Channel             = ONE_WIRE_DMA_CHANNEL;
+    dma.DMA_Memory0BaseAddr     = (uint32_t) onewire_slot_buf;
+    dma.DMA_FIFOMode            = DMA_FIFOMode_Disable;
+    dma.DMA_FIFOThreshold       = DMA_FIFOThreshold_HalfFull;
+    dma.DMA_MemoryBurst         = DMA_MemoryBurst_Single;
+    dma.DMA_PeripheralBurst     = DMA_PeripheralBurst_Single;
+
+#elif defined (STM32F10X)
+
+    dma.DMA_M2M                 = DMA_M2M_Disable;
+    dma.DMA_MemoryBaseAddr      = (uint32_t) onewire_slot_buf;
+
+#endif
+
+    DMA_Init (stream, &dma);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: start transfer of len bytes of onewire_slot_buf, the bytes read back are stored in onewire_slot_buf
+ *
+ * The RX DMA overwrites a byte after it has been sent completely, the TX DMA has already fetched it. Interrupts are
+ * not disabled, the USART generates the timing of the bit slots. The function returns at once, see onewire_poll().
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+onewire_transfer_start (uint_fast16_t len)
+{
+#if defined (STM32F4XX)
+    onewire_dma_init (ONE_WIRE_DMA_RX_STREAM, DMA_DIR_PeripheralToMemory, len);
+    onewire_dma_init (ONE_WIRE_DMA_TX_STREAM, DMA_DIR_MemoryToPeripheral, len);
+#elif defined (STM32F10X)
+    onewire_dma_init (ONE_WIRE_DMA_RX_STREAM, DMA_DIR_PeripheralSRC, len);
+    onewire_dma_init (ONE_WIRE_DMA_TX_STREAM, DMA_DIR_PeripheralDST, len);
+#endif
+
+    (void) USART_ReceiveData (ONE_WIRE_USART);                          // discard old byte
+    DMA_Cmd (ONE_WIRE_DMA_RX_STREAM, ENABLE);
+    DMA_Cmd (ONE_WIRE_DMA_TX_STREAM, ENABLE);
+    USART_DMACmd (ONE_WIRE_USART, USART_DMAReq_Rx | USART_DMAReq_Tx, ENABLE);
+
+    onewire_start_time  = timer_ms;
+    onewire_busy        = 1;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_poll () - check if the transfer started by onewire_xxx_start() has finished, returns 1 if done
+ *
+ * Done means: the RX DMA has set its transfer complete flag, or ONE_WIRE_TIMEOUT_MS has elapsed. The result can be
+ * fetched with onewire_reset_result(), onewire_read_bit_result() or onewire_read_result() then.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+onewire_poll (void)
+{
+    if (onewire_busy)
+    {
+        if (ONE_WIRE_DMA_RX_DONE)
+        {
+            onewire_ok = 1;
+        }
+        else if ((uint32_t) (timer_ms - onewire_start_time) > ONE_WIRE_TIMEOUT_MS)  // bus shorted or USART not clocked
+        {
+            onewire_ok = 0;
+        }
+        else
+        {
+            return 0;
+        }
+
+        USART_DMACmd (ONE_WIRE_USART, USART_DMAReq_Rx | USART_DMAReq_Tx, DISABLE);
+        DMA_Cmd (ONE_WIRE_DMA_TX_STREAM, DISABLE);
+        DMA_Cmd (ONE_WIRE_DMA_RX_STREAM, DISABLE);
+
+        if (onewire_is_reset)
+        {
+            onewire_set_baudrate (ONE_WIRE_SLOT_BAUDRATE);
+            onewire_is_reset = 0;
+        }
+
+        onewire_busy = 0;
+    }
+
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: wait until transfer has finished, only used by the blocking functions, e.g. while searching ROM codes at startup
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+onewire_wait (void)
+{
+    while (! onewire_poll ())
+    {
+        ;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_reset_start () - start reset of all slaves, see onewire_poll() and onewire_reset_result()
+ *
+ * Timing:
+ *   Master sends 0xF0 with 9600 Bd: start bit and 4 low bits hold the bus 520us low
+ *   Slave shows presence when it pulls bus low during the 4 high bits, so the master reads back another value than 0xF0
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_reset_start (void)
+{
+    onewire_set_baudrate (ONE_WIRE_RESET_BAUDRATE);
+    onewire_is_reset = 1;
+
+    onewire_slot_buf[0] = ONE_WIRE_RESET_BYTE;
+    onewire_transfer_start (1);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_reset_result () - result of onewire_reset_start(): 1 if one slave is connected
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+onewire_reset_result (void)
+{
+    return (onewire_ok && onewire_slot_buf[0] != ONE_WIRE_RESET_BYTE) ? 1 : 0;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_reset () - reset all slaves, check if one slave is connected
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+onewire_reset (void)
+{
+    onewire_reset_start ();
+    onewire_wait ();
+    return onewire_reset_result ();
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_read_bit_start () - start reading 1 bit, see onewire_poll() and onewire_read_bit_result()
+ *
+ * Timing:
+ *    Master: sends 0xFF, start bit holds bus 8.7us low
+ *    Slave:  Holds Bus Low if bit is 0, so the master reads back another value than 0xFF
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_read_bit_start (void)
+{
+    onewire_slot_buf[0] = ONE_WIRE_SLOT_1;
+    onewire_transfer_start (1);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_read_bit_result () - result of onewire_read_bit_start()
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+onewire_read_bit_result (void)
+{
+    return (onewire_ok && onewire_slot_buf[0] == ONE_WIRE_SLOT_1) ? 1 : 0;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_read_bit () - read 1 bit
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+onewire_read_bit (void)
+{
+    onewire_read_bit_start ();
+    onewire_wait ();
+    return onewire_read_bit_result ();
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_write_bit () - write 1 bit
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_write_bit (uint_fast8_t bit)
+{
+    onewire_slot_buf[0] = bit ? ONE_WIRE_SLOT_1 : ONE_WIRE_SLOT_0;
+    onewire_transfer_start (1);
+    onewire_wait ();
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_read_start () - start reading len bytes, len <= ONEWIRE_MAX_TRANSFER_BYTES, see onewire_read_result()
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_read_start (uint8_t len)
+{
+    memset (onewire_slot_buf, ONE_WIRE_SLOT_1, 8 * len);
+    onewire_len = len;
+    onewire_transfer_start (8 * len);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_read_result () - result of onewire_read_start(), all bits are 0 if the transfer failed
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_read_result (uint8_t * value)
+{
+    uint_fast8_t    idx;
+    uint_fast8_t    bit;
+    uint8_t         byte;
+
+    for (idx = 0; idx < onewire_len; idx++)
+    {
+        byte = 0;
+
+        for (bit = 0; bit < 8; bit++)                                   // LSB first
+        {
+            if (onewire_ok && onewire_slot_buf[8 * idx + bit] == ONE_WIRE_SLOT_1)
+            {
+                byte |= 1 << bit;
+            }
+        }
+
+        *value++ = byte;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_read () - read n bytes, up to ONEWIRE_MAX_TRANSFER_BYTES bytes per DMA transfer
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_read (uint8_t * value, uint8_t len)
+{
+    uint_fast8_t    n;
+
+    while (len > 0)
+    {
+        n = (len > ONEWIRE_MAX_TRANSFER_BYTES) ? ONEWIRE_MAX_TRANSFER_BYTES : len;
+
+        onewire_read_start (n);
+        onewire_wait ();
+        onewire_read_result (value);
+
+        value   += n;
+        len     -= n;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_read_byte () - read 1 byte
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint8_t
+onewire_read_byte (void)
+{
+    uint8_t rtc;
+
+    onewire_read (&rtc, 1);
+    return rtc;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_write_start () - start writing len bytes, len <= ONEWIRE_MAX_TRANSFER_BYTES, see onewire_poll()
+ *
+ * Timing at 115200 Bd:
+ *    1:    0xFF, Low:  8.7us
+ *    0:    0x00, Low: 78us
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_write_start (const uint8_t * value, uint8_t len)
+{
+    uint_fast8_t    idx;
+    uint_fast8_t    bit;
+
+    for (idx = 0; idx < len; idx++)
+    {
+        for (bit = 0; bit < 8; bit++)                                   // LSB first
+        {
+            onewire_slot_buf[8 * idx + bit] = (value[idx] & (1 << bit)) ? ONE_WIRE_SLOT_1 : ONE_WIRE_SLOT_0;
+        }
+    }
+
+    onewire_transfer_start (8 * len);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_write () - write n bytes, up to ONEWIRE_MAX_TRANSFER_BYTES bytes per DMA transfer
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_write (uint8_t * value, uint8_t len)
+{
+    uint_fast8_t    n;
+
+    while (len > 0)
+    {
+        n = (len > ONEWIRE_MAX_TRANSFER_BYTES) ? ONEWIRE_MAX_TRANSFER_BYTES : len;
+
+        onewire_write_start (value, n);
+        onewire_wait ();
+
+        value   += n;
+        len     -= n;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_write_byte () - write 1 byte
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+onewire_write_byte (uint8_t value)
+{
+    onewire_write (&value, 1);
+}
+
+#else // ONE_WIRE_USE_USART == 0
+
 #if defined (STM32F4XX)
 #  define DATA_LOW                  ONE_WIRE_PORT->BSRRH = ONE_WIRE_PIN
 #  define DATA_HIGH                 ONE_WIRE_PORT->BSRRL = ONE_WIRE_PIN
@@ -28,7 +455,7 @@ onewire_get_time_of_low_pulse (uint32_t timeout)
     uint32_t start  = 0;
     uint32_t stop   = 0;
 
-    delay_counter = timeout;
+    delay_start (timeout);
 
     do
     {
@@ -151,7 +578,7 @@ onewire_read (uint8_t * value, uint8_t len)
 }
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
- * onewire_write_byte () - write 1 byte
+ * onewire_write_bit () - write 1 bit
  *
  * Timing:
  *    1:    Low:  1 -  15us
@@ -159,6 +586,29 @@ onewire_read (uint8_t * value, uint8_t len)
  *-----------------------------------------------------------------------------------------------------------------------------------------------
  */
 void
+onewire_write_bit (uint_fast8_t bit)
+{
+    if (bit)
+    {
+        DATA_LOW;                           // write high bit
+        delay_usec (5);
+        DATA_HIGH;
+        delay_usec (80);
+    }
+    else
+    {
+        DATA_LOW;                           // write low bit
+        delay_usec (80);
+        DATA_HIGH;
+        delay_usec (5);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_write_byte () - write 1 byte
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
 onewire_write_byte (uint8_t value)
 {
     uint8_t         mask = 0x01;
@@ -166,21 +616,7 @@ onewire_write_byte (uint8_t value)
 
     for (idx = 0; idx < 8; idx++)
     {
-        if (value & mask)
-        {
-            DATA_LOW;                       // write high bit
-            delay_usec (5);
-            DATA_HIGH;
-            delay_usec (80);
-        }
-        else
-        {
-            DATA_LOW;                       // write low bit
-            delay_usec (80);
-            DATA_HIGH;
-            delay_usec (5);
-        }
-
+        onewire_write_bit (value & mask);
         mask <<= 1;
     }
 }
@@ -200,7 +636,104 @@ onewire_write (uint8_t * value, uint8_t len)
 }
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
- * onewire_get_rom_code () - get rom code of one connected slave
+ * Non blocking interface of the USART driver: bit banging performs the transfer at once in onewire_xxx_start(),
+ * so onewire_poll() always returns 1.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t                 onewire_result;                     // result of onewire_reset_start(), onewire_read_bit_start()
+static uint8_t                      onewire_read_buf[ONEWIRE_MAX_TRANSFER_BYTES];   // result of onewire_read_start()
+static uint_fast8_t                 onewire_len;                        // number of bytes of last onewire_read_start()
+
+uint_fast8_t
+onewire_poll (void)
+{
+    return 1;
+}
+
+void
+onewire_reset_start (void)
+{
+    onewire_result = onewire_reset ();
+}
+
+uint_fast8_t
+onewire_reset_result (void)
+{
+    return onewire_result;
+}
+
+void
+onewire_read_bit_start (void)
+{
+    onewire_result = onewire_read_bit ();
+}
+
+uint_fast8_t
+onewire_read_bit_result (void)
+{
+    return onewire_result;
+}
+
+void
+onewire_read_start (uint8_t len)
+{
+    onewire_len = len;
+    onewire_read (onewire_read_buf, len);
+}
+
+void
+onewire_read_result (uint8_t * value)
+{
+    memcpy (value, onewire_read_buf, onewire_len);
+}
+
+void
+onewire_write_start (const uint8_t * value, uint8_t len)
+{
+    while (len--)
+    {
+        onewire_write_byte (*value);
+        value++;
+    }
+}
+
+#endif // ONE_WIRE_USE_USART
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_crc8 () - calculate Dallas/Maxim CRC8 (x^8 + x^5 + x^4 + 1), returns 0 if data includes a correct CRC as last byte
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint8_t
+onewire_crc8 (const uint8_t * data, uint8_t len)
+{
+    uint8_t         crc = 0;
+    uint8_t         byte;
+    uint_fast8_t    idx;
+
+    while (len--)
+    {
+        byte = *data++;
+
+        for (idx = 0; idx < 8; idx++)
+        {
+            if ((crc ^ byte) & 0x01)
+            {
+                crc = (crc >> 1) ^ 0x8C;
+            }
+            else
+            {
+                crc >>= 1;
+            }
+
+            byte >>= 1;
+        }
+    }
+
+    return crc;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_get_rom_code () - get rom code of one connected slave, fails if CRC is wrong
  *-----------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
@@ -211,18 +744,115 @@ onewire_get_rom_code (uint8_t * rom_code)
     if (onewire_reset ())
     {
         onewire_write_byte (ONEWIRE_READ_ROM_CMD);
-        onewire_read (rom_code, 8);
+        onewire_read (rom_code, ONEWIRE_ROM_CODE_LEN);
         onewire_reset ();
-        rtc = 1;
+
+        if (rom_code[0] != 0x00 && onewire_crc8 (rom_code, ONEWIRE_ROM_CODE_LEN) == 0)
+        {
+            rtc = 1;
+        }
     }
     else
     {
-        memset (rom_code, 0, 8);
+        memset (rom_code, 0, ONEWIRE_ROM_CODE_LEN);
     }
 
     return rtc;
 }
 
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * onewire_search_rom () - get rom codes of all connected slaves, returns number of slaves found
+ *
+ * Binary tree search, see Maxim application note 187: for every bit of the ROM code, all remaining slaves send the bit
+ * and its complement. 1/0 or 0/1: all slaves agree, 0/0: discrepancy, the master selects a branch by writing the bit.
+ * Slaves with another bit leave the search until the next reset. Each pass finds one ROM code, the next pass takes
+ * the 1 branch at the last discrepancy where the 0 branch was taken.
+ *
+ * The search stops if no slave answers or a ROM code has a wrong CRC.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+onewire_search_rom (uint8_t (*rom_codes)[ONEWIRE_ROM_CODE_LEN], uint_fast8_t max_rom_codes)
+{
+    uint8_t         rom_code[ONEWIRE_ROM_CODE_LEN];
+    uint_fast8_t    n_rom_codes         = 0;
+    uint_fast8_t    last_discrepancy    = 0;                            // bit number 1..64 of last discrepancy, 0 = none
+    uint_fast8_t    last_zero;
+    uint_fast8_t    bit_number;
+    uint_fast8_t    id_bit;
+    uint_fast8_t    cmp_id_bit;
+    uint_fast8_t    direction;
+    uint8_t         mask;
+    uint8_t *       byte_p;
+
+    memset (rom_code, 0, ONEWIRE_ROM_CODE_LEN);
+
+    do
+    {
+        if (! onewire_reset ())
+        {
+            break;
+        }
+
+        onewire_write_byte (ONEWIRE_SEARCH_ROM_CMD);
+        last_zero = 0;
+
+        for (bit_number = 1; bit_number <= 8 * ONEWIRE_ROM_CODE_LEN; bit_number++)
+        {
+            byte_p      = rom_code + (bit_number - 1) / 8;
+            mask        = 1 << ((bit_number - 1) % 8);                  // LSB first
+            id_bit      = onewire_read_bit ();
+            cmp_id_bit  = onewire_read_bit ();
+
+            if (id_bit && cmp_id_bit)                                   // no slave answers
+            {
+                break;
+            }
+
+            if (id_bit != cmp_id_bit)                                   // all slaves have the same bit
+            {
+                direction = id_bit;
+            }
+            else if (bit_number < last_discrepancy)                     // discrepancy: same branch as last pass
+            {
+                direction = (*byte_p & mask) ? 1 : 0;
+            }
+            else                                                        // discrepancy: 1 at last discrepancy, else 0
+            {
+                direction = (bit_number == last_discrepancy) ? 1 : 0;
+            }
+
+            if (id_bit == cmp_id_bit && ! direction)
+            {
+                last_zero = bit_number;
+            }
+
+            if (direction)
+            {
+                *byte_p |= mask;
+            }
+            else
+            {
+                *byte_p &= ~mask;
+            }
+
+            onewire_write_bit (direction);
+        }
+
+        if (bit_number <= 8 * ONEWIRE_ROM_CODE_LEN || rom_code[0] == 0x00 || onewire_crc8 (rom_code, ONEWIRE_ROM_CODE_LEN) != 0)
+        {
+            break;
+        }
+
+        memcpy (rom_codes[n_rom_codes], rom_code, ONEWIRE_ROM_CODE_LEN);
+        n_rom_codes++;
+        last_discrepancy = last_zero;
+    } while (last_discrepancy != 0 && n_rom_codes < max_rom_codes);
+
+    onewire_reset ();
+    return n_rom_codes;
+}
+
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
  * onewire_init () - initialize OneWire routines
  *-----------------------------------------------------------------------------------------------------------------------------------------------
@@ -246,6 +876,28 @@ onewire_init (void)
 
     gpio.GPIO_Pin       = ONE_WIRE_PIN;
 
+#if ONE_WIRE_USE_USART == 1
+
+    ONE_WIRE_USART_CLOCK_CMD (ONE_WIRE_USART_CLOCK, ENABLE);
+    ONE_WIRE_DMA_CLOCK_CMD (ONE_WIRE_DMA_CLOCK, ENABLE);
+
+#if defined (STM32F4XX)
+    gpio.GPIO_Mode      = GPIO_Mode_AF;
+    gpio.GPIO_OType     = GPIO_OType_OD;                            // configure as OpenDrain, USART TX
+    gpio.GPIO_PuPd      = GPIO_PuPd_UP;
+    GPIO_PinAFConfig (ONE_WIRE_PORT, ONE_WIRE_PIN_SOURCE, ONE_WIRE_USART_AF);
+#elif defined (STM32F10X)
+    gpio.GPIO_Mode      = GPIO_Mode_AF_OD;                          // configure as OpenDrain, USART TX
+#endif
+
+    gpio.GPIO_Speed     = GPIO_Speed_50MHz;
+
+    GPIO_Init (ONE_WIRE_PORT, &gpio);
+
+    onewire_set_baudrate (ONE_WIRE_SLOT_BAUDRATE);
+
+#else // ONE_WIRE_USE_USART == 0
+
 #if defined (STM32F4XX)
     gpio.GPIO_Mode      = GPIO_Mode_OUT;
     gpio.GPIO_OType     = GPIO_OType_OD;                            // configure as OpenDrain
@@ -259,4 +911,6 @@ onewire_init (void)
     GPIO_Init (ONE_WIRE_PORT, &gpio);
 
     DATA_HIGH;
+
+#endif // ONE_WIRE_USE_USART
 }
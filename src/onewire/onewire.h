@@ -32,14 +32,31 @@
 //-----------------------------------------------------------------------------------------------------------------------------------------------
 #define  ONEWIRE_READ_ROM_CMD       0x33                                 // read ROM code
 #define  ONEWIRE_MATCH_ROM_CMD      0x55                                 // select a slave
+#define  ONEWIRE_SKIP_ROM_CMD       0xCC                                 // select all slaves
+#define  ONEWIRE_SEARCH_ROM_CMD     0xF0                                 // enumerate ROM codes of all slaves
+
+#define  ONEWIRE_ROM_CODE_LEN       8                                    // family code, 6 bytes serial number, CRC8
+#define  ONEWIRE_MAX_TRANSFER_BYTES 9                                    // max. bytes of onewire_read_start(), onewire_write_start()
+
+extern uint_fast8_t                 onewire_poll (void);
+extern void                         onewire_reset_start (void);
+extern uint_fast8_t                 onewire_reset_result (void);
+extern void                         onewire_read_bit_start (void);
+extern uint_fast8_t                 onewire_read_bit_result (void);
+extern void                         onewire_read_start (uint8_t);
+extern void                         onewire_read_result (uint8_t *);
+extern void                         onewire_write_start (const uint8_t *, uint8_t);
 
 extern uint_fast8_t                 onewire_reset (void);
 extern uint_fast8_t                 onewire_read_bit (void);
+extern void                         onewire_write_bit (uint_fast8_t);
 extern uint8_t                      onewire_read_byte (void);
 extern void                         onewire_read (uint8_t *, uint8_t);
 extern void                         onewire_write_byte (uint8_t);
 extern void                         onewire_write (uint8_t *, uint8_t);
+extern uint8_t                      onewire_crc8 (const uint8_t *, uint8_t);
 extern uint_fast8_t                 onewire_get_rom_code (uint8_t *);
+extern uint_fast8_t                 onewire_search_rom (uint8_t (*)[ONEWIRE_ROM_CODE_LEN], uint_fast8_t);
 extern uint_fast8_t                 onewirte_read_rom_code (void);
 extern void                         onewire_init (void);
 
@@ -0,0 +1,80 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * pt.h - protothreads: stackless coroutines for driver flows which have to wait
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * A protothread is a function which returns at every wait point and continues at the same point when it is called again.
+ * The resume point is stored in a PT struct, a switch statement jumps to it. Because the stack frame does not survive,
+ * all variables which are needed after a wait point must be stored in a state struct together with the PT.
+ *
+ * Restrictions:
+ *   - only one PT_WAIT_xxx/PT_YIELD/PT_DELAY per source line (the line number is the resume point)
+ *   - no wait point inside of a switch statement within the protothread
+ *
+ * Usage:
+ *
+ *   PT_THREAD(foo_pt (FOO_CTX * ctx))
+ *   {
+ *       PT_BEGIN(&ctx->pt);
+ *       PT_DELAY(&ctx->pt, ctx->start, 15);             // wait 15 ms, animations etc. continue meanwhile
+ *       PT_END(&ctx->pt);
+ *   }
+ *
+ *   PT_INIT(&ctx.pt);
+ *   while (PT_SCHEDULE(foo_pt (&ctx)))                  // blocking call, otherwise call foo_pt() once per main loop cycle
+ *   {
+ *       ;
+ *   }
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef PT_H
+#define PT_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+#include "timer.h"
+
+#define PT_WAITING                      0                                   // protothread waits for a condition
+#define PT_YIELDED                      1                                   // protothread yielded
+#define PT_EXITED                       2                                   // protothread exited with PT_EXIT()
+#define PT_ENDED                        3                                   // protothread reached PT_END()
+
+typedef struct
+{
+    uint16_t                            lc;                                 // local continuation: line number of resume point
+} PT;
+
+#define PT_THREAD(name_args)            uint_fast8_t name_args
+
+#define PT_INIT(pt)                     do { (pt)->lc = 0; } while (0)
+
+#define PT_BEGIN(pt)                    { uint_fast8_t pt_yield_flag = 1; (void) pt_yield_flag; switch ((pt)->lc) { case 0:
+
+#define PT_END(pt)                      } PT_INIT(pt); return PT_ENDED; }
+
+#define PT_WAIT_UNTIL(pt, condition)    do { (pt)->lc = __LINE__; case __LINE__: if (! (condition)) { return PT_WAITING; } } while (0)
+
+#define PT_WAIT_WHILE(pt, condition)    PT_WAIT_UNTIL((pt), ! (condition))
+
+#define PT_YIELD(pt)                    do { pt_yield_flag = 0; (pt)->lc = __LINE__; case __LINE__: if (! pt_yield_flag) { return PT_YIELDED; } } while (0)
+
+#define PT_EXIT(pt)                     do { PT_INIT(pt); return PT_EXITED; } while (0)
+
+#define PT_SCHEDULE(f)                  ((f) < PT_EXITED)                   // run protothread once, true if it has not finished yet
+
+#define PT_SPAWN(pt, child, thread)     do { PT_INIT(child); PT_WAIT_WHILE((pt), PT_SCHEDULE(thread)); } while (0)
+
+#define PT_TIMEOUT(start, ms)           ((uint32_t) (timer_ms - (start)) >= (uint32_t) (ms))
+
+#define PT_DELAY(pt, start, ms)         do { (start) = timer_ms; PT_WAIT_UNTIL((pt), PT_TIMEOUT((start), (ms))); } while (0)
+
+#endif
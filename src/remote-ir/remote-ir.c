@@ -74,20 +74,51 @@ remote_ir_get_cmd (void)
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * learn remote IR control
+ * check if IR command i has been received and was not stored previously
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
-uint_fast8_t
-remote_ir_learn (void)
+static uint_fast8_t
+learn_cmd (uint_fast8_t i)
+{
+    if (irmp_get_data (&irmp_data_array[i]))                                                    // read ir data
+    {
+        if ((irmp_data_array[i].flags & IRMP_FLAG_REPETITION) == 0)                             // no repetition
+        {
+            if (i == 0 || search_cmd (&irmp_data_array[i], i) == REMOTE_IR_CMD_INVALID)         // not stored previously
+            {
+                return 1;                                                                       // it's okay, next command...
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * start learning remote IR control with remote_ir_learn_pt()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+remote_ir_learn_start (REMOTE_IR_LEARN_CTX * ctx)
+{
+    PT_INIT(&ctx->pt);
+    ctx->rtc = 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * learn remote IR control (protothread), waits for each IR command without blocking the main loop
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+PT_THREAD(remote_ir_learn_pt (REMOTE_IR_LEARN_CTX * ctx))
 {
-    uint_fast8_t    rtc = 1;
-    uint_fast8_t    i;
     IRMP_DATA       dummy;
-    char *          t;
+    char *          t = "";
+
+    PT_BEGIN(&ctx->pt);
 
-    for (i = 0; i < N_REMOTE_IR_CMDS; i++)
+    for (ctx->idx = 0; ctx->idx < N_REMOTE_IR_CMDS; ctx->idx++)
     {
-        switch (i)
+        switch (ctx->idx)
         {
             case REMOTE_IR_CMD_POWER:                         t = "  power off/on";                     break;
             case REMOTE_IR_CMD_OK:                            t = "  ok";                               break;
@@ -116,80 +147,82 @@ remote_ir_learn (void)
 
         irmp_get_data (&dummy);
 
-        while (1)
-        {
-            if (irmp_get_data (&irmp_data_array[i]))                                            // read ir data
-            {
-                if ((irmp_data_array[i].flags & IRMP_FLAG_REPETITION) == 0)                     // no repetition
-                {
-                    if (i == 0 || search_cmd (&irmp_data_array[i], i) == REMOTE_IR_CMD_INVALID) // not stored previously
-                    {
-                        break;                                                                  // it's okay, next command...
-                    }
-                }
-            }
-        }
+        PT_WAIT_UNTIL(&ctx->pt, learn_cmd (ctx->idx));
     }
 
     display_banner ("  Thank you!");
 
-    return rtc;
+    PT_END(&ctx->pt);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * learn remote IR control, blocking version of remote_ir_learn_pt()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+remote_ir_learn (void)
+{
+    REMOTE_IR_LEARN_CTX ctx;
+
+    remote_ir_learn_start (&ctx);
+
+    while (PT_SCHEDULE(remote_ir_learn_pt (&ctx)))
+    {
+        ;
+    }
+
+    return ctx.rtc;
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * read IR codes from EEPROM
+ * read IR codes from EEPROM, all codes in one call
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
 remote_ir_read_codes_from_eeprom (void)
 {
-    PACKED_IRMP_DATA    packed_irmp_data;
+    PACKED_IRMP_DATA    packed_irmp_data[N_REMOTE_IR_CMDS];
     uint_fast8_t        rtc = 0;
 
-    if (eeprom_is_up)
+    if (eeprom_is_up && eeprom_read (EEPROM_DATA_OFFSET_IRMP_DATA, (uint8_t *) packed_irmp_data, sizeof(packed_irmp_data)))
     {
         uint_fast8_t    i;
-        uint_fast16_t   start_addr = EEPROM_DATA_OFFSET_IRMP_DATA;
 
         for (i = 0; i < N_REMOTE_IR_CMDS; i++)
         {
-            rtc = eeprom_read (start_addr, (uint8_t *) &packed_irmp_data, sizeof(PACKED_IRMP_DATA));
-
-            irmp_data_array[i].protocol = packed_irmp_data.protocol;
-            irmp_data_array[i].address  = packed_irmp_data.address;
-            irmp_data_array[i].command  = packed_irmp_data.command;
-
-            start_addr += sizeof(PACKED_IRMP_DATA);
+            irmp_data_array[i].protocol = packed_irmp_data[i].protocol;
+            irmp_data_array[i].address  = packed_irmp_data[i].address;
+            irmp_data_array[i].command  = packed_irmp_data[i].command;
         }
+
+        rtc = 1;
     }
 
     return rtc;
 }
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
- * write IR codes to EEPROM
+ * write IR codes to EEPROM, all codes in one call, so eeprom_write() can write whole pages
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
 uint_fast8_t
 remote_ir_write_codes_to_eeprom (void)
 {
-    PACKED_IRMP_DATA    packed_irmp_data;
+    PACKED_IRMP_DATA    packed_irmp_data[N_REMOTE_IR_CMDS];
     uint_fast8_t        rtc = 0;
 
     if (eeprom_is_up)
     {
         uint_fast8_t    i;
-        uint_fast16_t   start_addr = EEPROM_DATA_OFFSET_IRMP_DATA;
 
         for (i = 0; i < N_REMOTE_IR_CMDS; i++)
         {
-            packed_irmp_data.protocol   = irmp_data_array[i].protocol;
-            packed_irmp_data.address    = irmp_data_array[i].address;
-            packed_irmp_data.command    = irmp_data_array[i].command;
-
-            rtc = eeprom_write (start_addr, (uint8_t *) &packed_irmp_data, sizeof(PACKED_IRMP_DATA));
-            start_addr += sizeof(PACKED_IRMP_DATA);
+            packed_irmp_data[i].protocol    = irmp_data_array[i].protocol;
+            packed_irmp_data[i].address     = irmp_data_array[i].address;
+            packed_irmp_data[i].command     = irmp_data_array[i].command;
         }
+
+        rtc = eeprom_write (EEPROM_DATA_OFFSET_IRMP_DATA, (uint8_t *) packed_irmp_data, sizeof(packed_irmp_data));
     }
 
     return rtc;
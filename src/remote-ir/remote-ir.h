@@ -47,7 +47,18 @@
 
 #define N_REMOTE_IR_CMDS                            20
 
+#include "pt.h"
+
+typedef struct
+{
+    PT              pt;
+    uint_fast8_t    idx;                                                    // index of IR command to learn
+    uint_fast8_t    rtc;                                                    // result: 1 = successful
+} REMOTE_IR_LEARN_CTX;
+
 extern uint_fast8_t remote_ir_get_cmd (void);
+extern void         remote_ir_learn_start (REMOTE_IR_LEARN_CTX *);
+extern uint_fast8_t remote_ir_learn_pt (REMOTE_IR_LEARN_CTX *);
 extern uint_fast8_t remote_ir_learn (void);
 extern uint_fast8_t remote_ir_read_codes_from_eeprom (void);
 extern uint_fast8_t remote_ir_write_codes_to_eeprom (void);
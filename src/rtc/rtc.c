@@ -9,9 +9,36 @@
  * (at your option) any later version.
  *-------------------------------------------------------------------------------------------------------------------------------------------
  */
+#include "wclock24h-config.h"
 #include "rtc.h"
 #include "i2c.h"
 
+#if RTC_SQW_SECOND_TICK == 1
+#if defined (STM32F401RE) || defined (STM32F411RE)                      // STM32F401/STM32F411 Nucleo Board: SQW=PB0
+#define SQW_PERIPH_CLOCK_CMD    RCC_AHB1PeriphClockCmd
+#define SQW_PERIPH              RCC_AHB1Periph_GPIOB
+#define SQW_PORT                GPIOB
+#define SQW_PIN                 GPIO_Pin_0
+#define SQW_PORT_SOURCE         EXTI_PortSourceGPIOB
+#define SQW_PIN_SOURCE          EXTI_PinSource0
+
+#elif defined (STM32F103)                                               // STM32F103 Mini Development Board: SQW=PB0
+#define SQW_PERIPH_CLOCK_CMD    RCC_APB2PeriphClockCmd
+#define SQW_PERIPH              (RCC_APB2Periph_GPIOB | RCC_APB2Periph_AFIO)
+#define SQW_PORT                GPIOB
+#define SQW_PIN                 GPIO_Pin_0
+#define SQW_PORT_SOURCE         GPIO_PortSourceGPIOB
+#define SQW_PIN_SOURCE          GPIO_PinSource0
+
+#else
+#error STM32 unknown
+#endif
+
+#define SQW_EXTI_LINE           EXTI_Line0
+#define SQW_IRQ_CHANNEL         EXTI0_IRQn
+#define SQW_IRQ_HANDLER         EXTI0_IRQHandler
+#endif
+
 #define DS1307_OR_DS3231_ADDR   0xD0                            // I2C address
 #define FIRST_TIME_REG          0x00                            // address of first time register
 
@@ -43,7 +70,7 @@
 #define DS3231_CTRL_A1IE        0x01                            // Alarm 1 Interrupt Enable
 
 #define DS3231_CTRL_REG         0x0E                            // address of control register
-#define DS3231_CTRL_DEFAULT     0x00                            // default value: all bits reset
+#define DS3231_CTRL_DEFAULT     0x00                            // default value: all bits reset, INTCN=0, RS2=RS1=0: 1Hz square wave on INT/SQW
 
 #define DS3231_TEMP_REG_HI      0x11                            // 8 upper bytes: integer part
 #define DS3231_TEMP_REG_LO      0x12                            // 2 lower bytes: fractional part 0x00=0.00, 0x01=0.25, ... 0x03=0.75
@@ -54,6 +81,7 @@
 uint_fast8_t                    rtc_is_up = 0;
 
 static uint_fast8_t             is_ds1307;
+static void                     (*rtc_sqw_callback_ptr) (void);
 
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * INTERN: read data
@@ -105,6 +133,78 @@ rtc_write (uint_fast8_t start_addr, uint8_t * buffer, uint_fast8_t cnt)
     return rtc;
 }
 
+#if RTC_SQW_SECOND_TICK == 1
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: initialize EXTI for 1Hz square wave output of DS3231 (open drain, so use pull up)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+rtc_sqw_init (void)
+{
+    GPIO_InitTypeDef    gpio;
+    EXTI_InitTypeDef    exti;
+    NVIC_InitTypeDef    nvic;
+
+    GPIO_StructInit (&gpio);
+    SQW_PERIPH_CLOCK_CMD (SQW_PERIPH, ENABLE);
+
+    gpio.GPIO_Pin   = SQW_PIN;
+
+#if defined (STM32F10X)
+    gpio.GPIO_Mode  = GPIO_Mode_IPU;
+    GPIO_Init (SQW_PORT, &gpio);
+    GPIO_EXTILineConfig (SQW_PORT_SOURCE, SQW_PIN_SOURCE);
+#elif defined (STM32F4XX)
+    gpio.GPIO_Mode  = GPIO_Mode_IN;
+    gpio.GPIO_PuPd  = GPIO_PuPd_UP;
+    GPIO_Init (SQW_PORT, &gpio);
+    RCC_APB2PeriphClockCmd (RCC_APB2Periph_SYSCFG, ENABLE);
+    SYSCFG_EXTILineConfig (SQW_PORT_SOURCE, SQW_PIN_SOURCE);
+#endif
+
+    EXTI_StructInit (&exti);
+    exti.EXTI_Line      = SQW_EXTI_LINE;
+    exti.EXTI_Mode      = EXTI_Mode_Interrupt;
+    exti.EXTI_Trigger   = EXTI_Trigger_Falling;                         // falling edge: seconds register has been updated
+    exti.EXTI_LineCmd   = ENABLE;
+    EXTI_Init (&exti);
+
+    nvic.NVIC_IRQChannel                    = SQW_IRQ_CHANNEL;
+    nvic.NVIC_IRQChannelCmd                 = ENABLE;
+    nvic.NVIC_IRQChannelPreemptionPriority  = 0x0F;                     // same as TIM2, see softclock.c
+    nvic.NVIC_IRQChannelSubPriority         = 0x0F;
+    NVIC_Init (&nvic);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * EXTI IRQ handler for 1Hz square wave output of DS3231
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+SQW_IRQ_HANDLER (void)
+{
+    if (EXTI_GetITStatus (SQW_EXTI_LINE) != RESET)
+    {
+        EXTI_ClearITPendingBit (SQW_EXTI_LINE);
+
+        if (rtc_sqw_callback_ptr)
+        {
+            (*rtc_sqw_callback_ptr) ();
+        }
+    }
+}
+#endif
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * set callback for 1Hz square wave output of DS3231, called in interrupt context on every falling edge
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+rtc_set_sqw_callback_ptr (void (*cb)(void))
+{
+    rtc_sqw_callback_ptr = cb;
+}
+
 /*-------------------------------------------------------------------------------------------------------------------------------------------
  * initialize I2C and RTC
  *
@@ -163,6 +263,10 @@ rtc_init (void)
                 rtc_write (DS3231_CTRL_REG, &value, 1);
             }
 
+#if RTC_SQW_SECOND_TICK == 1
+            rtc_sqw_init ();
+#endif
+
             rtc_is_up = 1;
         }
     }
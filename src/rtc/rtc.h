@@ -21,6 +21,7 @@
 
 extern uint_fast8_t rtc_is_up;
 
+extern void rtc_set_sqw_callback_ptr (void (*)(void));
 extern uint_fast8_t rtc_init (void);
 extern uint_fast8_t rtc_set_date_time (struct tm *);
 extern uint_fast8_t rtc_get_date_time (struct tm *);
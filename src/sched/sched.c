@@ -0,0 +1,299 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * sched.c - cooperative task scheduler
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * Tasks are registered with a priority and a deadline. sched_run() runs every ready task once, highest priority first.
+ * Tasks registered with SCHED_FLAG_POLL are ready in every cycle, all others get ready by sched_set_ready(), e.g. when
+ * the main loop gets an event from the event queue.
+ *
+ * For each task the number of invocations, the total and the maximum execution time (measured with the DWT cycle
+ * counter, see delay_get_cycles()) and the number of deadline misses are recorded. A deadline is missed if the task was
+ * finished later than 'deadline' ms after it got ready or if an activation got lost because the task was still ready.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include <string.h>
+#include "sched.h"
+#include "timer.h"
+#include "delay.h"
+#include "log.h"
+
+#define SCHED_IDLE_LOG_INTERVAL 60                                          // idle statistics: log average every 60 seconds
+
+uint_fast16_t                   sched_idle_permille;                        // CPU idle time of last second in 1/1000
+
+static uint32_t                 idle_cycles;                                // CPU cycles spent sleeping, see sched_add_idle_cycles()
+static SCHED_TASK               tasks[SCHED_MAX_TASKS];
+static uint8_t                  order[SCHED_MAX_TASKS];                     // task ids sorted by priority
+static uint_fast8_t             n_tasks;
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * add a task
+ *
+ * name:        name of task, shown in statistics
+ * func:        task function
+ * priority:    0 = highest priority
+ * deadline:    max. time in ms from ready until task is finished
+ * flags:       SCHED_FLAG_POLL: run task in every cycle
+ *
+ * Return values:
+ *  SCHED_INVALID   Failed
+ *  other           task id
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+sched_add_task (const char * name, SCHED_FUNC func, uint_fast8_t priority, uint32_t deadline, uint_fast8_t flags)
+{
+    SCHED_TASK *    t;
+    uint_fast8_t    id;
+    uint_fast8_t    i;
+
+    if (n_tasks >= SCHED_MAX_TASKS)
+    {
+        return SCHED_INVALID;
+    }
+
+    id = n_tasks;
+    t  = &tasks[id];
+
+    memset (t, 0, sizeof (SCHED_TASK));
+    t->name     = name;
+    t->func     = func;
+    t->priority = priority;
+    t->deadline = deadline;
+    t->flags    = flags;
+
+    for (i = n_tasks; i > 0 && tasks[order[i - 1]].priority > priority; i--)    // insert id into order, sorted by priority
+    {
+        order[i] = order[i - 1];
+    }
+
+    order[i] = id;
+    n_tasks++;
+
+    return id;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * set task ready, must be called in main loop
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+sched_set_ready (uint_fast8_t id)
+{
+    SCHED_TASK *    t;
+
+    if (id < n_tasks)
+    {
+        t = &tasks[id];
+
+        if (t->ready)                                                       // still ready: previous activation gets lost
+        {
+            t->deadline_misses++;
+        }
+        else
+        {
+            t->ready    = 1;
+            t->ready_ms = timer_ms;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * check if any task (without SCHED_FLAG_POLL) is ready
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+sched_is_ready (void)
+{
+    uint_fast8_t    id;
+
+    for (id = 0; id < n_tasks; id++)
+    {
+        if (tasks[id].ready)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * run all ready tasks once, highest priority first
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+sched_run (void)
+{
+    SCHED_TASK *    t;
+    uint32_t        start;
+    uint32_t        cycles;
+    uint_fast8_t    i;
+
+    for (i = 0; i < n_tasks; i++)
+    {
+        t = &tasks[order[i]];
+
+        if (t->flags & SCHED_FLAG_POLL)
+        {
+            t->ready    = 1;
+            t->ready_ms = timer_ms;
+        }
+
+        if (t->ready)
+        {
+            t->ready = 0;
+
+            start = delay_get_cycles ();
+            (*t->func) ();
+            cycles = delay_get_cycles () - start;
+
+            t->calls++;
+            t->total_cycles += cycles;
+
+            if (t->max_cycles < cycles)
+            {
+                t->max_cycles = cycles;
+            }
+
+            if (timer_ms - t->ready_ms > t->deadline)
+            {
+                t->deadline_misses++;
+            }
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get number of tasks
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+sched_get_n_tasks (void)
+{
+    return n_tasks;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get task by index, sorted by priority
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+const SCHED_TASK *
+sched_get_task (uint_fast8_t idx)
+{
+    if (idx < n_tasks)
+    {
+        return &tasks[order[idx]];
+    }
+
+    return (SCHED_TASK *) 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * convert CPU cycles to microseconds
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint32_t
+sched_cycles_to_usec (uint32_t cycles)
+{
+    return cycles / (SystemCoreClock / 1000000);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * log task statistics
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+sched_log_statistics (void)
+{
+    const SCHED_TASK *  t;
+    uint32_t            avg_cycles;
+    uint_fast8_t        i;
+
+    log_msg ("task       prio deadline      calls   avg us   max us   misses");
+
+    for (i = 0; i < n_tasks; i++)
+    {
+        t = &tasks[order[i]];
+        avg_cycles = t->calls ? (uint32_t) (t->total_cycles / t->calls) : 0;
+
+        log_printf ("%-10s %4d %8lu %10lu %8lu %8lu %8lu\r\n", t->name, t->priority, (unsigned long) t->deadline, (unsigned long) t->calls,
+                    (unsigned long) sched_cycles_to_usec (avg_cycles), (unsigned long) sched_cycles_to_usec (t->max_cycles),
+                    (unsigned long) t->deadline_misses);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * add CPU cycles spent sleeping in main loop
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+sched_add_idle_cycles (uint32_t cycles)
+{
+    idle_cycles += cycles;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * calculate CPU idle time of last second, log average every SCHED_IDLE_LOG_INTERVAL seconds
+ * must be called every SCHED_IDLE_PERIOD_MS
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+sched_idle_statistics (void)
+{
+    static uint32_t         last_cycles;
+    static uint32_t         last_idle_cycles;
+    static uint32_t         sum_permille;
+    static uint_fast8_t     cnt;
+    uint32_t                cycles;
+    uint32_t                total;
+    uint32_t                idle;
+
+    cycles              = delay_get_cycles ();
+    total               = cycles - last_cycles;
+    idle                = idle_cycles - last_idle_cycles;
+    last_cycles         = cycles;
+    last_idle_cycles    = idle_cycles;
+
+    if (total >= 1000)
+    {
+        sched_idle_permille = idle / (total / 1000);
+
+        if (sched_idle_permille > 1000)
+        {
+            sched_idle_permille = 1000;
+        }
+    }
+
+    sum_permille += sched_idle_permille;
+    cnt++;
+
+    if (cnt == SCHED_IDLE_LOG_INTERVAL)
+    {
+        log_printf ("cpu idle: %d.%d%%\r\n", sum_permille / (10 * SCHED_IDLE_LOG_INTERVAL), (sum_permille / SCHED_IDLE_LOG_INTERVAL) % 10);
+        sum_permille = 0;
+        cnt = 0;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * initialize scheduler
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+sched_init (void)
+{
+    static uint_fast8_t already_called;
+
+    if (! already_called)
+    {
+        already_called = 1;
+        n_tasks = 0;
+    }
+}
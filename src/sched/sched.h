@@ -0,0 +1,60 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * sched.h - declarations of cooperative task scheduler
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef SCHED_H
+#define SCHED_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+#define SCHED_MAX_TASKS                 12                                  // max. number of registered tasks
+#define SCHED_INVALID                   0xFF                                // return value of sched_add_task() on error
+
+#define SCHED_FLAG_NONE                 0x00                                // task runs after sched_set_ready()
+#define SCHED_FLAG_POLL                 0x01                                // task runs in every scheduler cycle
+
+#define SCHED_IDLE_PERIOD_MS            1000                                // period of sched_idle_statistics(): idle time of last second
+
+typedef void (*SCHED_FUNC) (void);
+
+typedef struct
+{
+    const char *                        name;                               // name of task
+    SCHED_FUNC                          func;                               // task function
+    uint32_t                            deadline;                           // max. time in ms from ready until task is finished
+    uint32_t                            ready_ms;                           // time in ms when task got ready
+    uint32_t                            calls;                              // number of invocations
+    uint64_t                            total_cycles;                       // total execution time in CPU cycles
+    uint32_t                            max_cycles;                         // max. execution time in CPU cycles
+    uint32_t                            deadline_misses;                    // number of missed deadlines, including lost activations
+    uint8_t                             priority;                           // priority, 0 = highest
+    uint8_t                             flags;                              // SCHED_FLAG_xxx
+    uint8_t                             ready;                              // flag: task is ready to run
+} SCHED_TASK;
+
+extern uint_fast16_t                    sched_idle_permille;                // CPU idle time of last second in 1/1000
+
+extern uint_fast8_t                     sched_add_task (const char *, SCHED_FUNC, uint_fast8_t, uint32_t, uint_fast8_t);
+extern void                             sched_set_ready (uint_fast8_t);
+extern uint_fast8_t                     sched_is_ready (void);
+extern void                             sched_run (void);
+extern uint_fast8_t                     sched_get_n_tasks (void);
+extern const SCHED_TASK *               sched_get_task (uint_fast8_t);
+extern uint32_t                         sched_cycles_to_usec (uint32_t);
+extern void                             sched_log_statistics (void);
+extern void                             sched_add_idle_cycles (uint32_t);
+extern void                             sched_idle_statistics (void);
+extern void                             sched_init (void);
+
+#endif
@@ -0,0 +1,555 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * softclock.c - soft clock: monotonic millisecond counter and wall clock
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * softclock_isr_tick() must be called once per millisecond (see TIM2_IRQHandler() in main.c). It advances a 64 bit
+ * monotonic millisecond counter and the wall clock, which is kept as local time in seconds since 1970-01-01 00:00:00
+ * plus the sub-second phase in ms. Date and weekday are derived from the epoch seconds, so there are no date gaps. The
+ * calendar is the proleptic gregorian one including leap years and is valid from 1970 until 2105.
+ *
+ * After the time has been set once by DCF77, net time or RTC, the soft clock runs on its own. An RTC is not needed, it
+ * is only read at boot and for rare discipline checks.
+ *
+ * Frequency discipline: softclock_sync() is called with a reference time (DCF77 minute mark, net time, RTC) and its
+ * accuracy. The offset between reference and soft clock is only corrected if it exceeds the accuracy. All offsets since
+ * the last estimation are summed up; once the interval is long enough to get the drift with an error of less than
+ * 10^6 / SOFTCLOCK_DISCIPLINE_FACTOR = 2 ppm, the drift estimate is updated. The ISR trims the sub-second phase by one ms
+ * whenever the drift, accumulated in ppb per tick, reaches 1 ms. The monotonic counter is not trimmed. The drift is
+ * stored in EEPROM, so the soft clock is disciplined right after boot.
+ *
+ * If the 1 Hz square wave output of a DS3231 is connected (see rtc.c), softclock_sqw_isr() is called as callback of the
+ * RTC on every falling edge and the second rollover follows the temperature compensated RTC. TIM2 then only interpolates
+ * the sub-second phase. If an edge is more than SOFTCLOCK_SQW_TIMEOUT_MS late, the soft clock falls back to TIM2 until
+ * the next edge.
+ *
+ * The ISRs are the only writers besides softclock_set_tm() and softclock_sync(), which block interrupts while writing.
+ * Both ISRs run with the same preemption priority, so they never interrupt each other.
+ * Readers in the main loop use a sequence lock: the sequence counter is odd while an update is in progress, and a reader
+ * copies the values until it sees the same even counter before and after the copy. This gives consistent snapshots
+ * without blocking interrupts.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include "softclock.h"
+#include "event.h"
+#include "eeprom.h"
+#include "eeprom-data.h"
+#include "night.h"
+#include "log.h"
+
+#define SECONDS_PER_DAY                 86400L
+#define DAYS_0000_TO_1970               719468L                             // days from 0000-03-01 to 1970-01-01
+#define DAYS_PER_400_YEARS              146097L
+#define WDAY_1970                       4                                   // 1970-01-01 was a thursday
+
+#define PPB                             1000000000L                         // 1 ms per PPB ms
+#define SOFTCLOCK_MAX_DRIFT             500000L                             // max. drift: 500 ppm
+#define SOFTCLOCK_MAX_OFFSET_MS         60000L                              // greater offsets are time jumps, not drift
+#define SOFTCLOCK_DISCIPLINE_FACTOR     500000L                             // estimate drift after accuracy * 500000 ms: error < 2 ppm
+#define SOFTCLOCK_EEPROM_MIN_CHANGE     100                                 // write drift to EEPROM if changed by 100 ppb or more
+#define SOFTCLOCK_SQW_TIMEOUT_MS        100                                 // fall back to TIM2 if SQW edge is 100 ms late
+
+static volatile uint32_t                softclock_seq;                      // sequence counter, odd while update in progress
+static volatile uint64_t                softclock_ms;                       // monotonic milliseconds
+static volatile uint32_t                softclock_epoch;                    // local time in seconds since 1970
+static volatile uint16_t                softclock_msec;                     // sub-second phase in ms
+static uint_fast8_t                     softclock_set;                      // flag: wall clock has been set
+static volatile uint_fast8_t            softclock_sqw;                      // flag: second tick comes from SQW of RTC
+static uint_fast16_t                    sqw_late_ms;                        // ISR: ms waited for SQW edge
+static volatile int32_t                 softclock_drift;                    // drift in ppb, > 0: soft clock is too slow
+static int32_t                          softclock_frac;                     // ISR: accumulated drift in ppb * ms
+static int32_t                          eeprom_drift;                       // drift stored in EEPROM
+static uint64_t                         discipline_start_ms;                // monotonic ms of last drift estimation
+static int32_t                          discipline_offset_ms;               // sum of corrected offsets since discipline_start_ms
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: convert date to days since 1970-01-01, month 1...12
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint32_t
+days_from_date (uint_fast16_t year, uint_fast8_t month, uint_fast8_t mday)
+{
+    uint32_t        era;
+    uint32_t        yoe;                                                    // year of era, 0...399
+    uint32_t        doy;                                                    // day of year, beginning with march 1st
+    uint32_t        doe;                                                    // day of era
+
+    if (month <= 2)                                                         // year begins with march, so leap day is the last day
+    {
+        year--;
+    }
+
+    era = year / 400;
+    yoe = year - era * 400;
+    doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + mday - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * DAYS_PER_400_YEARS + doe - DAYS_0000_TO_1970;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * increment soft clock, must be called by timer ISR every millisecond
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+softclock_isr_tick (void)
+{
+    uint_fast8_t    new_minute = 0;
+    uint_fast8_t    msec_inc   = 1;
+
+    if (! softclock_sqw)                                                    // SQW: RTC is temperature compensated, no trimming
+    {
+        softclock_frac += softclock_drift;
+
+        if (softclock_frac >= PPB)                                          // soft clock too slow: insert one ms
+        {
+            softclock_frac -= PPB;
+            msec_inc = 2;
+        }
+        else if (softclock_frac <= -PPB)                                    // soft clock too fast: drop one ms
+        {
+            softclock_frac += PPB;
+            msec_inc = 0;
+        }
+    }
+
+    softclock_seq++;
+
+    softclock_ms++;
+    softclock_msec += msec_inc;
+
+    if (softclock_msec >= 1000)
+    {
+        if (softclock_sqw && sqw_late_ms < SOFTCLOCK_SQW_TIMEOUT_MS)        // wait for SQW edge
+        {
+            softclock_msec = 999;
+            sqw_late_ms++;
+        }
+        else
+        {
+            softclock_sqw   = 0;                                            // no SQW edge: fall back to TIM2
+            softclock_msec -= 1000;
+            softclock_epoch++;
+
+            if (softclock_epoch % 60 == 0)
+            {
+                new_minute = 1;
+            }
+        }
+    }
+
+    softclock_seq++;
+
+    if (new_minute)
+    {
+        (void) event_put (EVENT_MINUTE, 0);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * second tick from 1 Hz square wave of RTC, must be called by EXTI ISR on every falling edge of SQW
+ *
+ * The first edge switches the soft clock into SQW mode and queues an RTC event, so the main loop reads the RTC just
+ * after its seconds register has changed. An edge in the second half of a soft second completes this second, an edge
+ * in the first half only resynchronizes the sub-second phase, e.g. after the RTC has been set.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+softclock_sqw_isr (void)
+{
+    uint_fast8_t    new_minute = 0;
+    uint_fast8_t    first_edge = ! softclock_sqw;
+
+    softclock_seq++;
+
+    if (softclock_msec >= 500)
+    {
+        softclock_epoch++;
+
+        if (softclock_epoch % 60 == 0)
+        {
+            new_minute = 1;
+        }
+    }
+
+    softclock_msec  = 0;
+    softclock_sqw   = 1;
+    sqw_late_ms     = 0;
+
+    softclock_seq++;
+
+    if (new_minute)
+    {
+        (void) event_put (EVENT_MINUTE, 0);
+    }
+
+    if (first_edge)                                                         // read RTC now, its seconds register has just changed
+    {
+        (void) event_put (EVENT_RTC, 0);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * check if second tick comes from 1 Hz square wave of RTC
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+softclock_sqw_is_active (void)
+{
+    return softclock_sqw;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get consistent snapshot of monotonic counter and wall clock
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+softclock_get_snapshot (SOFTCLOCK_SNAPSHOT * snap)
+{
+    uint32_t    seq;
+
+    do
+    {
+        seq         = softclock_seq;
+        snap->ms    = softclock_ms;
+        snap->epoch = softclock_epoch;
+        snap->msec  = softclock_msec;
+    } while ((seq & 1) || seq != softclock_seq);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get monotonic milliseconds since softclock_init()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint64_t
+softclock_get_ms64 (void)
+{
+    SOFTCLOCK_SNAPSHOT  snap;
+
+    softclock_get_snapshot (&snap);
+    return snap.ms;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get uptime in seconds
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint32_t
+softclock_get_uptime (void)
+{
+    return (uint32_t) (softclock_get_ms64 () / 1000);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get wall clock as struct tm
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+softclock_get_tm (struct tm * tmp)
+{
+    SOFTCLOCK_SNAPSHOT  snap;
+
+    softclock_get_snapshot (&snap);
+    softclock_epoch_to_tm (tmp, snap.epoch);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: step wall clock to reference time, which began age_ms ago
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+softclock_step (uint32_t epoch, uint_fast16_t age_ms)
+{
+    __disable_irq();
+    softclock_seq++;
+    softclock_epoch = epoch + age_ms / 1000;
+    softclock_msec  = age_ms % 1000;
+    softclock_seq++;
+    __enable_irq();
+
+    softclock_set = 1;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: restart drift measurement
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+softclock_restart_discipline (void)
+{
+    discipline_start_ms     = softclock_get_ms64 ();
+    discipline_offset_ms    = 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * set wall clock, sub-second phase starts with 0
+ *
+ * Only tm_year, tm_mon, tm_mday, tm_hour, tm_min and tm_sec are used. tm_wday and tm_yday are recalculated, so the
+ * caller can pass *tmp to rtc_set_date_time() afterwards. Use softclock_sync() for reference times: softclock_set_tm()
+ * restarts the drift measurement.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+softclock_set_tm (struct tm * tmp)
+{
+    uint32_t    epoch = softclock_tm_to_epoch (tmp);
+
+    softclock_epoch_to_tm (tmp, epoch);
+    softclock_step (epoch, 0);
+    softclock_restart_discipline ();
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: get offset of reference time to soft clock in ms, > 0: soft clock is late
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static int64_t
+softclock_offset (uint32_t epoch, uint_fast16_t age_ms, const SOFTCLOCK_SNAPSHOT * snap)
+{
+    return ((int64_t) epoch - snap->epoch) * 1000 + age_ms - snap->msec;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get offset of reference time, which began age_ms ago, to soft clock in ms, limited to +/- 24 days
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+int32_t
+softclock_get_offset (const struct tm * tmp, uint_fast16_t age_ms)
+{
+    SOFTCLOCK_SNAPSHOT  snap;
+    int64_t             offset;
+
+    softclock_get_snapshot (&snap);
+    offset = softclock_offset (softclock_tm_to_epoch (tmp), age_ms, &snap);
+
+    if (offset < -INT32_MAX)
+    {
+        offset = -INT32_MAX;
+    }
+    else if (offset > INT32_MAX)
+    {
+        offset = INT32_MAX;
+    }
+
+    return (int32_t) offset;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * synchronize wall clock with a reference time, which began age_ms ago
+ *
+ * tmp:         reference time, tm_wday and tm_yday are recalculated like in softclock_set_tm()
+ * accuracy_ms: accuracy of reference time in ms
+ * age_ms:      time since begin of reference time, e.g. since DCF77 minute mark
+ *
+ * Return value:
+ *  offset of reference time to soft clock in ms, > 0: soft clock was late
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+int32_t
+softclock_sync (struct tm * tmp, uint_fast16_t accuracy_ms, uint_fast16_t age_ms)
+{
+    SOFTCLOCK_SNAPSHOT  snap;
+    uint32_t            epoch = softclock_tm_to_epoch (tmp);
+    uint64_t            interval;
+    int64_t             offset;
+    int32_t             drift;
+
+    softclock_epoch_to_tm (tmp, epoch);
+    softclock_get_snapshot (&snap);
+
+    offset = softclock_offset (epoch, age_ms, &snap);
+
+    if (! softclock_set || offset <= -SOFTCLOCK_MAX_OFFSET_MS || offset >= SOFTCLOCK_MAX_OFFSET_MS)
+    {                                                                       // first sync or time jump: no drift information
+        softclock_step (epoch, age_ms);
+        softclock_restart_discipline ();
+        return (int32_t) (offset < -SOFTCLOCK_MAX_OFFSET_MS ? -SOFTCLOCK_MAX_OFFSET_MS :
+                          offset > SOFTCLOCK_MAX_OFFSET_MS ? SOFTCLOCK_MAX_OFFSET_MS : offset);
+    }
+
+    interval = snap.ms - discipline_start_ms;
+
+    if (softclock_sqw)                                                      // SQW: offsets are errors of RTC, not of TIM2
+    {
+        discipline_start_ms     = snap.ms;
+        discipline_offset_ms    = 0;
+
+        if (offset > (int32_t) accuracy_ms || offset < -(int32_t) accuracy_ms)
+        {
+            softclock_step (epoch, age_ms);                                 // caller must set RTC, too
+        }
+    }
+    else if (interval >= (uint64_t) accuracy_ms * SOFTCLOCK_DISCIPLINE_FACTOR)
+    {
+        drift = softclock_drift + (int32_t) ((discipline_offset_ms + offset) * PPB / (int64_t) interval);
+
+        if (drift > SOFTCLOCK_MAX_DRIFT)
+        {
+            drift = SOFTCLOCK_MAX_DRIFT;
+        }
+        else if (drift < -SOFTCLOCK_MAX_DRIFT)
+        {
+            drift = -SOFTCLOCK_MAX_DRIFT;
+        }
+
+        log_printf ("softclock: drift %ld ppb, measured over %lu sec\r\n", (long) drift, (unsigned long) (interval / 1000));
+
+        softclock_drift         = drift;
+        discipline_start_ms     = snap.ms;
+        discipline_offset_ms    = 0;
+
+        if (drift - eeprom_drift >= SOFTCLOCK_EEPROM_MIN_CHANGE || eeprom_drift - drift >= SOFTCLOCK_EEPROM_MIN_CHANGE)
+        {
+            softclock_write_data_to_eeprom ();
+        }
+
+        softclock_step (epoch, age_ms);                                     // start next measurement without offset
+    }
+    else if (offset > (int32_t) accuracy_ms || offset < -(int32_t) accuracy_ms)
+    {
+        discipline_offset_ms += (int32_t) offset;
+        softclock_step (epoch, age_ms);
+    }
+
+    return (int32_t) offset;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get drift in ppb, > 0: soft clock is too slow
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+int32_t
+softclock_get_drift (void)
+{
+    return softclock_drift;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * read drift from EEPROM
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+softclock_read_data_from_eeprom (void)
+{
+    int32_t         drift;
+    uint_fast8_t    rtc = 0;
+
+    if (eeprom_is_up && eeprom_read (EEPROM_DATA_OFFSET_CLOCK_DRIFT, (uint8_t *) &drift, EEPROM_DATA_SIZE_CLOCK_DRIFT))
+    {
+        if (drift >= -SOFTCLOCK_MAX_DRIFT && drift <= SOFTCLOCK_MAX_DRIFT)
+        {
+            softclock_drift = drift;
+            eeprom_drift    = drift;
+            rtc = 1;
+        }
+    }
+
+    return rtc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * write drift to EEPROM
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+softclock_write_data_to_eeprom (void)
+{
+    int32_t         drift = softclock_drift;
+    uint_fast8_t    rtc = 0;
+
+    if (eeprom_is_up && eeprom_write (EEPROM_DATA_OFFSET_CLOCK_DRIFT, (uint8_t *) &drift, EEPROM_DATA_SIZE_CLOCK_DRIFT))
+    {
+        eeprom_drift = drift;
+        rtc = 1;
+    }
+
+    return rtc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * check if wall clock has been set by softclock_set_tm()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+softclock_is_set (void)
+{
+    return softclock_set;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * convert struct tm to seconds since 1970-01-01 00:00:00, tm_year must be in the range 70...206
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint32_t
+softclock_tm_to_epoch (const struct tm * tmp)
+{
+    uint32_t    days;
+
+    days = days_from_date (tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday);
+
+    return days * SECONDS_PER_DAY + tmp->tm_hour * 3600L + tmp->tm_min * 60 + tmp->tm_sec;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * convert seconds since 1970-01-01 00:00:00 to struct tm
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+softclock_epoch_to_tm (struct tm * tmp, uint32_t epoch)
+{
+    uint32_t    days    = epoch / SECONDS_PER_DAY;
+    uint32_t    secs    = epoch % SECONDS_PER_DAY;
+    uint32_t    z       = days + DAYS_0000_TO_1970;
+    uint32_t    era     = z / DAYS_PER_400_YEARS;
+    uint32_t    doe     = z - era * DAYS_PER_400_YEARS;                     // day of era
+    uint32_t    yoe     = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t    doy     = doe - (365 * yoe + yoe / 4 - yoe / 100);          // day of year, beginning with march 1st
+    uint32_t    mp      = (5 * doy + 2) / 153;                              // month, 0 = march
+    uint32_t    year    = yoe + era * 400;
+    uint32_t    month   = mp < 10 ? mp + 3 : mp - 9;
+
+    if (month <= 2)
+    {
+        year++;
+    }
+
+    tmp->tm_year    = year - 1900;
+    tmp->tm_mon     = month - 1;
+    tmp->tm_mday    = doy - (153 * mp + 2) / 5 + 1;
+    tmp->tm_wday    = (days + WDAY_1970) % 7;
+    tmp->tm_yday    = days - days_from_date (year, 1, 1);
+    tmp->tm_hour    = secs / 3600;
+    tmp->tm_min     = (secs / 60) % 60;
+    tmp->tm_sec     = secs % 60;
+    tmp->tm_isdst   = 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * initialize soft clock
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+softclock_init (void)
+{
+    static uint_fast8_t already_called;
+
+    if (! already_called)
+    {
+        already_called  = 1;
+
+        softclock_seq   = 0;
+        softclock_ms    = 0;
+        softclock_epoch = 0;
+        softclock_msec  = 0;
+        softclock_set   = 0;
+        softclock_sqw   = 0;
+        sqw_late_ms     = 0;
+        softclock_drift = 0;
+        softclock_frac  = 0;
+    }
+}
@@ -0,0 +1,48 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * softclock.h - declarations of soft clock routines
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef SOFTCLOCK_H
+#define SOFTCLOCK_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+#include <time.h>
+
+typedef struct
+{
+    uint64_t                            ms;                                 // monotonic milliseconds since softclock_init()
+    uint32_t                            epoch;                              // local time in seconds since 1970-01-01 00:00:00
+    uint16_t                            msec;                               // sub-second phase in ms, 0...999
+} SOFTCLOCK_SNAPSHOT;
+
+extern void                             softclock_isr_tick (void);
+extern void                             softclock_sqw_isr (void);
+extern uint_fast8_t                     softclock_sqw_is_active (void);
+extern void                             softclock_get_snapshot (SOFTCLOCK_SNAPSHOT *);
+extern uint64_t                         softclock_get_ms64 (void);
+extern uint32_t                         softclock_get_uptime (void);
+extern void                             softclock_get_tm (struct tm *);
+extern void                             softclock_set_tm (struct tm *);
+extern uint_fast8_t                     softclock_is_set (void);
+extern int32_t                          softclock_get_offset (const struct tm *, uint_fast16_t);
+extern int32_t                          softclock_sync (struct tm *, uint_fast16_t, uint_fast16_t);
+extern int32_t                          softclock_get_drift (void);
+extern uint_fast8_t                     softclock_read_data_from_eeprom (void);
+extern uint_fast8_t                     softclock_write_data_to_eeprom (void);
+extern uint32_t                         softclock_tm_to_epoch (const struct tm *);
+extern void                             softclock_epoch_to_tm (struct tm *, uint32_t);
+extern void                             softclock_init (void);
+
+#endif
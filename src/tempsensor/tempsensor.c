@@ -15,30 +15,135 @@
 #include "eeprom.h"
 #include "eeprom-data.h"
 
+static TEMP_READ_CTX            temp_read_ctx;                          // state of background read, see temp_poll()
+static uint_fast8_t             temp_read_active;                       // flag: background read is running
+static uint8_t                  temp_cache_index[DS18XX_MAX_SENSORS];   // last temperature index per sensor, see temp_init()
+static uint32_t                 temp_cache_time;                        // time of last temperature, see timer_ms
+static uint32_t                 temp_next_time;                         // time of next read, see timer_ms
+static uint32_t                 temp_interval       = TEMP_READ_INTERVAL_MS;    // interval of background reads in ms
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * temp_read_temp_index_start () - start reading temperature with temp_read_temp_index_pt ()
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+temp_read_temp_index_start (TEMP_READ_CTX * ctx)
+{
+    PT_INIT(&ctx->pt);
+    memset (ctx->temperature_index, TEMP_INVALID, DS18XX_MAX_SENSORS);
+}
+
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
- * temp_read_temp_index () - read temperature
+ * temp_read_temp_index_pt () - read temperature of all sensors (protothread), result in ctx->temperature_index[]
  *
  *    temperature_index =   0 ->   0C
  *    temperature_index = 250 -> 125C
  *    temperature_index = 255 -> Error
  *-----------------------------------------------------------------------------------------------------------------------------------------------
  */
+PT_THREAD(temp_read_temp_index_pt (TEMP_READ_CTX * ctx))
+{
+    const DS18XX_SENSOR *   sensor;
+    uint_fast8_t            idx;
+
+    PT_BEGIN(&ctx->pt);
+
+    ds18xx_read_raw_temp_start (&ctx->ds18xx);
+    PT_WAIT_WHILE(&ctx->pt, PT_SCHEDULE(ds18xx_read_raw_temp_pt (&ctx->ds18xx)));
+
+    for (idx = 0; idx < ds18xx_get_n_sensors (); idx++)
+    {
+        sensor = ds18xx_get_sensor (idx);
+
+        if (sensor->valid && ! sensor->is_negative)
+        {
+            ctx->temperature_index[idx] = sensor->raw_temp;
+        }
+    }
+
+    PT_END(&ctx->pt);
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * temp_get_temp_index () - get temperature index of sensor of last background read, returns immediately
+ *
+ * Returns TEMP_INVALID if no temperature has been read yet or the last read failed.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+temp_get_temp_index (uint_fast8_t idx)
+{
+    return (idx < DS18XX_MAX_SENSORS) ? temp_cache_index[idx] : TEMP_INVALID;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * temp_read_temp_index () - get temperature index of first sensor of last background read, returns immediately
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
 uint_fast8_t
 temp_read_temp_index (void)
 {
-    uint_fast8_t    resolution;
-    uint_fast8_t    is_negative;
-    uint_fast16_t   raw_temp;
-    uint_fast8_t    temperature_index = 0xFF;
+    return temp_cache_index[0];
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * temp_get_timestamp () - get time of last temperature read, see timer_ms
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint32_t
+temp_get_timestamp (void)
+{
+    return temp_cache_time;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * temp_set_interval () - set interval of background reads in ms, next read is started after new interval
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+temp_set_interval (uint32_t interval_ms)
+{
+    temp_interval   = interval_ms;
+    temp_next_time  = timer_ms + interval_ms;
+}
+
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * temp_poll () - read temperature in background, call it in every main loop cycle
+ *
+ * Every temp_interval ms a conversion is started, then temp_read_temp_index_pt () polls the DS18xx every 10 ms until
+ * the result can be collected. Meanwhile the main loop continues. The result is stored in the cache, see
+ * temp_read_temp_index (). With bit banging, the OneWire bus is only accessed during a call, so the caller has to
+ * protect the timing of the bit slots, see short_isr in main.c. With the USART driver, the DMA transfers run between
+ * the calls, every call only checks if the current transfer has finished.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+temp_poll (void)
+{
+    if (! ds18xx_is_up)
+    {
+        return;
+    }
 
-    if (ds18xx_read_raw_temp (&resolution, &is_negative, &raw_temp))
+    if (! temp_read_active)
     {
-        if (! is_negative)
+        if ((int32_t) (timer_ms - temp_next_time) < 0)
         {
-            temperature_index = raw_temp;
+            return;
         }
+
+        temp_next_time = timer_ms + temp_interval;
+        temp_read_temp_index_start (&temp_read_ctx);
+        temp_read_active = 1;
+    }
+
+    temp_read_active = PT_SCHEDULE(temp_read_temp_index_pt (&temp_read_ctx));
+
+    if (! temp_read_active)
+    {
+        memcpy (temp_cache_index, temp_read_ctx.temperature_index, DS18XX_MAX_SENSORS);
+        temp_cache_time = timer_ms;
     }
-    return temperature_index;
 }
 
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
@@ -50,6 +155,7 @@ temp_init (void)
 {
     uint_fast8_t    rtc;
 
+    memset (temp_cache_index, TEMP_INVALID, DS18XX_MAX_SENSORS);
     rtc = ds18xx_init (DS_RESOLUTION_9_BIT);
 
     return rtc;
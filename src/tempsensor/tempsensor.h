@@ -19,7 +19,25 @@
 #  include "stm32f4xx.h"
 #endif
 
+#include "ds18xx.h"
+
+#define TEMP_READ_INTERVAL_MS   10000                                   // read temperature in background every 10 seconds
+#define TEMP_INVALID            0xFF                                    // temperature index: no temperature available
+
+typedef struct
+{
+    PT                          pt;
+    DS18XX_READ_CTX             ds18xx;                                 // child protothread
+    uint8_t                     temperature_index[DS18XX_MAX_SENSORS];  // result: temperature index per sensor, 0xFF = error
+} TEMP_READ_CTX;
+
+extern void                     temp_read_temp_index_start (TEMP_READ_CTX *);
+extern uint_fast8_t             temp_read_temp_index_pt (TEMP_READ_CTX *);
 extern uint_fast8_t             temp_read_temp_index (void);
+extern uint_fast8_t             temp_get_temp_index (uint_fast8_t);
+extern uint32_t                 temp_get_timestamp (void);
+extern void                     temp_set_interval (uint32_t);
+extern void                     temp_poll (void);
 extern uint_fast8_t             temp_init (void);
 
 #endif
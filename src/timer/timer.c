@@ -0,0 +1,392 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer.c - software timer wheel
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * The timer wheel is driven by timer_isr_tick(), which must be called once per millisecond (see TIM2_IRQHandler() in main.c).
+ * Timers are hashed into a hierarchical wheel of 3 levels with 64 slots each:
+ *
+ *      level 0:    1 ms per slot,    expiry in     0 ...     63 ms
+ *      level 1:   64 ms per slot,    expiry in    64 ...   4095 ms
+ *      level 2: 4096 ms per slot,    expiry in  4096 ... 262143 ms
+ *
+ * Every tick only the current slot of level 0 is inspected. Every 64 ticks one slot of level 1 (and every 4096 ticks one
+ * slot of level 2) is cascaded down to the lower levels. Timers with a longer expiry are parked in the last slot of level 2
+ * and re-hashed when this slot gets cascaded.
+ *
+ * Callbacks of timers registered with TIMER_FLAG_ISR are called in interrupt context, all others are called by timer_run()
+ * in the main loop. If the main loop is too slow, multiple expirations of the same timer are coalesced into one call.
+ * While the ISR must be short (e.g. onewire bit banging), ISR callbacks are deferred to the next normal tick, see
+ * timer_isr_tick().
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include <string.h>
+#include "timer.h"
+
+#define TIMER_WHEEL_LEVELS              3
+#define TIMER_WHEEL_BITS                6
+#define TIMER_WHEEL_SLOTS               (1 << TIMER_WHEEL_BITS)             // 64 slots per level
+#define TIMER_WHEEL_MASK                (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_RANGE               (1L << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))
+
+#define TIMER_STATE_FREE                0                                   // timer slot not used
+#define TIMER_STATE_IDLE                1                                   // timer registered, but not running
+#define TIMER_STATE_ACTIVE              2                                   // timer running, hashed into wheel
+
+typedef struct timer
+{
+    struct timer *              next;                                       // next timer in same slot
+    struct timer **             slotp;                                      // pointer to slot where timer is hashed
+    TIMER_CALLBACK              callback;                                   // callback function
+    uint32_t                    expires;                                    // expiry time in ms
+    uint32_t                    delay;                                      // delay of first expiry in ms
+    uint32_t                    period;                                     // period in ms, 0 = one-shot timer
+    uint8_t                     flags;                                      // TIMER_FLAG_xxx
+    uint8_t                     state;                                      // TIMER_STATE_xxx
+    volatile uint8_t            pending;                                    // flag: callback must be run by timer_run()
+} TIMER;
+
+volatile uint32_t               timer_ms;                                   // milliseconds since timer_init()
+
+static TIMER                    timers[TIMER_MAX_TIMERS];
+static TIMER *                  wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static volatile uint_fast8_t    timer_pending;                              // flag: at least one timer is pending
+static uint_fast8_t             timer_isr_deferred;                         // flag: at least one ISR callback is deferred
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: hash timer into wheel, must be called with interrupts disabled or in interrupt context
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+timer_insert (TIMER * t)
+{
+    uint32_t        expires = t->expires;
+    uint32_t        delta   = expires - timer_ms;
+    TIMER **        slotp;
+
+    if (delta >= (uint32_t) TIMER_WHEEL_RANGE)                              // too far in future: park timer in last slot of level 2
+    {
+        expires = timer_ms + TIMER_WHEEL_RANGE - 1;
+        delta   = TIMER_WHEEL_RANGE - 1;
+    }
+
+    if (delta < (1L << TIMER_WHEEL_BITS))
+    {
+        slotp = &wheel[0][expires & TIMER_WHEEL_MASK];
+    }
+    else if (delta < (1L << (2 * TIMER_WHEEL_BITS)))
+    {
+        slotp = &wheel[1][(expires >> TIMER_WHEEL_BITS) & TIMER_WHEEL_MASK];
+    }
+    else
+    {
+        slotp = &wheel[2][(expires >> (2 * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK];
+    }
+
+    t->next     = *slotp;
+    t->slotp    = slotp;
+    *slotp      = t;
+    t->state    = TIMER_STATE_ACTIVE;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: remove timer from wheel, must be called with interrupts disabled
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+timer_remove (TIMER * t)
+{
+    TIMER **    pp;
+
+    if (t->state == TIMER_STATE_ACTIVE)
+    {
+        for (pp = t->slotp; *pp; pp = &((*pp)->next))
+        {
+            if (*pp == t)
+            {
+                *pp = t->next;
+                break;
+            }
+        }
+
+        t->next     = (TIMER *) 0;
+        t->slotp    = (TIMER **) 0;
+        t->state    = TIMER_STATE_IDLE;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: cascade one slot of a higher level into the lower levels
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+timer_cascade (uint_fast8_t level, uint_fast8_t idx)
+{
+    TIMER *     t;
+    TIMER *     next;
+
+    t = wheel[level][idx];
+    wheel[level][idx] = (TIMER *) 0;
+
+    while (t)
+    {
+        next = t->next;
+        timer_insert (t);
+        t = next;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * add a timer
+ *
+ * delay:       time in ms until first expiry, minimum 1
+ * period:      period in ms, 0 for one-shot timer
+ * callback:    callback function
+ * flags:       TIMER_FLAG_ISR: call callback in interrupt context, else call it by timer_run()
+ *
+ * Return values:
+ *  TIMER_INVALID   Failed
+ *  other           timer id
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+timer_add (uint32_t delay, uint32_t period, TIMER_CALLBACK callback, uint_fast8_t flags)
+{
+    TIMER *         t;
+    uint_fast8_t    id;
+
+    if (delay == 0)
+    {
+        delay = 1;
+    }
+
+    for (id = 0; id < TIMER_MAX_TIMERS; id++)
+    {
+        if (timers[id].state == TIMER_STATE_FREE)
+        {
+            t = &timers[id];
+
+            t->callback = callback;
+            t->delay    = delay;
+            t->period   = period;
+            t->flags    = flags;
+            t->pending  = 0;
+
+            __disable_irq();
+            t->expires  = timer_ms + delay;
+            timer_insert (t);
+            __enable_irq();
+
+            return id;
+        }
+    }
+
+    return TIMER_INVALID;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * add a periodic timer, first expiry after one period
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+timer_add_periodic (uint32_t period, TIMER_CALLBACK callback, uint_fast8_t flags)
+{
+    return timer_add (period, period, callback, flags);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * add a one-shot timer
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+timer_add_oneshot (uint32_t delay, TIMER_CALLBACK callback, uint_fast8_t flags)
+{
+    return timer_add (delay, 0, callback, flags);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * restart a timer: next expiry after one period (one-shot timer: after initial delay)
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+timer_restart (uint_fast8_t id)
+{
+    TIMER *     t;
+
+    if (id < TIMER_MAX_TIMERS && timers[id].state != TIMER_STATE_FREE)
+    {
+        t = &timers[id];
+
+        __disable_irq();
+        timer_remove (t);
+        t->expires = timer_ms + (t->period ? t->period : t->delay);
+        timer_insert (t);
+        __enable_irq();
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * stop a timer, it can be started again by timer_restart()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+timer_stop (uint_fast8_t id)
+{
+    if (id < TIMER_MAX_TIMERS && timers[id].state != TIMER_STATE_FREE)
+    {
+        __disable_irq();
+        timer_remove (&timers[id]);
+        timers[id].pending = 0;
+        __enable_irq();
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * advance timer wheel by one millisecond, must be called by timer ISR every millisecond
+ *
+ * short_tick: 1 = only advance timer_ms and the wheel, ISR callbacks of expired timers are run by the next call with 0
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+timer_isr_tick (uint_fast8_t short_tick)
+{
+    TIMER *         t;
+    TIMER *         next;
+    uint_fast8_t    idx;
+
+    if (! short_tick && timer_isr_deferred)
+    {
+        timer_isr_deferred = 0;
+
+        for (idx = 0; idx < TIMER_MAX_TIMERS; idx++)
+        {
+            if ((timers[idx].flags & TIMER_FLAG_ISR) && timers[idx].pending)
+            {
+                timers[idx].pending = 0;
+                (*timers[idx].callback) ();
+            }
+        }
+    }
+
+    timer_ms++;
+
+    idx = timer_ms & TIMER_WHEEL_MASK;
+
+    if (idx == 0)
+    {
+        uint_fast8_t idx1 = (timer_ms >> TIMER_WHEEL_BITS) & TIMER_WHEEL_MASK;
+
+        timer_cascade (1, idx1);
+
+        if (idx1 == 0)
+        {
+            timer_cascade (2, (timer_ms >> (2 * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+        }
+    }
+
+    t = wheel[0][idx];
+    wheel[0][idx] = (TIMER *) 0;
+
+    while (t)
+    {
+        next = t->next;
+
+        if (t->expires == timer_ms)
+        {
+            if (t->flags & TIMER_FLAG_ISR)
+            {
+                if (short_tick)
+                {
+                    t->pending = 1;
+                    timer_isr_deferred = 1;
+                }
+                else
+                {
+                    (*t->callback) ();
+                }
+            }
+            else
+            {
+                t->pending = 1;
+                timer_pending = 1;
+            }
+
+            if (t->period)
+            {
+                t->expires += t->period;
+                timer_insert (t);
+            }
+            else
+            {
+                t->next     = (TIMER *) 0;
+                t->slotp    = (TIMER **) 0;
+                t->state    = TIMER_STATE_IDLE;
+            }
+        }
+        else
+        {
+            timer_insert (t);                                               // parked long timer, hash it again
+        }
+
+        t = next;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * check if callbacks of expired timers must be run by timer_run()
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+timer_is_pending (void)
+{
+    return timer_pending;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * run callbacks of expired timers, must be called in main loop
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+timer_run (void)
+{
+    uint_fast8_t    id;
+
+    if (timer_pending)
+    {
+        timer_pending = 0;
+
+        for (id = 0; id < TIMER_MAX_TIMERS; id++)
+        {
+            if (timers[id].pending && ! (timers[id].flags & TIMER_FLAG_ISR))    // ISR callbacks may be deferred, see timer_isr_tick()
+            {
+                timers[id].pending = 0;
+                (*timers[id].callback) ();
+            }
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * initialize timer wheel
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+timer_init (void)
+{
+    static uint_fast8_t already_called;
+
+    if (! already_called)
+    {
+        already_called = 1;
+
+        memset (timers, 0, sizeof (timers));
+        memset (wheel, 0, sizeof (wheel));
+        timer_pending   = 0;
+        timer_ms        = 0;
+    }
+}
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timer.h - declarations of software timer wheel routines
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef TIMER_H
+#define TIMER_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+#define TIMER_MAX_TIMERS                16                                  // max. number of registered timers
+#define TIMER_INVALID                   0xFF                                // return value of timer_add() on error
+
+#define TIMER_FLAG_NONE                 0x00                                // callback is called by timer_run() in main loop
+#define TIMER_FLAG_ISR                  0x01                                // callback is called in interrupt context
+
+typedef void (*TIMER_CALLBACK) (void);
+
+extern volatile uint32_t                timer_ms;                           // milliseconds since timer_init()
+
+extern uint_fast8_t                     timer_add (uint32_t, uint32_t, TIMER_CALLBACK, uint_fast8_t);
+extern uint_fast8_t                     timer_add_periodic (uint32_t, TIMER_CALLBACK, uint_fast8_t);
+extern uint_fast8_t                     timer_add_oneshot (uint32_t, TIMER_CALLBACK, uint_fast8_t);
+extern void                             timer_restart (uint_fast8_t);
+extern void                             timer_stop (uint_fast8_t);
+extern void                             timer_isr_tick (uint_fast8_t);
+extern uint_fast8_t                     timer_is_pending (void);
+extern void                             timer_run (void);
+extern void                             timer_init (void);
+
+#endif
@@ -0,0 +1,228 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timesource.c - time source manager
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * All time sources (DCF77, time server, RTC and manual settings) report their time by timesource_report(). The manager
+ * keeps an estimate of the soft clock error: the accuracy of the best source at the last sync plus the drift since
+ * then, see timesource_get_error_ms().
+ *
+ * A report whose offset to the soft clock is greater than the sum of source accuracy and soft clock error is an outlier:
+ *
+ *  - If the soft clock is better than the source, the report is rejected. For the RTC this means that the RTC must be
+ *    set again.
+ *  - Otherwise the jump must be confirmed by the next report of the same source, e.g. two DCF77 frames in a row or a
+ *    DST change, before the soft clock is corrected.
+ *  - A time server report which is off by whole hours is a DST or time zone change and is applied at once.
+ *
+ * All other reports are passed to softclock_sync(), which corrects the soft clock only if the offset exceeds the
+ * accuracy of the source. The caller should set the RTC only if TIMESOURCE_CORRECTED is returned. Manual settings
+ * are always applied.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#include "timesource.h"
+#include "softclock.h"
+#include "log.h"
+
+#define TIMESOURCE_DRIFT_PPM            10                                  // assumed max. drift of soft clock driven by TIM2
+#define TIMESOURCE_SQW_DRIFT_PPM        2                                   // max. drift of DS3231, see softclock_sqw_isr()
+#define TIMESOURCE_RTC_SQW_ACCURACY_MS  50                                  // RTC read just after SQW edge, see rtc_task() in main.c
+#define TIMESOURCE_MAX_ERROR_MS         0xFFFFFFFFUL                        // soft clock not set
+#define TIMESOURCE_HOUR_MS              3600000UL                           // offset of DST or time zone change
+
+static TIMESOURCE                       sources[TIMESOURCE_COUNT] =
+{
+    { "DCF77",      10,     0, 0, 0, 0, 0, 0, 0 },                          // timestamp of minute mark edge, receiver jitter
+    { "Net",        1000,   0, 0, 0, 0, 0, 0, 0 },                          // time server delivers seconds only
+    { "RTC",        1000,   0, 0, 0, 0, 0, 0, 0 },                          // RTC delivers seconds only
+    { "Manual",     1000,   0, 0, 0, 0, 0, 0, 0 },
+};
+
+static uint32_t                         sync_error_ms;                      // error of soft clock at last sync
+static uint64_t                         sync_ms;                            // monotonic ms of last sync
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get estimated error of soft clock in ms
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint32_t
+timesource_get_error_ms (void)
+{
+    uint64_t    elapsed;
+    uint64_t    error;
+
+    if (! softclock_is_set ())
+    {
+        return TIMESOURCE_MAX_ERROR_MS;
+    }
+
+    elapsed = softclock_get_ms64 () - sync_ms;
+    error   = sync_error_ms + elapsed * (softclock_sqw_is_active () ? TIMESOURCE_SQW_DRIFT_PPM : TIMESOURCE_DRIFT_PPM) / 1000000;
+
+    return error < TIMESOURCE_MAX_ERROR_MS ? (uint32_t) error : TIMESOURCE_MAX_ERROR_MS;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: drop candidates of all sources, their offsets refer to the soft clock before correction
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static void
+timesource_drop_candidates (void)
+{
+    uint_fast8_t    i;
+
+    for (i = 0; i < TIMESOURCE_COUNT; i++)
+    {
+        sources[i].has_candidate = 0;
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * INTERN: check if offset is a whole number of hours within tolerance, e.g. a DST or time zone change
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+static uint_fast8_t
+timesource_is_zone_change (uint32_t abs_offset, uint32_t tolerance)
+{
+    uint32_t        rest;
+
+    if (abs_offset + tolerance < TIMESOURCE_HOUR_MS)
+    {
+        return 0;
+    }
+
+    rest = abs_offset % TIMESOURCE_HOUR_MS;
+
+    return (rest <= tolerance || TIMESOURCE_HOUR_MS - rest <= tolerance);
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * report time of a time source
+ *
+ * source:      TIMESOURCE_xxx
+ * tmp:         time of source, tm_wday and tm_yday are recalculated, see softclock_set_tm()
+ * age_ms:      time since begin of tmp, e.g. since DCF77 minute mark. 0: time begins just now
+ *
+ * Return values:
+ *  TIMESOURCE_REJECTED     outlier, soft clock is better than source
+ *  TIMESOURCE_PENDING      outlier, must be confirmed by next report of same source
+ *  TIMESOURCE_ACCEPTED     offset within accuracy of source, soft clock not corrected
+ *  TIMESOURCE_CORRECTED    soft clock corrected
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+uint_fast8_t
+timesource_report (uint_fast8_t source, struct tm * tmp, uint_fast16_t age_ms)
+{
+    TIMESOURCE *    s = &sources[source];
+    uint32_t        accuracy;
+    uint32_t        error;
+    uint32_t        abs_offset;
+    int64_t         diff;
+    int32_t         offset;
+    uint_fast8_t    rtc;
+
+    accuracy = s->accuracy_ms;
+
+    if (source == TIMESOURCE_RTC && softclock_sqw_is_active ())
+    {
+        accuracy = TIMESOURCE_RTC_SQW_ACCURACY_MS;
+    }
+
+    error       = timesource_get_error_ms ();
+    offset      = softclock_get_offset (tmp, age_ms);
+    abs_offset  = (uint32_t) (offset < 0 ? -(int64_t) offset : offset);
+
+    s->reports++;
+    s->last_offset      = offset;
+    s->last_report_ms   = softclock_get_ms64 ();
+
+    if (source == TIMESOURCE_MANUAL)
+    {
+        softclock_set_tm (tmp);
+        rtc = TIMESOURCE_CORRECTED;
+    }
+    else if (error != TIMESOURCE_MAX_ERROR_MS && abs_offset > accuracy + error)     // source and soft clock disagree
+    {
+        diff = (int64_t) offset - s->candidate_offset;
+
+        if (source == TIMESOURCE_NET && timesource_is_zone_change (abs_offset, accuracy + error))
+        {
+            log_printf ("timesource: %s zone change, offset %ld ms\r\n", s->name, (long) offset);
+        }
+        else if (error < accuracy)                                          // soft clock is better, source is wrong
+        {
+            s->rejected++;
+            log_printf ("timesource: %s rejected, offset %ld ms\r\n", s->name, (long) offset);
+            return TIMESOURCE_REJECTED;
+        }
+        else if (! s->has_candidate || diff > 2 * accuracy || -diff > 2 * accuracy)     // jump must be confirmed by next report
+        {
+            s->has_candidate    = 1;
+            s->candidate_offset = offset;
+            s->rejected++;
+            log_printf ("timesource: %s pending, offset %ld ms\r\n", s->name, (long) offset);
+            return TIMESOURCE_PENDING;
+        }
+
+        (void) softclock_sync (tmp, accuracy, age_ms);
+        rtc = TIMESOURCE_CORRECTED;
+    }
+    else
+    {
+        (void) softclock_sync (tmp, accuracy, age_ms);
+        rtc = (error == TIMESOURCE_MAX_ERROR_MS || abs_offset > accuracy) ? TIMESOURCE_CORRECTED : TIMESOURCE_ACCEPTED;
+    }
+
+    if (rtc == TIMESOURCE_CORRECTED)
+    {
+        s->corrections++;
+        timesource_drop_candidates ();
+    }
+
+    s->has_candidate = 0;
+
+    if (rtc == TIMESOURCE_CORRECTED || accuracy <= timesource_get_error_ms ())
+    {
+        sync_error_ms   = accuracy;
+        sync_ms         = s->last_report_ms;
+    }
+
+    return rtc;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * get time source
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+const TIMESOURCE *
+timesource_get (uint_fast8_t source)
+{
+    if (source < TIMESOURCE_COUNT)
+    {
+        return &sources[source];
+    }
+
+    return (TIMESOURCE *) 0;
+}
+
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * initialize time source manager
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+timesource_init (void)
+{
+    static uint_fast8_t already_called;
+
+    if (! already_called)
+    {
+        already_called  = 1;
+        sync_error_ms   = 0;
+        sync_ms         = 0;
+    }
+}
@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------------------------------------------------------------------------------
+ * timesource.h - declarations of time source manager
+ *
+ * Copyright (c) 2014-2016 Frank Meyer - frank(at)fli4l.de
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *-------------------------------------------------------------------------------------------------------------------------------------------
+ */
+#ifndef TIMESOURCE_H
+#define TIMESOURCE_H
+
+#if defined (STM32F10X)
+#include "stm32f10x.h"
+#elif defined (STM32F4XX)
+#include "stm32f4xx.h"
+#endif
+
+#include <time.h>
+
+#define TIMESOURCE_DCF77                0                                   // DCF77 minute mark
+#define TIMESOURCE_NET                  1                                   // time server (NTP)
+#define TIMESOURCE_RTC                  2                                   // RTC DS3231/DS1307
+#define TIMESOURCE_MANUAL               3                                   // IR remote control, HTTP or listener command
+#define TIMESOURCE_COUNT                4                                   // number of time sources
+
+#define TIMESOURCE_REJECTED             0                                   // outlier, soft clock is better than source
+#define TIMESOURCE_PENDING              1                                   // outlier, must be confirmed by next report
+#define TIMESOURCE_ACCEPTED             2                                   // report accepted, offset within accuracy
+#define TIMESOURCE_CORRECTED            3                                   // report accepted, soft clock corrected
+
+typedef struct
+{
+    const char *                        name;                               // name of time source
+    uint16_t                            accuracy_ms;                        // accuracy of time source in ms
+    uint32_t                            reports;                            // number of reports
+    uint32_t                            rejected;                           // number of rejected reports
+    uint32_t                            corrections;                        // number of corrections of soft clock
+    int32_t                             last_offset;                        // offset of last report to soft clock in ms
+    uint64_t                            last_report_ms;                     // monotonic ms of last report, 0 = never
+    int32_t                             candidate_offset;                   // offset of rejected report, see timesource_report()
+    uint8_t                             has_candidate;                      // flag: candidate_offset is valid
+} TIMESOURCE;
+
+extern uint_fast8_t                     timesource_report (uint_fast8_t, struct tm *, uint_fast16_t);
+extern uint32_t                         timesource_get_error_ms (void);
+extern const TIMESOURCE *               timesource_get (uint_fast8_t);
+extern void                             timesource_init (void);
+
+#endif
@@ -18,6 +18,8 @@
 #  define SAVE_RAM 0
 #endif
 
+#define RTC_SQW_SECOND_TICK 1                                   // 1: use 1 Hz square wave of DS3231 as second tick, see rtc.c
+
 // not used yet, see project settings for WCLOCK24H=1 (WCLOCK24H) or WCLOCK24H=0 (WCLOCK12H)
 
 #endif
@@ -130,6 +130,9 @@ static uint16_t                     timer_buf[WS2812_TIMER_BUF_LEN(WS2812_MAX_LE
 static uint8_t                      timer_buf[WS2812_TIMER_BUF_LEN(WS2812_MAX_LEDS)];           // 8bit DMA buffer saves RAM
 #endif
 
+static uint8_t                      dim_table[256];                                             // dimmed value of every PWM value
+static uint_fast16_t                dim_first_led = WS2812_MAX_LEDS;                            // LEDs before are not dimmed
+
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
  * INTERN: initialize DMA
  *-----------------------------------------------------------------------------------------------------------------------------------------------
@@ -224,25 +227,37 @@ ws2812_setup_timer_buf (uint_fast16_t n_leds)
     uint_fast16_t   n;
     uint_fast16_t   pos;
     WS2812_RGB *    led;
+    WS2812_RGB      rgb;
 
     pos = 0;
     led = rgb_buf;
 
     for (n = 0; n < n_leds; n++)
     {
+        if (n < dim_first_led)
+        {
+            rgb = *led;
+        }
+        else
+        {
+            rgb.red     = dim_table[led->red];
+            rgb.green   = dim_table[led->green];
+            rgb.blue    = dim_table[led->blue];
+        }
+
         for (i = 0x80; i != 0; i >>= 1)                         // color green
         {
-            timer_buf[pos++] = (led->green & i) ? WS2812_T1H : WS2812_T1L;
+            timer_buf[pos++] = (rgb.green & i) ? WS2812_T1H : WS2812_T1L;
         }
 
         for (i = 0x80; i != 0; i >>= 1)                         // color red
         {
-            timer_buf[pos++] = (led->red & i) ? WS2812_T1H : WS2812_T1L;
+            timer_buf[pos++] = (rgb.red & i) ? WS2812_T1H : WS2812_T1L;
         }
 
         for (i = 0x80; i != 0; i >>= 1)                         // color blue
         {
-            timer_buf[pos++] = (led->blue & i) ? WS2812_T1H : WS2812_T1L;
+            timer_buf[pos++] = (rgb.blue & i) ? WS2812_T1H : WS2812_T1L;
         }
 
         led++;
@@ -328,6 +343,31 @@ ws2812_set_all_leds (WS2812_RGB * rgb, uint_fast16_t n_leds, uint_fast8_t refres
     }
 }
 
+/*-----------------------------------------------------------------------------------------------------------------------------------------------
+ * set dim factor of all LEDs from first_led on, 256 = full brightness
+ *
+ * The RGB values are not changed, the factor is applied by a lookup table while the next refresh builds the timer buffer.
+ * Dimmed values are at least 1, so a LED which is on does not go out.
+ *-----------------------------------------------------------------------------------------------------------------------------------------------
+ */
+void
+ws2812_set_dim_factor (uint_fast16_t first_led, uint_fast16_t factor)
+{
+    uint_fast16_t   value;
+
+    for (value = 0; value < 256; value++)
+    {
+        dim_table[value] = (value * factor + 128) >> 8;
+
+        if (value > 0 && dim_table[value] == 0)
+        {
+            dim_table[value] = 1;
+        }
+    }
+
+    dim_first_led = first_led;
+}
+
 /*-----------------------------------------------------------------------------------------------------------------------------------------------
  * initialize WS2812
  *-----------------------------------------------------------------------------------------------------------------------------------------------